@@ -0,0 +1,450 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+// Native benchmark for the Serial backend, driven through its godot_serial_interface table with
+// the engine replaced by mock_api.c, and a pseudo terminal standing in for the device.
+//
+// Reports, for polled and "threaded" ports:
+//   - ns per call of available_for_read(), read() on an empty and on a filled buffer, and write()
+//   - sustained MB/s writing and reading with write()/read_bytes() at several chunk sizes
+//   - latency percentiles of a one byte round trip through an echoing peer
+//
+// Linux only. Build from the repository root, next to a checkout of godot_headers:
+//   cc -O2 -pthread -Igodot_headers -Isrc -o serial_bench bench/*.c $(ls src/*.c | grep -v -e godot_serial.c -e windows.c) -lutil
+//   ./serial_bench [round_trips]
+
+#include "mock_api.h"
+#include "godot_serial.h"
+#include "serial_interface.h"
+#include "serial_port.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+const godot_gdnative_core_api_struct *api = &mock_api;
+const godot_gdnative_ext_nativescript_api_struct *nativescript_api = NULL;
+
+typedef GDCALLINGCONV godot_variant (*bench_method)(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+typedef struct {
+	const godot_serial_interface *serial;
+	void *port;
+	int master;
+	int slave;
+	bool threaded;
+} bench_port;
+
+// Peer side of the pseudo terminal, run on its own thread
+typedef enum {
+	PEER_DRAIN, // reads and counts everything the port writes
+	PEER_FEED, // writes p_total bytes for the port to read
+	PEER_ECHO, // writes back everything the port writes
+} bench_peer_mode;
+
+typedef struct {
+	bench_peer_mode mode;
+	int fd;
+	uint64_t total;
+	volatile uint64_t count;
+	volatile int stop;
+	pthread_t thread;
+} bench_peer;
+
+static const int chunk_sizes[] = { 1, 16, 64, 256, 1024, 4096 };
+
+static int64_t _now_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static godot_variant _call(bench_port *p_bench, bench_method p_method, int p_num_args, godot_variant **p_args) {
+	return p_method(NULL, NULL, p_bench->port, p_num_args, p_args);
+}
+
+static int64_t _call_int(bench_port *p_bench, bench_method p_method, int p_num_args, godot_variant **p_args) {
+	godot_variant ret = _call(p_bench, p_method, p_num_args, p_args);
+	int64_t val = api->godot_variant_as_int(&ret);
+	api->godot_variant_destroy(&ret);
+	return val;
+}
+
+static void _set_option(godot_dictionary *p_options, const char *p_key, const godot_variant *p_value) {
+	godot_variant key;
+	mock_variant_new_cstring(&key, p_key);
+	api->godot_dictionary_set(p_options, &key, p_value);
+	api->godot_variant_destroy(&key);
+}
+
+static bool _open(bench_port *p_bench, bool p_threaded, int p_buffer_size) {
+	char name[64];
+	if (openpty(&p_bench->master, &p_bench->slave, name, NULL, NULL) < 0) {
+		fprintf(stderr, "Cannot open a pseudo terminal: %s\n", strerror(errno));
+		return false;
+	}
+	// The port sets its own end up, the peer's end has to be raw too so nothing gets translated
+	struct termios tio;
+	tcgetattr(p_bench->master, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(p_bench->master, TCSANOW, &tio);
+
+	godot_dictionary options;
+	godot_variant value;
+	api->godot_dictionary_new(&options);
+	api->godot_variant_new_bool(&value, p_threaded);
+	_set_option(&options, "threaded", &value);
+	api->godot_variant_new_int(&value, p_buffer_size);
+	_set_option(&options, "buffer_size", &value);
+	_set_option(&options, "write_buffer_size", &value);
+
+	godot_variant port_name, baudrate, config, options_variant;
+	mock_variant_new_cstring(&port_name, name);
+	api->godot_variant_new_int(&baudrate, 115200);
+	mock_variant_new_cstring(&config, "8N1");
+	api->godot_variant_new_dictionary(&options_variant, &options);
+	godot_variant *args[] = { &port_name, &baudrate, &config, &options_variant };
+
+	p_bench->serial = &godot_serial_implementation;
+	p_bench->port = p_bench->serial->constructor(NULL, NULL);
+	p_bench->threaded = p_threaded;
+	godot_variant ret = _call(p_bench, p_bench->serial->open, 4, args);
+	bool success = api->godot_variant_as_bool(&ret);
+
+	api->godot_variant_destroy(&ret);
+	api->godot_variant_destroy(&options_variant);
+	api->godot_variant_destroy(&config);
+	api->godot_variant_destroy(&port_name);
+	api->godot_dictionary_destroy(&options);
+
+	if (!success) {
+		fprintf(stderr, "Cannot open %s\n", name);
+		p_bench->serial->destructor(NULL, NULL, p_bench->port);
+		close(p_bench->slave);
+		close(p_bench->master);
+	}
+	return success;
+}
+
+// Reads never wait, as in a game polling every frame; writes that time out have to be avoided by the caller
+static void _set_timeout(bench_port *p_bench, int p_timeout_ms) {
+	godot_variant timeout;
+	api->godot_variant_new_int(&timeout, p_timeout_ms);
+	godot_variant *args[] = { &timeout };
+	godot_variant ret = _call(p_bench, p_bench->serial->set_timeout, 1, args);
+	api->godot_variant_destroy(&ret);
+}
+
+static void _close(bench_port *p_bench) {
+	godot_variant ret = _call(p_bench, p_bench->serial->close, 0, NULL);
+	api->godot_variant_destroy(&ret);
+	p_bench->serial->destructor(NULL, NULL, p_bench->port);
+	close(p_bench->slave);
+	close(p_bench->master);
+}
+
+// Peer
+
+static void * _peer_main(void *p_data) {
+	bench_peer *peer = (bench_peer *) p_data;
+	uint8_t buffer[4096];
+	memset(buffer, 0x55, sizeof(buffer));
+
+	while (!__atomic_load_n(&peer->stop, __ATOMIC_ACQUIRE)) {
+		if (peer->mode == PEER_FEED) {
+			const uint64_t left = peer->total - peer->count;
+			if (left == 0)
+				break;
+			struct pollfd pfd = { peer->fd, POLLOUT, 0 };
+			if (poll(&pfd, 1, 10) <= 0)
+				continue;
+			ssize_t n = write(peer->fd, buffer, left < sizeof(buffer) ? left : sizeof(buffer));
+			if (n > 0)
+				__atomic_add_fetch(&peer->count, n, __ATOMIC_RELEASE);
+			continue;
+		}
+
+		struct pollfd pfd = { peer->fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 10) <= 0)
+			continue;
+		ssize_t n = read(peer->fd, buffer, sizeof(buffer));
+		if (n <= 0)
+			continue;
+		if (peer->mode == PEER_ECHO) {
+			for (ssize_t written = 0; written < n;) {
+				ssize_t w = write(peer->fd, buffer + written, n - written);
+				if (w > 0)
+					written += w;
+			}
+		}
+		__atomic_add_fetch(&peer->count, n, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static void _peer_start(bench_peer *p_peer, bench_peer_mode p_mode, int p_fd, uint64_t p_total) {
+	p_peer->mode = p_mode;
+	p_peer->fd = p_fd;
+	p_peer->total = p_total;
+	p_peer->count = 0;
+	p_peer->stop = 0;
+	pthread_create(&p_peer->thread, NULL, _peer_main, p_peer);
+}
+
+static void _peer_stop(bench_peer *p_peer) {
+	__atomic_store_n(&p_peer->stop, 1, __ATOMIC_RELEASE);
+	pthread_join(p_peer->thread, NULL);
+}
+
+static uint64_t _peer_count(bench_peer *p_peer) {
+	return __atomic_load_n(&p_peer->count, __ATOMIC_ACQUIRE);
+}
+
+// write() that retries while a threaded port's queue is full; a polled port needs a timeout to wait instead
+static void _write(bench_port *p_bench, godot_variant *p_data) {
+	while (_call_int(p_bench, p_bench->serial->write, 1, &p_data) != 0) {
+		if (!p_bench->threaded) {
+			fprintf(stderr, "write() failed\n");
+			exit(1);
+		}
+		sched_yield();
+	}
+}
+
+// Per call overhead
+
+#define CALLS 1000000
+#define WRITE_CALLS 200000
+#define FILL 2048
+
+static void _bench_calls(bench_port *p_bench) {
+	const char *mode = p_bench->threaded ? "threaded" : "polled";
+	int64_t start;
+
+	start = _now_nsec();
+	for (int i = 0; i < CALLS; i++) {
+		godot_variant ret = _call(p_bench, p_bench->serial->available_for_read, 0, NULL);
+		api->godot_variant_destroy(&ret);
+	}
+	printf("  %-8s available_for_read()    %8.1f ns\n", mode, (double) (_now_nsec() - start) / CALLS);
+
+	start = _now_nsec();
+	for (int i = 0; i < CALLS; i++) {
+		godot_variant ret = _call(p_bench, p_bench->serial->read, 0, NULL);
+		api->godot_variant_destroy(&ret);
+	}
+	printf("  %-8s read(), empty           %8.1f ns\n", mode, (double) (_now_nsec() - start) / CALLS);
+
+	// Only the reads are timed: the buffer is filled by the peer, and pulled in with peek() if polled
+	uint8_t fill[FILL];
+	memset(fill, 0x55, sizeof(fill));
+	int64_t elapsed = 0;
+	int reads = 0;
+	while (reads < CALLS) {
+		if (write(p_bench->master, fill, sizeof(fill)) != sizeof(fill)) {
+			fprintf(stderr, "Cannot fill the port\n");
+			return;
+		}
+		while (_call_int(p_bench, p_bench->serial->available_for_read, 0, NULL) < FILL) {
+			if (!p_bench->threaded) {
+				godot_variant ret = _call(p_bench, p_bench->serial->peek, 0, NULL);
+				api->godot_variant_destroy(&ret);
+			}
+		}
+		start = _now_nsec();
+		for (int i = 0; i < FILL; i++) {
+			godot_variant ret = _call(p_bench, p_bench->serial->read, 0, NULL);
+			api->godot_variant_destroy(&ret);
+		}
+		elapsed += _now_nsec() - start;
+		reads += FILL;
+	}
+	printf("  %-8s read(), buffered        %8.1f ns\n", mode, (double) elapsed / reads);
+
+	bench_peer drain;
+	_peer_start(&drain, PEER_DRAIN, p_bench->master, 0);
+	const uint8_t byte = 0x55;
+	godot_variant data;
+	mock_variant_new_bytes(&data, &byte, 1);
+	_set_timeout(p_bench, 1000);
+	start = _now_nsec();
+	for (int i = 0; i < WRITE_CALLS; i++)
+		_write(p_bench, &data);
+	_set_timeout(p_bench, 0);
+	printf("  %-8s write(), 1 byte         %8.1f ns\n", mode, (double) (_now_nsec() - start) / WRITE_CALLS);
+	while (_peer_count(&drain) < WRITE_CALLS)
+		sched_yield();
+	_peer_stop(&drain);
+	api->godot_variant_destroy(&data);
+}
+
+// Sustained throughput
+
+#define THROUGHPUT_BYTES (16 << 20)
+#define THROUGHPUT_MAX_CALLS 200000
+
+static uint64_t _throughput_total(int p_chunk) {
+	const uint64_t total = (uint64_t) p_chunk * THROUGHPUT_MAX_CALLS;
+	return total < THROUGHPUT_BYTES ? total : THROUGHPUT_BYTES;
+}
+
+static void _bench_write_throughput(bench_port *p_bench, int p_chunk) {
+	const uint64_t total = _throughput_total(p_chunk);
+	uint8_t *chunk = calloc(1, p_chunk);
+	godot_variant data;
+	mock_variant_new_bytes(&data, chunk, p_chunk);
+	free(chunk);
+
+	bench_peer drain;
+	_peer_start(&drain, PEER_DRAIN, p_bench->master, 0);
+	_set_timeout(p_bench, 1000);
+	const int64_t start = _now_nsec();
+	for (uint64_t sent = 0; sent < total; sent += p_chunk)
+		_write(p_bench, &data);
+	_set_timeout(p_bench, 0);
+	while (_peer_count(&drain) < total)
+		sched_yield();
+	const int64_t elapsed = _now_nsec() - start;
+	_peer_stop(&drain);
+	api->godot_variant_destroy(&data);
+
+	printf("  %-8s write  %5d B  %9.2f MB/s\n", p_bench->threaded ? "threaded" : "polled", p_chunk, total * 1e3 / elapsed);
+}
+
+static void _bench_read_throughput(bench_port *p_bench, int p_chunk) {
+	const uint64_t total = _throughput_total(p_chunk);
+	godot_variant max;
+	api->godot_variant_new_int(&max, p_chunk);
+	godot_variant *args[] = { &max };
+
+	// A threaded port drops what does not fit, so those bytes count as arrived too
+	const uint64_t overflow = _call_int(p_bench, p_bench->serial->get_overflow_count, 0, NULL);
+	uint64_t received = 0;
+	bench_peer feed;
+	_peer_start(&feed, PEER_FEED, p_bench->master, total);
+	const int64_t start = _now_nsec();
+	while (received + _call_int(p_bench, p_bench->serial->get_overflow_count, 0, NULL) - overflow < total) {
+		godot_variant ret = _call(p_bench, p_bench->serial->read_bytes, 1, args);
+		int length;
+		mock_variant_bytes(&ret, &length);
+		received += length;
+		api->godot_variant_destroy(&ret);
+	}
+	const int64_t elapsed = _now_nsec() - start;
+	_peer_stop(&feed);
+
+	const uint64_t dropped = _call_int(p_bench, p_bench->serial->get_overflow_count, 0, NULL) - overflow;
+	printf("  %-8s read   %5d B  %9.2f MB/s", p_bench->threaded ? "threaded" : "polled", p_chunk, received * 1e3 / elapsed);
+	if (dropped > 0)
+		printf("  (%.1f%% overflowed)", dropped * 100.0 / total);
+	printf("\n");
+}
+
+// Latency
+
+static int _compare_int64(const void *p_a, const void *p_b) {
+	const int64_t a = *(const int64_t *) p_a;
+	const int64_t b = *(const int64_t *) p_b;
+	return (a > b) - (a < b);
+}
+
+static double _percentile_usec(const int64_t *p_sorted, int p_count, double p_percentile) {
+	int index = (int) (p_percentile / 100.0 * p_count);
+	return p_sorted[index < p_count ? index : p_count - 1] / 1e3;
+}
+
+static void _bench_latency(bench_port *p_bench, int p_round_trips) {
+	int64_t *samples = malloc(sizeof(int64_t) * p_round_trips);
+	const uint8_t byte = 0x55;
+	godot_variant data;
+	mock_variant_new_bytes(&data, &byte, 1);
+
+	bench_peer echo;
+	_peer_start(&echo, PEER_ECHO, p_bench->master, 0);
+	for (int i = 0; i < p_round_trips; i++) {
+		const int64_t start = _now_nsec();
+		_write(p_bench, &data);
+		while (_call_int(p_bench, p_bench->serial->read, 0, NULL) < 0)
+			;
+		samples[i] = _now_nsec() - start;
+	}
+	_peer_stop(&echo);
+	api->godot_variant_destroy(&data);
+
+	qsort(samples, p_round_trips, sizeof(int64_t), _compare_int64);
+	printf("  %-8s p50 %7.1f  p90 %7.1f  p99 %7.1f  p99.9 %7.1f  max %8.1f us\n", p_bench->threaded ? "threaded" : "polled",
+			_percentile_usec(samples, p_round_trips, 50), _percentile_usec(samples, p_round_trips, 90),
+			_percentile_usec(samples, p_round_trips, 99), _percentile_usec(samples, p_round_trips, 99.9),
+			samples[p_round_trips - 1] / 1e3);
+	free(samples);
+}
+
+int main(int argc, char **argv) {
+	const int round_trips = argc > 1 ? atoi(argv[1]) : 10000;
+	if (round_trips <= 0) {
+		fprintf(stderr, "Usage: %s [round_trips]\n", argv[0]);
+		return 1;
+	}
+
+	bench_port bench;
+	const bool modes[] = { false, true };
+
+	printf("Per call overhead\n");
+	for (int m = 0; m < 2; m++) {
+		if (!_open(&bench, modes[m], SERIAL_PORT_DEFAULT_BUFFER_SIZE))
+			return 1;
+		_bench_calls(&bench);
+		_close(&bench);
+	}
+
+	printf("\nSustained throughput (64 KiB buffers)\n");
+	for (int m = 0; m < 2; m++) {
+		if (!_open(&bench, modes[m], 65536))
+			return 1;
+		for (int i = 0; i < (int) (sizeof(chunk_sizes) / sizeof(chunk_sizes[0])); i++)
+			_bench_write_throughput(&bench, chunk_sizes[i]);
+		for (int i = 0; i < (int) (sizeof(chunk_sizes) / sizeof(chunk_sizes[0])); i++)
+			_bench_read_throughput(&bench, chunk_sizes[i]);
+		_close(&bench);
+	}
+
+	printf("\nRound trip latency, %d x 1 byte through an echoing peer\n", round_trips);
+	for (int m = 0; m < 2; m++) {
+		if (!_open(&bench, modes[m], SERIAL_PORT_DEFAULT_BUFFER_SIZE))
+			return 1;
+		_bench_latency(&bench, round_trips);
+		_close(&bench);
+	}
+
+	godot_serial_terminate();
+	printf("\n%llu deferred calls made\n", (unsigned long long) mock_api_calls());
+	return 0;
+}
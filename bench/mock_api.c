@@ -0,0 +1,697 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "mock_api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every opaque GDNative type is at least a pointer wide; the mock keeps its own object there
+#define MOCK_PTR(p_opaque) (*(void **) (p_opaque))
+
+typedef struct {
+	godot_variant_type type;
+	union {
+		int64_t i;
+		double r;
+		void *p;
+	} value;
+} mock_variant;
+
+#define MOCK_VARIANT(p_variant) ((mock_variant *) (p_variant))
+
+typedef struct {
+	int length;
+	char data[];
+} mock_string;
+
+// Pool arrays, arrays and dictionaries all share this: a reference counted vector
+typedef struct {
+	volatile int refs;
+	int size;
+	int capacity;
+	int element_size;
+	uint8_t *data;
+} mock_vector;
+
+typedef struct {
+	mock_vector *keys;
+	mock_vector *values;
+} mock_dictionary;
+
+static volatile uint64_t _calls = 0;
+
+uint64_t mock_api_calls(void) {
+	return __atomic_load_n(&_calls, __ATOMIC_RELAXED);
+}
+
+// Strings
+
+static mock_string * _string_make(const char *p_data, int p_length) {
+	mock_string *string = malloc(sizeof(mock_string) + p_length + 1);
+	string->length = p_length;
+	memcpy(string->data, p_data, p_length);
+	string->data[p_length] = '\0';
+	return string;
+}
+
+static void _string_new(godot_string *r_dest) {
+	MOCK_PTR(r_dest) = _string_make("", 0);
+}
+
+static void _string_new_copy(godot_string *r_dest, const godot_string *p_src) {
+	const mock_string *src = MOCK_PTR(p_src);
+	MOCK_PTR(r_dest) = _string_make(src->data, src->length);
+}
+
+static void _string_destroy(godot_string *p_self) {
+	free(MOCK_PTR(p_self));
+}
+
+static godot_bool _string_parse_utf8_with_len(godot_string *p_self, const char *p_utf8, godot_int p_len) {
+	free(MOCK_PTR(p_self));
+	MOCK_PTR(p_self) = _string_make(p_utf8, p_len);
+	return false;
+}
+
+static godot_bool _string_parse_utf8(godot_string *p_self, const char *p_utf8) {
+	return _string_parse_utf8_with_len(p_self, p_utf8, strlen(p_utf8));
+}
+
+static godot_int _string_length(const godot_string *p_self) {
+	return ((const mock_string *) MOCK_PTR(p_self))->length;
+}
+
+static godot_bool _string_operator_equal(const godot_string *p_self, const godot_string *p_b) {
+	const mock_string *a = MOCK_PTR(p_self);
+	const mock_string *b = MOCK_PTR(p_b);
+	return a->length == b->length && memcmp(a->data, b->data, a->length) == 0;
+}
+
+// Strings are kept as UTF-8 already, so both conversions are a copy
+static godot_char_string _string_utf8(const godot_string *p_self) {
+	godot_char_string cs;
+	const mock_string *string = MOCK_PTR(p_self);
+	MOCK_PTR(&cs) = _string_make(string->data, string->length);
+	return cs;
+}
+
+static godot_int _char_string_length(const godot_char_string *p_cs) {
+	return ((const mock_string *) MOCK_PTR(p_cs))->length;
+}
+
+static const char * _char_string_get_data(const godot_char_string *p_cs) {
+	return ((const mock_string *) MOCK_PTR(p_cs))->data;
+}
+
+static void _char_string_destroy(godot_char_string *p_cs) {
+	free(MOCK_PTR(p_cs));
+}
+
+// Vectors
+
+static mock_vector * _vector_make(int p_element_size) {
+	mock_vector *vector = calloc(1, sizeof(mock_vector));
+	vector->refs = 1;
+	vector->element_size = p_element_size;
+	return vector;
+}
+
+static mock_vector * _vector_ref(mock_vector *p_vector) {
+	__atomic_add_fetch(&p_vector->refs, 1, __ATOMIC_RELAXED);
+	return p_vector;
+}
+
+static void _variant_destroy(godot_variant *p_self);
+
+static void _vector_unref(mock_vector *p_vector) {
+	if (__atomic_sub_fetch(&p_vector->refs, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+	// Arrays hold variants, which may own more memory
+	if (p_vector->element_size == sizeof(godot_variant)) {
+		for (int i = 0; i < p_vector->size; i++)
+			_variant_destroy((godot_variant *) p_vector->data + i);
+	}
+	free(p_vector->data);
+	free(p_vector);
+}
+
+static void _vector_resize(mock_vector *p_vector, int p_size) {
+	if (p_size > p_vector->capacity) {
+		p_vector->capacity = p_size > p_vector->capacity * 2 ? p_size : p_vector->capacity * 2;
+		p_vector->data = realloc(p_vector->data, (size_t) p_vector->capacity * p_vector->element_size);
+	}
+	if (p_size > p_vector->size)
+		memset(p_vector->data + (size_t) p_vector->size * p_vector->element_size, 0, (size_t) (p_size - p_vector->size) * p_vector->element_size);
+	p_vector->size = p_size;
+}
+
+// Copy on write: a shared vector is duplicated before it is modified
+static mock_vector * _vector_writable(void *p_opaque) {
+	mock_vector *vector = MOCK_PTR(p_opaque);
+	if (__atomic_load_n(&vector->refs, __ATOMIC_ACQUIRE) == 1)
+		return vector;
+
+	mock_vector *copy = _vector_make(vector->element_size);
+	_vector_resize(copy, vector->size);
+	memcpy(copy->data, vector->data, (size_t) vector->size * vector->element_size);
+	_vector_unref(vector);
+	MOCK_PTR(p_opaque) = copy;
+	return copy;
+}
+
+// Pool arrays: read and write accesses are the vector itself, nothing to release
+
+#define MOCK_POOL_ARRAY(m_name, m_type, m_element)                                                                      \
+	static void _##m_name##_new(m_type *r_dest) {                                                                      \
+		MOCK_PTR(r_dest) = _vector_make(sizeof(m_element));                                                           \
+	}                                                                                                                  \
+	static void _##m_name##_new_copy(m_type *r_dest, const m_type *p_src) {                                            \
+		MOCK_PTR(r_dest) = _vector_ref(MOCK_PTR(p_src));                                                               \
+	}                                                                                                                  \
+	static void _##m_name##_destroy(m_type *p_self) {                                                                  \
+		_vector_unref(MOCK_PTR(p_self));                                                                               \
+	}                                                                                                                  \
+	static void _##m_name##_resize(m_type *p_self, godot_int p_size) {                                                 \
+		_vector_resize(_vector_writable(p_self), p_size);                                                              \
+	}                                                                                                                  \
+	static godot_int _##m_name##_size(const m_type *p_self) {                                                          \
+		return ((const mock_vector *) MOCK_PTR(p_self))->size;                                                         \
+	}                                                                                                                  \
+	static m_type##_read_access * _##m_name##_read(const m_type *p_self) {                                             \
+		return (m_type##_read_access *) MOCK_PTR(p_self);                                                              \
+	}                                                                                                                  \
+	static const m_element * _##m_name##_read_access_ptr(const m_type##_read_access *p_read) {                         \
+		return (const m_element *) ((const mock_vector *) p_read)->data;                                               \
+	}                                                                                                                  \
+	static void _##m_name##_read_access_destroy(m_type##_read_access *p_read) {                                        \
+	}                                                                                                                  \
+	static m_type##_write_access * _##m_name##_write(m_type *p_self) {                                                 \
+		return (m_type##_write_access *) _vector_writable(p_self);                                                     \
+	}                                                                                                                  \
+	static m_element * _##m_name##_write_access_ptr(const m_type##_write_access *p_write) {                            \
+		return (m_element *) ((const mock_vector *) p_write)->data;                                                    \
+	}                                                                                                                  \
+	static void _##m_name##_write_access_destroy(m_type##_write_access *p_write) {                                     \
+	}
+
+MOCK_POOL_ARRAY(pool_byte_array, godot_pool_byte_array, uint8_t)
+MOCK_POOL_ARRAY(pool_int_array, godot_pool_int_array, godot_int)
+MOCK_POOL_ARRAY(pool_real_array, godot_pool_real_array, godot_real)
+
+// Arrays
+
+static void _variant_new_copy(godot_variant *r_dest, const godot_variant *p_src);
+
+static void _array_new(godot_array *r_dest) {
+	MOCK_PTR(r_dest) = _vector_make(sizeof(godot_variant));
+}
+
+static void _array_destroy(godot_array *p_self) {
+	_vector_unref(MOCK_PTR(p_self));
+}
+
+static godot_int _array_size(const godot_array *p_self) {
+	return ((const mock_vector *) MOCK_PTR(p_self))->size;
+}
+
+static void _array_resize(godot_array *p_self, godot_int p_size) {
+	mock_vector *vector = _vector_writable(p_self);
+	for (int i = p_size; i < vector->size; i++)
+		_variant_destroy((godot_variant *) vector->data + i);
+	_vector_resize(vector, p_size);
+}
+
+static void _array_set(godot_array *p_self, godot_int p_idx, const godot_variant *p_value) {
+	godot_variant *item = (godot_variant *) _vector_writable(p_self)->data + p_idx;
+	_variant_destroy(item);
+	_variant_new_copy(item, p_value);
+}
+
+static godot_variant _array_get(const godot_array *p_self, godot_int p_idx) {
+	godot_variant ret;
+	_variant_new_copy(&ret, (const godot_variant *) ((const mock_vector *) MOCK_PTR(p_self))->data + p_idx);
+	return ret;
+}
+
+static void _array_append(godot_array *p_self, const godot_variant *p_value) {
+	mock_vector *vector = _vector_writable(p_self);
+	_vector_resize(vector, vector->size + 1);
+	_variant_new_copy((godot_variant *) vector->data + vector->size - 1, p_value);
+}
+
+// Dictionaries: a pair of arrays, looked up linearly, which is plenty for options
+
+static godot_bool _variant_equal(const godot_variant *p_a, const godot_variant *p_b) {
+	const mock_variant *a = MOCK_VARIANT(p_a);
+	const mock_variant *b = MOCK_VARIANT(p_b);
+	if (a->type != b->type)
+		return false;
+	if (a->type == GODOT_VARIANT_TYPE_STRING)
+		return _string_operator_equal((const godot_string *) &a->value.p, (const godot_string *) &b->value.p);
+	return a->value.i == b->value.i;
+}
+
+static void _dictionary_new(godot_dictionary *r_dest) {
+	mock_vector *dictionary = _vector_make(sizeof(godot_array));
+	_vector_resize(dictionary, 2);
+	_array_new((godot_array *) dictionary->data);
+	_array_new((godot_array *) dictionary->data + 1);
+	MOCK_PTR(r_dest) = dictionary;
+}
+
+static void _dictionary_destroy(godot_dictionary *p_self) {
+	mock_vector *dictionary = MOCK_PTR(p_self);
+	if (__atomic_sub_fetch(&dictionary->refs, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+	_array_destroy((godot_array *) dictionary->data);
+	_array_destroy((godot_array *) dictionary->data + 1);
+	free(dictionary->data);
+	free(dictionary);
+}
+
+static int _dictionary_find(const godot_dictionary *p_self, const godot_variant *p_key) {
+	const godot_array *keys = (const godot_array *) ((const mock_vector *) MOCK_PTR(p_self))->data;
+	const mock_vector *vector = MOCK_PTR(keys);
+	for (int i = 0; i < vector->size; i++) {
+		if (_variant_equal((const godot_variant *) vector->data + i, p_key))
+			return i;
+	}
+	return -1;
+}
+
+static godot_bool _dictionary_has(const godot_dictionary *p_self, const godot_variant *p_key) {
+	return _dictionary_find(p_self, p_key) >= 0;
+}
+
+static godot_variant _dictionary_get(const godot_dictionary *p_self, const godot_variant *p_key) {
+	const int index = _dictionary_find(p_self, p_key);
+	if (index < 0) {
+		godot_variant ret;
+		MOCK_VARIANT(&ret)->type = GODOT_VARIANT_TYPE_NIL;
+		return ret;
+	}
+	return _array_get((const godot_array *) ((const mock_vector *) MOCK_PTR(p_self))->data + 1, index);
+}
+
+static void _dictionary_set(godot_dictionary *p_self, const godot_variant *p_key, const godot_variant *p_value) {
+	godot_array *arrays = (godot_array *) ((mock_vector *) MOCK_PTR(p_self))->data;
+	const int index = _dictionary_find(p_self, p_key);
+	if (index >= 0) {
+		_array_set(&arrays[1], index, p_value);
+	} else {
+		_array_append(&arrays[0], p_key);
+		_array_append(&arrays[1], p_value);
+	}
+}
+
+static godot_array _dictionary_keys(const godot_dictionary *p_self) {
+	godot_array keys;
+	MOCK_PTR(&keys) = _vector_ref(MOCK_PTR((const godot_array *) ((const mock_vector *) MOCK_PTR(p_self))->data));
+	return keys;
+}
+
+// Variants
+
+static void _variant_new_nil(godot_variant *r_dest) {
+	MOCK_VARIANT(r_dest)->type = GODOT_VARIANT_TYPE_NIL;
+	MOCK_VARIANT(r_dest)->value.p = NULL;
+}
+
+static void _variant_new_bool(godot_variant *r_dest, godot_bool p_b) {
+	MOCK_VARIANT(r_dest)->type = GODOT_VARIANT_TYPE_BOOL;
+	MOCK_VARIANT(r_dest)->value.i = p_b;
+}
+
+static void _variant_new_int(godot_variant *r_dest, int64_t p_i) {
+	MOCK_VARIANT(r_dest)->type = GODOT_VARIANT_TYPE_INT;
+	MOCK_VARIANT(r_dest)->value.i = p_i;
+}
+
+static void _variant_new_real(godot_variant *r_dest, double p_r) {
+	MOCK_VARIANT(r_dest)->type = GODOT_VARIANT_TYPE_REAL;
+	MOCK_VARIANT(r_dest)->value.r = p_r;
+}
+
+static void _variant_new_object(godot_variant *r_dest, const godot_object *p_obj) {
+	MOCK_VARIANT(r_dest)->type = GODOT_VARIANT_TYPE_OBJECT;
+	MOCK_VARIANT(r_dest)->value.p = (void *) p_obj;
+}
+
+static void _variant_new_string(godot_variant *r_dest, const godot_string *p_s) {
+	MOCK_VARIANT(r_dest)->type = GODOT_VARIANT_TYPE_STRING;
+	_string_new_copy((godot_string *) &MOCK_VARIANT(r_dest)->value.p, p_s);
+}
+
+static void _variant_new_shared(godot_variant *r_dest, godot_variant_type p_type, const void *p_opaque) {
+	MOCK_VARIANT(r_dest)->type = p_type;
+	MOCK_VARIANT(r_dest)->value.p = _vector_ref(MOCK_PTR(p_opaque));
+}
+
+static void _variant_new_pool_byte_array(godot_variant *r_dest, const godot_pool_byte_array *p_pba) {
+	_variant_new_shared(r_dest, GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY, p_pba);
+}
+
+static void _variant_new_pool_int_array(godot_variant *r_dest, const godot_pool_int_array *p_pia) {
+	_variant_new_shared(r_dest, GODOT_VARIANT_TYPE_POOL_INT_ARRAY, p_pia);
+}
+
+static void _variant_new_pool_real_array(godot_variant *r_dest, const godot_pool_real_array *p_pra) {
+	_variant_new_shared(r_dest, GODOT_VARIANT_TYPE_POOL_REAL_ARRAY, p_pra);
+}
+
+static void _variant_new_array(godot_variant *r_dest, const godot_array *p_arr) {
+	_variant_new_shared(r_dest, GODOT_VARIANT_TYPE_ARRAY, p_arr);
+}
+
+static void _variant_new_dictionary(godot_variant *r_dest, const godot_dictionary *p_dict) {
+	_variant_new_shared(r_dest, GODOT_VARIANT_TYPE_DICTIONARY, p_dict);
+}
+
+static void _variant_new_copy(godot_variant *r_dest, const godot_variant *p_src) {
+	const mock_variant *src = MOCK_VARIANT(p_src);
+	switch (src->type) {
+	case GODOT_VARIANT_TYPE_STRING:
+		_variant_new_string(r_dest, (const godot_string *) &src->value.p);
+		break;
+	case GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY:
+	case GODOT_VARIANT_TYPE_POOL_INT_ARRAY:
+	case GODOT_VARIANT_TYPE_POOL_REAL_ARRAY:
+	case GODOT_VARIANT_TYPE_ARRAY:
+	case GODOT_VARIANT_TYPE_DICTIONARY:
+		_variant_new_shared(r_dest, src->type, &src->value.p);
+		break;
+	default:
+		*MOCK_VARIANT(r_dest) = *src;
+	}
+}
+
+static void _variant_destroy(godot_variant *p_self) {
+	mock_variant *variant = MOCK_VARIANT(p_self);
+	switch (variant->type) {
+	case GODOT_VARIANT_TYPE_STRING:
+		_string_destroy((godot_string *) &variant->value.p);
+		break;
+	case GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY:
+	case GODOT_VARIANT_TYPE_POOL_INT_ARRAY:
+	case GODOT_VARIANT_TYPE_POOL_REAL_ARRAY:
+	case GODOT_VARIANT_TYPE_ARRAY:
+		_vector_unref(variant->value.p);
+		break;
+	case GODOT_VARIANT_TYPE_DICTIONARY:
+		_dictionary_destroy((godot_dictionary *) &variant->value.p);
+		break;
+	default:
+		break;
+	}
+	variant->type = GODOT_VARIANT_TYPE_NIL;
+}
+
+static godot_variant_type _variant_get_type(const godot_variant *p_self) {
+	return MOCK_VARIANT(p_self)->type;
+}
+
+static godot_bool _variant_as_bool(const godot_variant *p_self) {
+	const mock_variant *variant = MOCK_VARIANT(p_self);
+	return variant->type == GODOT_VARIANT_TYPE_REAL ? variant->value.r != 0 : variant->value.i != 0;
+}
+
+static int64_t _variant_as_int(const godot_variant *p_self) {
+	const mock_variant *variant = MOCK_VARIANT(p_self);
+	return variant->type == GODOT_VARIANT_TYPE_REAL ? (int64_t) variant->value.r : variant->value.i;
+}
+
+static double _variant_as_real(const godot_variant *p_self) {
+	const mock_variant *variant = MOCK_VARIANT(p_self);
+	return variant->type == GODOT_VARIANT_TYPE_REAL ? variant->value.r : (double) variant->value.i;
+}
+
+static godot_object * _variant_as_object(const godot_variant *p_self) {
+	const mock_variant *variant = MOCK_VARIANT(p_self);
+	return variant->type == GODOT_VARIANT_TYPE_OBJECT ? variant->value.p : NULL;
+}
+
+static godot_string _variant_as_string(const godot_variant *p_self) {
+	const mock_variant *variant = MOCK_VARIANT(p_self);
+	godot_string ret;
+	char buffer[32];
+
+	switch (variant->type) {
+	case GODOT_VARIANT_TYPE_STRING:
+		_string_new_copy(&ret, (const godot_string *) &variant->value.p);
+		return ret;
+	case GODOT_VARIANT_TYPE_BOOL:
+		snprintf(buffer, sizeof(buffer), "%s", variant->value.i ? "True" : "False");
+		break;
+	case GODOT_VARIANT_TYPE_INT:
+		snprintf(buffer, sizeof(buffer), "%lld", (long long) variant->value.i);
+		break;
+	case GODOT_VARIANT_TYPE_REAL:
+		snprintf(buffer, sizeof(buffer), "%g", variant->value.r);
+		break;
+	default:
+		buffer[0] = '\0';
+	}
+	MOCK_PTR(&ret) = _string_make(buffer, strlen(buffer));
+	return ret;
+}
+
+static godot_pool_byte_array _variant_as_pool_byte_array(const godot_variant *p_self) {
+	godot_pool_byte_array ret;
+	if (MOCK_VARIANT(p_self)->type == GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY)
+		MOCK_PTR(&ret) = _vector_ref(MOCK_VARIANT(p_self)->value.p);
+	else
+		_pool_byte_array_new(&ret);
+	return ret;
+}
+
+static godot_array _variant_as_array(const godot_variant *p_self) {
+	godot_array ret;
+	if (MOCK_VARIANT(p_self)->type == GODOT_VARIANT_TYPE_ARRAY)
+		MOCK_PTR(&ret) = _vector_ref(MOCK_VARIANT(p_self)->value.p);
+	else
+		_array_new(&ret);
+	return ret;
+}
+
+static godot_dictionary _variant_as_dictionary(const godot_variant *p_self) {
+	godot_dictionary ret;
+	if (MOCK_VARIANT(p_self)->type == GODOT_VARIANT_TYPE_DICTIONARY)
+		MOCK_PTR(&ret) = _vector_ref(MOCK_VARIANT(p_self)->value.p);
+	else
+		_dictionary_new(&ret);
+	return ret;
+}
+
+// Objects: there are none, so method calls only get counted, and emit_signal() remembered
+
+static char _binds[2];
+#define MOCK_EMIT_SIGNAL ((godot_method_bind *) &_binds[1])
+
+static uint64_t _signals = 0;
+static char _signal_name[64];
+static godot_variant _signal_argument;
+
+static godot_method_bind * _method_bind_get_method(const char *p_classname, const char *p_methodname) {
+	return (godot_method_bind *) &_binds[strcmp(p_methodname, "emit_signal") == 0];
+}
+
+static godot_variant _method_bind_call(godot_method_bind *p_method_bind, godot_object *p_instance, const godot_variant **p_args, const int p_num_args, godot_variant_call_error *p_call_error) {
+	godot_variant ret;
+	__atomic_add_fetch(&_calls, 1, __ATOMIC_RELAXED);
+	if (p_method_bind == MOCK_EMIT_SIGNAL && p_num_args > 0) {
+		const mock_string *name = MOCK_VARIANT(p_args[0])->type == GODOT_VARIANT_TYPE_STRING ? MOCK_VARIANT(p_args[0])->value.p : NULL;
+		snprintf(_signal_name, sizeof(_signal_name), "%s", name != NULL ? name->data : "");
+		if (_signals++ > 0)
+			_variant_destroy(&_signal_argument);
+		if (p_num_args > 1)
+			_variant_new_copy(&_signal_argument, p_args[1]);
+		else
+			_variant_new_nil(&_signal_argument);
+	}
+	if (p_call_error != NULL)
+		p_call_error->error = GODOT_CALL_ERROR_CALL_OK;
+	_variant_new_nil(&ret);
+	return ret;
+}
+
+// Memory and messages
+
+static void * _alloc(int p_bytes) {
+	return malloc(p_bytes);
+}
+
+static void * _realloc(void *p_ptr, int p_bytes) {
+	return realloc(p_ptr, p_bytes);
+}
+
+static void _free(void *p_ptr) {
+	free(p_ptr);
+}
+
+static void _print_error(const char *p_description, const char *p_function, const char *p_file, int p_line) {
+	fprintf(stderr, "ERROR: %s (%s, %s:%i)\n", p_description, p_function, p_file, p_line);
+}
+
+static void _print(const godot_string *p_message) {
+	printf("%s\n", ((const mock_string *) MOCK_PTR(p_message))->data);
+}
+
+const godot_gdnative_core_api_struct mock_api = {
+	.godot_alloc = _alloc,
+	.godot_realloc = _realloc,
+	.godot_free = _free,
+	.godot_print_error = _print_error,
+	.godot_print_warning = _print_error,
+	.godot_print = _print,
+
+	.godot_string_new = _string_new,
+	.godot_string_new_copy = _string_new_copy,
+	.godot_string_destroy = _string_destroy,
+	.godot_string_parse_utf8 = _string_parse_utf8,
+	.godot_string_parse_utf8_with_len = _string_parse_utf8_with_len,
+	.godot_string_length = _string_length,
+	.godot_string_operator_equal = _string_operator_equal,
+	.godot_string_ascii = _string_utf8,
+	.godot_string_utf8 = _string_utf8,
+	.godot_char_string_length = _char_string_length,
+	.godot_char_string_get_data = _char_string_get_data,
+	.godot_char_string_destroy = _char_string_destroy,
+
+	.godot_pool_byte_array_new = _pool_byte_array_new,
+	.godot_pool_byte_array_new_copy = _pool_byte_array_new_copy,
+	.godot_pool_byte_array_destroy = _pool_byte_array_destroy,
+	.godot_pool_byte_array_resize = _pool_byte_array_resize,
+	.godot_pool_byte_array_size = _pool_byte_array_size,
+	.godot_pool_byte_array_read = _pool_byte_array_read,
+	.godot_pool_byte_array_read_access_ptr = _pool_byte_array_read_access_ptr,
+	.godot_pool_byte_array_read_access_destroy = _pool_byte_array_read_access_destroy,
+	.godot_pool_byte_array_write = _pool_byte_array_write,
+	.godot_pool_byte_array_write_access_ptr = _pool_byte_array_write_access_ptr,
+	.godot_pool_byte_array_write_access_destroy = _pool_byte_array_write_access_destroy,
+
+	.godot_pool_int_array_new = _pool_int_array_new,
+	.godot_pool_int_array_new_copy = _pool_int_array_new_copy,
+	.godot_pool_int_array_destroy = _pool_int_array_destroy,
+	.godot_pool_int_array_resize = _pool_int_array_resize,
+	.godot_pool_int_array_size = _pool_int_array_size,
+	.godot_pool_int_array_read = _pool_int_array_read,
+	.godot_pool_int_array_read_access_ptr = _pool_int_array_read_access_ptr,
+	.godot_pool_int_array_read_access_destroy = _pool_int_array_read_access_destroy,
+	.godot_pool_int_array_write = _pool_int_array_write,
+	.godot_pool_int_array_write_access_ptr = _pool_int_array_write_access_ptr,
+	.godot_pool_int_array_write_access_destroy = _pool_int_array_write_access_destroy,
+
+	.godot_pool_real_array_new = _pool_real_array_new,
+	.godot_pool_real_array_new_copy = _pool_real_array_new_copy,
+	.godot_pool_real_array_destroy = _pool_real_array_destroy,
+	.godot_pool_real_array_resize = _pool_real_array_resize,
+	.godot_pool_real_array_size = _pool_real_array_size,
+	.godot_pool_real_array_read = _pool_real_array_read,
+	.godot_pool_real_array_read_access_ptr = _pool_real_array_read_access_ptr,
+	.godot_pool_real_array_read_access_destroy = _pool_real_array_read_access_destroy,
+	.godot_pool_real_array_write = _pool_real_array_write,
+	.godot_pool_real_array_write_access_ptr = _pool_real_array_write_access_ptr,
+	.godot_pool_real_array_write_access_destroy = _pool_real_array_write_access_destroy,
+
+	.godot_array_new = _array_new,
+	.godot_array_destroy = _array_destroy,
+	.godot_array_size = _array_size,
+	.godot_array_resize = _array_resize,
+	.godot_array_set = _array_set,
+	.godot_array_get = _array_get,
+	.godot_array_append = _array_append,
+
+	.godot_dictionary_new = _dictionary_new,
+	.godot_dictionary_destroy = _dictionary_destroy,
+	.godot_dictionary_has = _dictionary_has,
+	.godot_dictionary_get = _dictionary_get,
+	.godot_dictionary_set = _dictionary_set,
+	.godot_dictionary_keys = _dictionary_keys,
+
+	.godot_variant_new_nil = _variant_new_nil,
+	.godot_variant_new_bool = _variant_new_bool,
+	.godot_variant_new_int = _variant_new_int,
+	.godot_variant_new_real = _variant_new_real,
+	.godot_variant_new_object = _variant_new_object,
+	.godot_variant_new_string = _variant_new_string,
+	.godot_variant_new_pool_byte_array = _variant_new_pool_byte_array,
+	.godot_variant_new_pool_int_array = _variant_new_pool_int_array,
+	.godot_variant_new_pool_real_array = _variant_new_pool_real_array,
+	.godot_variant_new_array = _variant_new_array,
+	.godot_variant_new_dictionary = _variant_new_dictionary,
+	.godot_variant_new_copy = _variant_new_copy,
+	.godot_variant_destroy = _variant_destroy,
+	.godot_variant_get_type = _variant_get_type,
+	.godot_variant_as_bool = _variant_as_bool,
+	.godot_variant_as_int = _variant_as_int,
+	.godot_variant_as_real = _variant_as_real,
+	.godot_variant_as_object = _variant_as_object,
+	.godot_variant_as_string = _variant_as_string,
+	.godot_variant_as_pool_byte_array = _variant_as_pool_byte_array,
+	.godot_variant_as_array = _variant_as_array,
+	.godot_variant_as_dictionary = _variant_as_dictionary,
+
+	.godot_method_bind_get_method = _method_bind_get_method,
+	.godot_method_bind_call = _method_bind_call,
+};
+
+void mock_variant_new_cstring(godot_variant *r_variant, const char *p_value) {
+	MOCK_VARIANT(r_variant)->type = GODOT_VARIANT_TYPE_STRING;
+	MOCK_VARIANT(r_variant)->value.p = _string_make(p_value, strlen(p_value));
+}
+
+void mock_variant_new_bytes(godot_variant *r_variant, const uint8_t *p_data, int p_length) {
+	godot_pool_byte_array bytes;
+	_pool_byte_array_new(&bytes);
+	_pool_byte_array_resize(&bytes, p_length);
+	memcpy(((mock_vector *) MOCK_PTR(&bytes))->data, p_data, p_length);
+	_variant_new_pool_byte_array(r_variant, &bytes);
+	_pool_byte_array_destroy(&bytes);
+}
+
+const uint8_t * mock_variant_bytes(const godot_variant *p_variant, int *r_length) {
+	if (MOCK_VARIANT(p_variant)->type != GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY) {
+		*r_length = 0;
+		return NULL;
+	}
+	const mock_vector *vector = MOCK_VARIANT(p_variant)->value.p;
+	*r_length = vector->size;
+	return vector->data;
+}
+
+uint64_t mock_api_signals(void) {
+	return _signals;
+}
+
+const char * mock_api_last_signal(const godot_variant **r_argument) {
+	*r_argument = &_signal_argument;
+	return _signal_name;
+}
+
+const char * mock_variant_cstring(const godot_variant *p_variant) {
+	if (MOCK_VARIANT(p_variant)->type != GODOT_VARIANT_TYPE_STRING)
+		return NULL;
+	return ((const mock_string *) MOCK_VARIANT(p_variant)->value.p)->data;
+}
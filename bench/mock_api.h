@@ -0,0 +1,55 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef MOCK_API_H
+#define MOCK_API_H
+
+#include <gdnative_api_struct.gen.h>
+#include <stdint.h>
+
+// A stand-in for the engine side of the GDNative core API, so the benchmark can drive a
+// godot_serial_interface table from a plain executable. Variants, strings, pool arrays,
+// arrays and dictionaries own their memory the way the engine's do (pool arrays, arrays
+// and dictionaries are reference counted, pool arrays copy on write), so the cost of
+// what the plugin allocates and frees shows up in the measurements.
+
+extern const godot_gdnative_core_api_struct mock_api;
+
+// Number of method bind calls made so far, e.g. call_deferred() from an I/O thread
+uint64_t mock_api_calls(void);
+// Signals emitted straight through emit_signal() so far, as dispatch_notifications() does; those
+// going through call_deferred() are only counted above. Only for the main thread.
+uint64_t mock_api_signals(void);
+// Name of the last of them, and its first argument (nil if none), valid until the next one
+const char *mock_api_last_signal(const godot_variant **r_argument);
+
+// Shortcuts for building arguments and looking at results
+void mock_variant_new_cstring(godot_variant *r_variant, const char *p_value);
+void mock_variant_new_bytes(godot_variant *r_variant, const uint8_t *p_data, int p_length);
+// Pointer to the bytes of a PoolByteArray variant, valid until the variant is destroyed
+const uint8_t *mock_variant_bytes(const godot_variant *p_variant, int *r_length);
+// Characters of a String variant, NULL for any other type
+const char *mock_variant_cstring(const godot_variant *p_variant);
+
+#endif // MOCK_API_H
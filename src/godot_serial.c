@@ -24,11 +24,13 @@
 
 #include <gdnative_api_struct.gen.h>
 #include "serial_interface.h"
+#include "serial_config.h"
 
 const godot_gdnative_core_api_struct *api = NULL;
 const godot_gdnative_ext_nativescript_api_struct *nativescript_api = NULL;
 
 static GDCALLINGCONV godot_variant get_version(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+static void register_signal(void *p_handle, const char *p_class_name, const char *p_signal_name, const char *p_arg_name, godot_variant_type p_arg_type);
 
 void GDN_EXPORT godot_gdnative_init(godot_gdnative_init_options *p_options) {
 	api = p_options->api_struct;
@@ -46,18 +48,20 @@ void GDN_EXPORT godot_gdnative_init(godot_gdnative_init_options *p_options) {
 }
 
 void GDN_EXPORT godot_gdnative_terminate(godot_gdnative_terminate_options *p_options) {
+	godot_serial_terminate();
 	api = NULL;
 	nativescript_api = NULL;
 }
 
-void GDN_EXPORT godot_nativescript_init(void *p_handle) {
+// Registers p_class_name with the methods and signals of a port backed by p_implementation
+static void register_port_class(void *p_handle, const char *p_class_name, godot_serial_interface *p_implementation) {
 	godot_instance_create_func create = { NULL, NULL, NULL };
-	create.create_func = godot_serial_implementation.constructor;
+	create.create_func = p_implementation->constructor;
 
 	godot_instance_destroy_func destroy = { NULL, NULL, NULL };
-	destroy.destroy_func = godot_serial_implementation.destructor;
+	destroy.destroy_func = p_implementation->destructor;
 
-	nativescript_api->godot_nativescript_register_class(p_handle, "Serial", "Reference", create, destroy);
+	nativescript_api->godot_nativescript_register_class(p_handle, p_class_name, "Reference", create, destroy);
 
 	// exclude version info, constructor and destructor
 	#define n_methods (sizeof(godot_serial_interface) / sizeof(godot_variant (*)(godot_object *, void *, void *, int , godot_variant **)) - 3)
@@ -66,16 +70,40 @@ void GDN_EXPORT godot_nativescript_init(void *p_handle) {
 		GDCALLINGCONV godot_variant (*method_ptr)(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
 		const char *method_name;
 	} method_list[n_methods] = {
-		{godot_serial_implementation.open, "open"},
-		{godot_serial_implementation.close, "close"},
-		{godot_serial_implementation.is_connected, "is_connected"},
-		{godot_serial_implementation.available_for_read, "available"},
-		{godot_serial_implementation.available_for_write, "available_for_write"},
-		{godot_serial_implementation.flush, "flush"},
-		{godot_serial_implementation.peek, "peek"},
-		{godot_serial_implementation.read, "read"},
-		{godot_serial_implementation.read_string, "read_string"},
-		{godot_serial_implementation.write, "write"},
+		{p_implementation->open, "open"},
+		{p_implementation->close, "close"},
+		{p_implementation->is_connected, "is_connected"},
+		{p_implementation->available_for_read, "available"},
+		{p_implementation->available_for_write, "available_for_write"},
+		{p_implementation->flush, "flush"},
+		{p_implementation->peek, "peek"},
+		{p_implementation->read, "read"},
+		{p_implementation->read_string, "read_string"},
+		{p_implementation->write, "write"},
+		{p_implementation->set_timeout, "set_timeout"},
+		{p_implementation->get_overflow_count, "get_overflow_count"},
+		{p_implementation->read_bytes, "read_bytes"},
+		{p_implementation->read_all, "read_all"},
+		{p_implementation->read_line, "read_line"},
+		{p_implementation->read_until, "read_until"},
+		{p_implementation->read_packet, "read_packet"},
+		{p_implementation->write_packet, "write_packet"},
+		{p_implementation->get_rejected_frames, "get_rejected_frames"},
+		{p_implementation->unpack, "unpack"},
+		{p_implementation->list_ports, "list_ports"},
+		{p_implementation->get_stats, "get_stats"},
+		{p_implementation->read_with_timestamps, "read_with_timestamps"},
+		{p_implementation->get_latency_settings, "get_latency_settings"},
+		{p_implementation->transact, "transact"},
+		{p_implementation->record, "record"},
+		{p_implementation->modbus_poll, "modbus_poll"},
+		{p_implementation->reconfigure, "reconfigure"},
+		{p_implementation->set_rts, "set_rts"},
+		{p_implementation->set_dtr, "set_dtr"},
+		{p_implementation->send_break, "send_break"},
+		{p_implementation->get_modem_lines, "get_modem_lines"},
+		{p_implementation->dispatch_notifications, "_dispatch_notifications"},
+		{p_implementation->check_connection, "_check_connection"},
 	};
 
 	godot_instance_method method_struct = { NULL, NULL, NULL };
@@ -83,12 +111,93 @@ void GDN_EXPORT godot_nativescript_init(void *p_handle) {
 	
 	for (int i=0; i < n_methods; i++) {
 		method_struct.method = method_list[i].method_ptr;
-		nativescript_api->godot_nativescript_register_method(p_handle, "Serial", method_list[i].method_name, attributes, method_struct);
+		nativescript_api->godot_nativescript_register_method(p_handle, p_class_name, method_list[i].method_name, attributes, method_struct);
 	}
 	
 	method_struct.method = get_version;
-	method_struct.method_data = &godot_serial_implementation.version;
-	nativescript_api->godot_nativescript_register_method(p_handle, "Serial", "get_version", attributes, method_struct);
+	method_struct.method_data = &p_implementation->version;
+	nativescript_api->godot_nativescript_register_method(p_handle, p_class_name, "get_version", attributes, method_struct);
+
+	// emitted by threaded ports once every queued byte has been handed to the OS
+	register_signal(p_handle, p_class_name, "write_completed", NULL, GODOT_VARIANT_TYPE_NIL);
+	// emitted instead of polling, depending on the "notify" option given to open()
+	register_signal(p_handle, p_class_name, "data_received", "bytes", GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY);
+	register_signal(p_handle, p_class_name, "line_received", "line", GODOT_VARIANT_TYPE_STRING);
+	register_signal(p_handle, p_class_name, "packet_received", "packet", GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY);
+	register_signal(p_handle, p_class_name, "chunks_received", "chunks", GODOT_VARIANT_TYPE_ARRAY);
+	// emitted once per transact(), with the response, or empty if it did not come in time
+	register_signal(p_handle, p_class_name, "transaction_completed", "response", GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY);
+	// emitted once per modbus_poll(), with what each request came to
+	register_signal(p_handle, p_class_name, "modbus_completed", "results", GODOT_VARIANT_TYPE_ARRAY);
+	// emitted by ports opened with "modem_events" on every change of CTS, DSR, DCD or RI
+	register_signal(p_handle, p_class_name, "modem_lines_changed", "lines", GODOT_VARIANT_TYPE_DICTIONARY);
+	// emitted by threaded ports once the break of send_break() is over, or could not be sent
+	register_signal(p_handle, p_class_name, "break_completed", "success", GODOT_VARIANT_TYPE_BOOL);
+}
+
+void GDN_EXPORT godot_nativescript_init(void *p_handle) {
+	register_port_class(p_handle, "Serial", &godot_serial_implementation);
+	register_port_class(p_handle, "VirtualSerial", &godot_serial_virtual_implementation);
+	register_port_class(p_handle, "SerialReplay", &godot_serial_replay_implementation);
+
+	godot_instance_create_func create = { NULL, NULL, NULL };
+	godot_instance_destroy_func destroy = { NULL, NULL, NULL };
+	godot_instance_method method_struct = { NULL, NULL, NULL };
+	godot_method_attributes attributes = { GODOT_METHOD_RPC_MODE_DISABLED };
+
+	create.create_func = godot_serial_hub_implementation.constructor;
+	destroy.destroy_func = godot_serial_hub_implementation.destructor;
+	nativescript_api->godot_nativescript_register_class(p_handle, "SerialHub", "Reference", create, destroy);
+
+	method_struct.method = godot_serial_hub_implementation.poll;
+	method_struct.method_data = NULL;
+	nativescript_api->godot_nativescript_register_method(p_handle, "SerialHub", "poll", attributes, method_struct);
+
+	// A Resource, so it can be kept in a scene or an exported variable and handed to any port
+	create.create_func = serial_config_constructor;
+	destroy.destroy_func = serial_config_destructor;
+	nativescript_api->godot_nativescript_register_class(p_handle, "SerialConfig", "Resource", create, destroy);
+
+	struct {
+		GDCALLINGCONV godot_variant (*method_ptr)(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+		const char *method_name;
+	} config_methods[] = {
+		{serial_config_setup, "setup"},
+		{serial_config_is_valid, "is_valid"},
+		{serial_config_get_baudrate, "get_baudrate"},
+		{serial_config_get_config, "get_config"},
+		{serial_config_get_options, "get_options"},
+	};
+	for (int i = 0; i < (int) (sizeof(config_methods) / sizeof(config_methods[0])); i++) {
+		method_struct.method = config_methods[i].method_ptr;
+		nativescript_api->godot_nativescript_register_method(p_handle, "SerialConfig", config_methods[i].method_name, attributes, method_struct);
+	}
+}
+
+// Signals carry at most one argument, described by p_arg_name and p_arg_type
+static void register_signal(void *p_handle, const char *p_class_name, const char *p_signal_name, const char *p_arg_name, godot_variant_type p_arg_type) {
+	godot_signal signal = { 0 };
+	godot_signal_argument arg = { 0 };
+	api->godot_string_new(&signal.name);
+	api->godot_string_parse_utf8(&signal.name, p_signal_name);
+
+	api->godot_string_new(&arg.name);
+	api->godot_string_new(&arg.hint_string);
+	api->godot_variant_new_nil(&arg.default_value);
+	if (p_arg_name != NULL) {
+		api->godot_string_parse_utf8(&arg.name, p_arg_name);
+		arg.type = p_arg_type;
+		arg.usage = GODOT_PROPERTY_USAGE_DEFAULT;
+		signal.num_args = 1;
+		signal.args = &arg;
+	}
+
+	nativescript_api->godot_nativescript_register_signal(p_handle, p_class_name, &signal);
+
+	api->godot_variant_destroy(&arg.default_value);
+	api->godot_string_destroy(&arg.hint_string);
+	api->godot_string_destroy(&arg.name);
+	api->godot_string_destroy(&signal.name);
 }
 
 static GDCALLINGCONV godot_variant get_version(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
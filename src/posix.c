@@ -0,0 +1,1734 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+// The Linux backend: it waits on epoll, eventfd and timerfd, and finds devices through sysfs and inotify
+#if !defined(__linux__)
+#error "posix.c is the Linux backend; there is none for other POSIX systems"
+#endif
+
+#include "godot_serial.h"
+#include "serial_interface.h"
+#include "serial_port.h"
+#include "serial_hub.h"
+#include "serial_atomic.h"
+#include "serial_thread.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
+#include <linux/serial.h>
+
+// Options of open() only Serial on Linux understands, undone again when the port is closed:
+//   "low_latency": bool - have the driver hand received bytes over as soon as they arrive instead
+//                         of batching them (ASYNC_LOW_LATENCY), and use a 1 ms "latency_timer_ms"
+//                         unless told otherwise (default false)
+//   "latency_timer_ms": int - how long USB adapters with a latency timer, such as FTDI's, hold on
+//                             to received bytes before passing them on, 1 to 255 (default untouched)
+// get_latency_settings() reports what the driver ended up with.
+
+#define IO_LOOP_MAX_EVENTS 32
+
+// How often the I/O thread reads the modem lines of a port opened with "modem_events"
+#define MODEM_POLL_USEC 2000
+// How often a break looks again whether the driver has sent what was queued before it
+#define BREAK_POLL_USEC 1000
+
+typedef struct data_struct data_struct;
+
+// What an epoll event of an I/O loop refers to
+typedef struct {
+	data_struct *port; // NULL for the loop's own eventfd
+	bool is_wake;      // an eventfd rather than the port's descriptor
+	bool is_timer;     // the timerfd ending the port's transaction
+	bool is_line;      // the timerfd polling the modem lines and timing breaks
+} io_source;
+
+// A thread servicing every port attached to it from a single epoll instance:
+// either one port opened with "threaded", or all the ports of a SerialHub
+typedef struct {
+	pthread_t thread;
+	int epoll_fd;
+	int wake_fd;
+	io_source source;
+	bool running;
+	volatile uint32_t stop_requested;
+
+	// Removing a port waits for barrier_passed to catch up with barrier_requested,
+	// so no event fetched before the removal can still refer to it
+	volatile uint32_t barrier_requested;
+	volatile uint32_t barrier_passed;
+} io_loop;
+
+struct data_struct {
+	serial_port base;
+
+	int fd;
+	int epoll_fd;
+
+	// I/O loop servicing the port while it is threaded: its own, or the one of its hub
+	io_loop own_loop;
+	io_loop *loop;
+	int wake_fd;
+	int timer_fd;
+	io_source port_source;
+	io_source wake_source;
+	io_source timer_source;
+	int line_timer_fd;
+	io_source line_source;
+
+	// Only touched by the loop thread, on line_timer_fd: when the modem lines of a port opened with
+	// "modem_events" are next read (-1 for never), and when the break on the line ends (0 while
+	// none is on)
+	int64_t modem_poll_at;
+	int64_t break_end;
+
+	// Only touched by the loop thread
+	bool watching_out; // EPOLLOUT is only armed while the port pushes back
+	bool reading;      // EPOLLIN is dropped while rx is full, leaving the bytes to the driver
+	bool sent;         // bytes went out since the queue was last empty
+	bool hung_up;
+	bool touched;      // already listed among the ports to service after this round of events
+
+	// UART error counters of the driver, when it keeps them: what they were when the device
+	// was last opened, and what earlier connections since open() went through
+	bool counts_line_errors;
+	bool line_errors_opened_valid;
+	serial_line_errors line_errors_opened;
+	serial_line_errors line_errors_before;
+	// The driver's buffer overrun count when reading stopped, to tell what it dropped meanwhile
+	bool overruns_paused_valid;
+	uint64_t overruns_paused;
+
+	// Latency settings asked for in open(), and how to undo what the driver took of them:
+	// whether we switched ASYNC_LOW_LATENCY on, and the latency timer to write back (-1 for none)
+	bool low_latency;
+	int latency_timer_ms; // 0 to leave the timer alone
+	bool low_latency_set;
+	int latency_timer_restore;
+	char latency_timer_path[PATH_MAX]; // empty when the device has no latency timer
+
+	// Next port opened with "reconnect", guarded by _enum_lock
+	data_struct *next_reconnecting;
+};
+
+typedef struct {
+	serial_hub base;
+	io_loop loop; // started along with the first port
+} hub_struct;
+
+static int _read_and_buffer(serial_port *p_port);
+static void _resume_rx(serial_port *p_port);
+static void _loop_init(io_loop *p_loop);
+static const char * _sysfs_root(void);
+static bool _read_attribute(const char *p_path, char *r_value, size_t p_size);
+
+static GDCALLINGCONV void * constructor(godot_object *p_instance, void *p_method_data) {
+	data_struct *data = api->godot_alloc(sizeof(data_struct));
+	serial_port_init(&data->base, p_instance, _read_and_buffer);
+	data->base.resume_rx = _resume_rx;
+
+	data->fd = -1;
+	data->epoll_fd = -1;
+
+	_loop_init(&data->own_loop);
+	data->loop = NULL;
+	data->wake_fd = -1;
+	data->timer_fd = -1;
+	data->line_timer_fd = -1;
+	data->port_source.port = data;
+	data->port_source.is_wake = false;
+	data->port_source.is_timer = false;
+	data->port_source.is_line = false;
+	data->wake_source.port = data;
+	data->wake_source.is_wake = true;
+	data->wake_source.is_timer = false;
+	data->wake_source.is_line = false;
+	data->timer_source.port = data;
+	data->timer_source.is_wake = false;
+	data->timer_source.is_timer = true;
+	data->timer_source.is_line = false;
+	data->line_source.port = data;
+	data->line_source.is_wake = false;
+	data->line_source.is_timer = false;
+	data->line_source.is_line = true;
+	data->modem_poll_at = -1;
+	data->break_end = 0;
+
+	data->counts_line_errors = false;
+	data->line_errors_opened_valid = false;
+	memset(&data->line_errors_before, 0, sizeof(data->line_errors_before));
+	data->overruns_paused_valid = false;
+
+	data->low_latency = false;
+	data->latency_timer_ms = 0;
+	data->low_latency_set = false;
+	data->latency_timer_restore = -1;
+	data->latency_timer_path[0] = '\0';
+
+	data->next_reconnecting = NULL;
+
+	return data;
+}
+
+static void _wake_io_thread(data_struct * user_data) {
+	uint64_t one = 1;
+	while (write(user_data->wake_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+static void _resume_rx(serial_port *p_port) {
+	_wake_io_thread((data_struct *) p_port);
+}
+
+// Gives the I/O thread up to p_timeout_ms (forever if negative) to send everything queued
+static bool _wait_tx_empty(data_struct * user_data, int p_timeout_ms) {
+	for (int waited = 0; serial_port_tx_pending(&user_data->base) > 0; waited++) {
+		if (p_timeout_ms >= 0 && waited >= p_timeout_ms)
+			return false;
+		usleep(1000);
+	}
+	return true;
+}
+
+static void _loop_init(io_loop *p_loop) {
+	p_loop->epoll_fd = -1;
+	p_loop->wake_fd = -1;
+	p_loop->source.port = NULL;
+	p_loop->source.is_wake = true;
+	p_loop->source.is_timer = false;
+	p_loop->source.is_line = false;
+	p_loop->running = false;
+	p_loop->stop_requested = 0;
+	p_loop->barrier_requested = 0;
+	p_loop->barrier_passed = 0;
+}
+
+static void _loop_wake(io_loop *p_loop) {
+	uint64_t one = 1;
+	while (write(p_loop->wake_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+static void * _loop_main(void *p_data);
+
+static bool _loop_start(io_loop *p_loop) {
+	if (p_loop->running)
+		return true;
+
+	p_loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	p_loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (p_loop->epoll_fd < 0 || p_loop->wake_fd < 0) {
+		fprintf(stderr, "Error creating I/O thread descriptors: %s\n", strerror(errno));
+		goto fail;
+	}
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = &p_loop->source;
+	if (epoll_ctl(p_loop->epoll_fd, EPOLL_CTL_ADD, p_loop->wake_fd, &ev) != 0)
+		goto fail;
+
+	serial_atomic_store_u32(&p_loop->stop_requested, 0);
+	if (pthread_create(&p_loop->thread, NULL, _loop_main, p_loop) != 0) {
+		fprintf(stderr, "Error starting I/O thread\n");
+		goto fail;
+	}
+	p_loop->running = true;
+	return true;
+
+fail:
+	if (p_loop->epoll_fd >= 0)
+		close(p_loop->epoll_fd);
+	if (p_loop->wake_fd >= 0)
+		close(p_loop->wake_fd);
+	p_loop->epoll_fd = -1;
+	p_loop->wake_fd = -1;
+	return false;
+}
+
+static void _loop_stop(io_loop *p_loop) {
+	if (!p_loop->running)
+		return;
+
+	serial_atomic_store_u32(&p_loop->stop_requested, 1);
+	_loop_wake(p_loop);
+	pthread_join(p_loop->thread, NULL);
+
+	close(p_loop->epoll_fd);
+	close(p_loop->wake_fd);
+	p_loop->epoll_fd = -1;
+	p_loop->wake_fd = -1;
+	p_loop->running = false;
+}
+
+// Returns once the loop thread is done with every event it fetched before the call
+static void _loop_barrier(io_loop *p_loop) {
+	const uint32_t barrier = p_loop->barrier_requested + 1;
+	serial_atomic_store_u32(&p_loop->barrier_requested, barrier);
+	_loop_wake(p_loop);
+	while ((int32_t) (serial_atomic_load_u32(&p_loop->barrier_passed) - barrier) < 0)
+		usleep(100);
+}
+
+static uint32_t _modem_lines(int p_bits) {
+	return (p_bits & TIOCM_CTS ? SERIAL_MODEM_CTS : 0) | (p_bits & TIOCM_DSR ? SERIAL_MODEM_DSR : 0) |
+	       (p_bits & TIOCM_CD ? SERIAL_MODEM_DCD : 0) | (p_bits & TIOCM_RNG ? SERIAL_MODEM_RI : 0) |
+	       (p_bits & TIOCM_RTS ? SERIAL_MODEM_RTS : 0) | (p_bits & TIOCM_DTR ? SERIAL_MODEM_DTR : 0);
+}
+
+static void _stop_io_thread(data_struct * user_data) {
+	io_loop *loop = user_data->loop;
+	if (loop != NULL) {
+		// Let queued writes go out before closing, without hanging on a stalled device
+		_wait_tx_empty(user_data, 250);
+
+		epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, user_data->fd, NULL);
+		epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, user_data->wake_fd, NULL);
+		epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, user_data->timer_fd, NULL);
+		epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, user_data->line_timer_fd, NULL);
+		if (loop == &user_data->own_loop)
+			_loop_stop(loop);
+		else
+			_loop_barrier(loop);
+
+		close(user_data->wake_fd);
+		user_data->wake_fd = -1;
+		user_data->loop = NULL;
+	}
+	if (user_data->timer_fd >= 0) {
+		close(user_data->timer_fd);
+		user_data->timer_fd = -1;
+	}
+	if (user_data->line_timer_fd >= 0) {
+		close(user_data->line_timer_fd);
+		user_data->line_timer_fd = -1;
+	}
+	// A break cut short by close() is not reported; the line must not stay in it
+	if (user_data->break_end != 0 && user_data->fd >= 0)
+		ioctl(user_data->fd, TIOCCBRK);
+	user_data->break_end = 0;
+	user_data->modem_poll_at = -1;
+	user_data->base.break_ms = 0;
+	// Also covers a loop started for a port that then failed to join it
+	_loop_stop(&user_data->own_loop);
+	// Nothing is left to wake up once there is room
+	user_data->base.rx_paused = 0;
+	user_data->base.threaded = false;
+}
+
+// Reads the error counters of the UART behind p_fd, which only some drivers keep
+static bool _read_line_errors(int p_fd, serial_line_errors *r_errors) {
+#if defined(TIOCGICOUNT)
+	struct serial_icounter_struct icount;
+	if (ioctl(p_fd, TIOCGICOUNT, &icount) != 0)
+		return false;
+	r_errors->frame_errors = icount.frame;
+	r_errors->parity_errors = icount.parity;
+	r_errors->overruns = (uint64_t) icount.overrun + icount.buf_overrun;
+	r_errors->breaks = icount.brk;
+	return true;
+#else
+	return false;
+#endif
+}
+
+// What the tty layer of p_fd dropped for want of buffer space, which only some drivers count
+static bool _read_buf_overruns(int p_fd, uint64_t *r_overruns) {
+#if defined(TIOCGICOUNT)
+	struct serial_icounter_struct icount;
+	if (ioctl(p_fd, TIOCGICOUNT, &icount) != 0)
+		return false;
+	*r_overruns = icount.buf_overrun;
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Errors since open(), across reconnections. Returns whether the driver counts them at all.
+static bool _line_errors(data_struct * user_data, serial_line_errors *r_errors) {
+	serial_line_errors now;
+	*r_errors = user_data->line_errors_before;
+	if (user_data->line_errors_opened_valid && _read_line_errors(user_data->fd, &now)) {
+		r_errors->frame_errors += now.frame_errors - user_data->line_errors_opened.frame_errors;
+		r_errors->parity_errors += now.parity_errors - user_data->line_errors_opened.parity_errors;
+		r_errors->overruns += now.overruns - user_data->line_errors_opened.overruns;
+		r_errors->breaks += now.breaks - user_data->line_errors_opened.breaks;
+	}
+	return user_data->counts_line_errors;
+}
+
+// Whether snprintf wrote everything it was asked to into p_size bytes
+static inline bool _fits(int p_written, size_t p_size) {
+	return p_written >= 0 && (size_t) p_written < p_size;
+}
+
+// Where the latency timer of the USB adapter behind p_port_name is, following /dev/serial/by-id links
+static bool _find_latency_timer(const char *p_port_name, char *r_path, size_t p_size) {
+	char device[PATH_MAX];
+	r_path[0] = '\0';
+	if (realpath(p_port_name, device) == NULL)
+		return false;
+
+	const char *slash = strrchr(device, '/');
+	if (!_fits(snprintf(r_path, p_size, "%s/class/tty/%s/device/latency_timer", _sysfs_root(), slash != NULL ? slash + 1 : device), p_size)
+			|| access(r_path, F_OK) != 0) {
+		r_path[0] = '\0';
+		return false;
+	}
+	return true;
+}
+
+static int _read_latency_timer(const char *p_path) {
+	char value[16];
+	return p_path[0] != '\0' && _read_attribute(p_path, value, sizeof(value)) ? atoi(value) : -1;
+}
+
+static bool _write_latency_timer(const char *p_path, int p_ms) {
+	int fd = open(p_path, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	char value[16];
+	const int length = snprintf(value, sizeof(value), "%d\n", p_ms);
+	const bool written = write(fd, value, length) == length;
+	close(fd);
+	return written;
+}
+
+// Whether the driver is currently handing bytes over without batching them
+static bool _get_low_latency(int p_fd) {
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+	struct serial_struct serial;
+	return ioctl(p_fd, TIOCGSERIAL, &serial) == 0 && (serial.flags & ASYNC_LOW_LATENCY) != 0;
+#else
+	return false;
+#endif
+}
+
+static bool _set_low_latency(int p_fd, bool p_enabled) {
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+	struct serial_struct serial;
+	if (ioctl(p_fd, TIOCGSERIAL, &serial) != 0)
+		return false;
+	if (p_enabled)
+		serial.flags |= ASYNC_LOW_LATENCY;
+	else
+		serial.flags &= ~ASYNC_LOW_LATENCY;
+	return ioctl(p_fd, TIOCSSERIAL, &serial) == 0;
+#else
+	errno = ENOTSUP;
+	return false;
+#endif
+}
+
+// Applies "low_latency" and "latency_timer_ms" to the device just opened. Drivers that cannot
+// do it leave the port usable as it is; get_latency_settings() tells what was taken.
+static void _apply_latency_settings(data_struct * user_data, const char *p_port_name) {
+	user_data->low_latency_set = false;
+	user_data->latency_timer_restore = -1;
+	_find_latency_timer(p_port_name, user_data->latency_timer_path, sizeof(user_data->latency_timer_path));
+
+	if (user_data->low_latency && !_get_low_latency(user_data->fd)) {
+		if (_set_low_latency(user_data->fd, true))
+			user_data->low_latency_set = true;
+		else
+			fprintf(stderr, "Error enabling low latency mode of %s: %s\n", p_port_name, strerror(errno));
+	}
+
+	const int timer_ms = user_data->latency_timer_ms != 0 ? user_data->latency_timer_ms : user_data->low_latency ? 1 : 0;
+	if (timer_ms == 0)
+		return;
+	if (user_data->latency_timer_path[0] == '\0') {
+		// Only an explicit request is worth a complaint, most ports simply have no such timer
+		if (user_data->latency_timer_ms != 0)
+			fprintf(stderr, "Port has no latency timer: %s\n", p_port_name);
+		return;
+	}
+
+	const int previous_ms = _read_latency_timer(user_data->latency_timer_path);
+	if (previous_ms == timer_ms)
+		return;
+	if (_write_latency_timer(user_data->latency_timer_path, timer_ms))
+		user_data->latency_timer_restore = previous_ms;
+	else
+		fprintf(stderr, "Error setting latency timer %s: %s\n", user_data->latency_timer_path, strerror(errno));
+}
+
+// Puts back what _apply_latency_settings() changed, while the device is still open
+static void _restore_latency_settings(data_struct * user_data) {
+	if (user_data->low_latency_set) {
+		_set_low_latency(user_data->fd, false);
+		user_data->low_latency_set = false;
+	}
+	if (user_data->latency_timer_restore > 0)
+		_write_latency_timer(user_data->latency_timer_path, user_data->latency_timer_restore);
+	user_data->latency_timer_restore = -1;
+}
+
+// Lets go of the device, keeping everything needed to open it again
+static void _disconnect(data_struct * user_data) {
+	if (user_data->line_errors_opened_valid) {
+		_line_errors(user_data, &user_data->line_errors_before);
+		user_data->line_errors_opened_valid = false;
+	}
+	_stop_io_thread(user_data);
+	if (user_data->epoll_fd >= 0) {
+		close(user_data->epoll_fd);
+		user_data->epoll_fd = -1;
+	}
+	if (user_data->fd >= 0) {
+		_restore_latency_settings(user_data);
+		close(user_data->fd);
+		user_data->fd = -1;
+	}
+}
+
+static void _untrack_device(data_struct * user_data);
+
+static void _close(data_struct * user_data) {
+	_disconnect(user_data);
+	_untrack_device(user_data);
+	serial_hub_leave(&user_data->base);
+}
+
+static GDCALLINGCONV void destructor(godot_object *p_instance, void *p_method_data, void *p_user_data) {
+	data_struct *data = (data_struct *) p_user_data;
+	_close(data);
+	serial_port_destroy(&data->base);
+	api->godot_free(p_user_data);
+}
+
+static speed_t _baudrate_to_speed(int baudrate) {
+	switch (baudrate) {
+	case 1200: return B1200;
+	case 2400: return B2400;
+	case 4800: return B4800;
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 500000: return B500000;
+	case 576000: return B576000;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	case 1152000: return B1152000;
+	case 1500000: return B1500000;
+	case 2000000: return B2000000;
+	case 2500000: return B2500000;
+	case 3000000: return B3000000;
+	case 3500000: return B3500000;
+	case 4000000: return B4000000;
+	default: return B0;
+	}
+}
+
+// Waits up to timeout_ms for the port to become ready for the given epoll events.
+// A zero timeout only polls, so it never blocks the calling thread.
+static bool _wait_for(data_struct * user_data, uint32_t events, int timeout_ms) {
+	struct epoll_event ev;
+	ev.events = events;
+	ev.data.fd = user_data->fd;
+	if (epoll_ctl(user_data->epoll_fd, EPOLL_CTL_MOD, user_data->fd, &ev) != 0) {
+		fprintf(stderr, "Error watching port: %s\n", strerror(errno));
+		return false;
+	}
+
+	int n;
+	do {
+		n = epoll_wait(user_data->epoll_fd, &ev, 1, timeout_ms);
+	} while (n < 0 && errno == EINTR);
+
+	return n > 0 && (ev.events & events) != 0;
+}
+
+// Non-blocking read straight into the free space of rx, in at most two chunks
+// when that space wraps around. Returns the bytes buffered, or -1 on error.
+static int _drain(data_struct * user_data) {
+	ring_buffer *rx = &user_data->base.rx;
+	int total = 0;
+
+	for (int chunk = 0; chunk < 2; chunk++) {
+		uint8_t *dst;
+		uint32_t length = ring_buffer_write_region(rx, &dst);
+		if (length == 0)
+			return total > 0 ? total : -1; // buffer is full
+
+		ssize_t n;
+		do {
+			n = read(user_data->fd, dst, length);
+		} while (n < 0 && errno == EINTR);
+
+		if (n < 0) {
+			serial_stats_read(&user_data->base.stats, rx, 0);
+			return (errno == EAGAIN || errno == EWOULDBLOCK || total > 0) ? total : -1;
+		}
+		serial_port_log_traffic(&user_data->base, false, dst, n);
+		ring_buffer_commit(rx, n);
+		serial_stats_read(&user_data->base.stats, rx, n);
+		total += n;
+		if ((uint32_t) n < length)
+			break;
+	}
+	return total;
+}
+
+static int _read_and_buffer(serial_port *p_port) {
+	data_struct * user_data = (data_struct *) p_port;
+
+	// Only touch epoll when the script explicitly asked for a blocking timeout
+	if (p_port->timeout > 0 && !_wait_for(user_data, EPOLLIN, p_port->timeout))
+		return 0;
+
+	return _drain(user_data);
+}
+
+// Non-blocking write of the queued bytes, one syscall per contiguous region so
+// everything queued since the last wake-up goes out together. Returns 1 once tx
+// is empty, 0 if the port cannot take more right now, or -1 on error, in which
+// case whatever was queued is dropped.
+static int _flush_tx(data_struct * user_data, bool *r_sent) {
+	ring_buffer *tx = &user_data->base.tx;
+
+	for (;;) {
+		const uint8_t *src;
+		uint32_t length = ring_buffer_read_region(tx, &src);
+		if (length == 0)
+			return 1;
+
+		ssize_t n = write(user_data->fd, src, length);
+		serial_stats_write(&user_data->base.stats, n);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			fprintf(stderr, "Error writing to port: %s\n", strerror(errno));
+			ring_buffer_consume(tx, ring_buffer_available(tx));
+			return -1;
+		}
+		serial_port_log_traffic(&user_data->base, true, src, n);
+		ring_buffer_consume(tx, n);
+		*r_sent = true;
+	}
+}
+
+static void _watch_port(data_struct * user_data) {
+	struct epoll_event ev;
+	ev.events = (user_data->reading ? EPOLLIN : 0) | (user_data->watching_out ? EPOLLOUT : 0);
+	ev.data.ptr = &user_data->port_source;
+	epoll_ctl(user_data->loop->epoll_fd, EPOLL_CTL_MOD, user_data->fd, &ev);
+}
+
+static void _service_rx(data_struct * user_data, uint32_t events) {
+	if (events & EPOLLIN) {
+		const int drained = _drain(user_data);
+		if (drained > 0) {
+			serial_port_notify_received(&user_data->base);
+		} else if (drained < 0 && ring_buffer_free_space(&user_data->base.rx) == 0) {
+			// The consumer fell behind: leave the rest to the driver until it made room. With flow
+			// control that holds the device back; without it, whatever the driver cannot keep is its
+			// own overrun, counted once reading starts again.
+			user_data->overruns_paused_valid = _read_buf_overruns(user_data->fd, &user_data->overruns_paused);
+			serial_port_pause_rx(&user_data->base);
+			user_data->reading = false;
+			_watch_port(user_data);
+		}
+	}
+	if (events & (EPOLLERR | EPOLLHUP)) {
+		// Device went away; stop watching it until the port is closed
+		epoll_ctl(user_data->loop->epoll_fd, EPOLL_CTL_DEL, user_data->fd, NULL);
+		user_data->hung_up = true;
+	}
+}
+
+// Reading stopped while rx was full; it starts again once the consumer made room
+static void _service_paused_rx(data_struct * user_data) {
+	if (!user_data->reading && !user_data->hung_up && !serial_atomic_load_u32(&user_data->base.rx_paused)) {
+		uint64_t overruns;
+		if (user_data->overruns_paused_valid && _read_buf_overruns(user_data->fd, &overruns))
+			serial_port_count_overflow(&user_data->base, overruns - user_data->overruns_paused);
+		user_data->overruns_paused_valid = false;
+		user_data->reading = true;
+		_watch_port(user_data);
+	}
+}
+
+static void _service_tx(data_struct * user_data) {
+	// Anything queued after this point comes with a new wake-up
+	serial_port_clear_wake(&user_data->base);
+	if (user_data->hung_up) {
+		ring_buffer_consume(&user_data->base.tx, ring_buffer_available(&user_data->base.tx));
+		return;
+	}
+
+	const int flushed = _flush_tx(user_data, &user_data->sent);
+	if ((flushed == 0) != user_data->watching_out) {
+		user_data->watching_out = flushed == 0;
+		_watch_port(user_data);
+	}
+	if (flushed == 1 && user_data->sent) {
+		user_data->sent = false;
+		serial_port_emit_deferred(&user_data->base, "write_completed", 0, NULL);
+	}
+}
+
+// What the driver has yet to send, 0 if it cannot tell
+static uint32_t _driver_pending(data_struct * user_data) {
+	int pending = 0;
+	if (ioctl(user_data->fd, TIOCOUTQ, &pending) != 0 || pending < 0)
+		return 0;
+	return (uint32_t) pending;
+}
+
+// Reads the modem lines once they are due, after which they are due again MODEM_POLL_USEC later.
+// Stops for good once they can no longer be read, which is right away on a pty.
+static void _poll_modem_lines(data_struct * user_data, int64_t p_now) {
+	if (user_data->modem_poll_at < 0 || p_now < user_data->modem_poll_at)
+		return;
+
+	int bits;
+	if (ioctl(user_data->fd, TIOCMGET, &bits) != 0) {
+		user_data->modem_poll_at = -1;
+		return;
+	}
+	serial_port_report_modem_lines(&user_data->base, _modem_lines(bits));
+	user_data->modem_poll_at = p_now + MODEM_POLL_USEC;
+}
+
+// Starts the break send_break() asked for once the driver has sent everything queued before it,
+// and ends it once it has lasted long enough
+static void _service_break(data_struct * user_data, int64_t p_now) {
+	const uint32_t duration_ms = serial_atomic_load_u32(&user_data->base.break_ms);
+	if (duration_ms == 0)
+		return;
+
+	if (user_data->break_end == 0) {
+		if (ring_buffer_available(&user_data->base.tx) > 0 || _driver_pending(user_data) > 0)
+			return;
+		if (ioctl(user_data->fd, TIOCSBRK) != 0) {
+			fprintf(stderr, "Error sending break: %s\n", strerror(errno));
+			serial_port_complete_break(&user_data->base, false);
+			return;
+		}
+		user_data->break_end = p_now + (int64_t) duration_ms * 1000;
+	}
+	if (p_now < user_data->break_end)
+		return;
+
+	ioctl(user_data->fd, TIOCCBRK);
+	user_data->break_end = 0;
+	serial_port_complete_break(&user_data->base, true);
+}
+
+// Does whatever is due on line_timer_fd, then has it go off for what comes next: the next read of
+// the modem lines, the end of the break, or another look at whether the line is clear for it
+static void _service_line(data_struct * user_data) {
+	const int64_t now = serial_time_usec();
+	_poll_modem_lines(user_data, now);
+	_service_break(user_data, now);
+
+	int64_t next = user_data->modem_poll_at;
+	if (serial_atomic_load_u32(&user_data->base.break_ms) != 0) {
+		const int64_t step = user_data->break_end != 0 ? user_data->break_end : now + BREAK_POLL_USEC;
+		if (next < 0 || step < next)
+			next = step;
+	}
+
+	// An all-zero time disarms it
+	struct itimerspec timer = { { 0, 0 }, { 0, 0 } };
+	if (next >= 0) {
+		next = next > 0 ? next : 1;
+		timer.it_value.tv_sec = (time_t) (next / 1000000);
+		timer.it_value.tv_nsec = (long) (next % 1000000) * 1000;
+	}
+	if (timerfd_settime(user_data->line_timer_fd, TFD_TIMER_ABSTIME, &timer, NULL) != 0)
+		fprintf(stderr, "Error arming line timer: %s\n", strerror(errno));
+}
+
+// Has the timerfd go off at the deadline of the waiting transaction, if any. Called again by the
+// I/O thread every time it does, so one set for an earlier transaction cannot end a later one early.
+static void _arm_transaction_timer(data_struct * user_data) {
+	const int64_t deadline = serial_port_transaction_deadline(&user_data->base);
+	if (deadline < 0)
+		return;
+
+	struct itimerspec timer = { { 0, 0 }, { (time_t) (deadline / 1000000), (long) (deadline % 1000000) * 1000 } };
+	if (timerfd_settime(user_data->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL) != 0)
+		fprintf(stderr, "Error arming transaction timer: %s\n", strerror(errno));
+}
+
+// Each round handles every ready descriptor, then gives each port it involved one go at its transmit queue
+static void * _loop_main(void *p_data) {
+	io_loop *loop = (io_loop *) p_data;
+	struct epoll_event events[IO_LOOP_MAX_EVENTS];
+	data_struct *touched[IO_LOOP_MAX_EVENTS];
+
+	for (;;) {
+		// Ports removed before this point can no longer come up in an event
+		serial_atomic_store_u32(&loop->barrier_passed, serial_atomic_load_u32(&loop->barrier_requested));
+		if (serial_atomic_load_u32(&loop->stop_requested))
+			break;
+
+		int n = epoll_wait(loop->epoll_fd, events, IO_LOOP_MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Error waiting for port events: %s\n", strerror(errno));
+			break;
+		}
+
+		int num_touched = 0;
+		for (int i = 0; i < n; i++) {
+			io_source *source = (io_source *) events[i].data.ptr;
+			data_struct * user_data = source->port;
+			if (source->is_wake) {
+				// woken up to check stop_requested, a barrier, a transmit queue, a Modbus poll to time or a break
+				uint64_t count;
+				while (read(user_data != NULL ? user_data->wake_fd : loop->wake_fd, &count, sizeof(count)) < 0 && errno == EINTR);
+				if (user_data != NULL) {
+					_arm_transaction_timer(user_data);
+					_service_line(user_data);
+				}
+			} else if (source->is_line) {
+				uint64_t count;
+				while (read(user_data->line_timer_fd, &count, sizeof(count)) < 0 && errno == EINTR);
+				_service_line(user_data);
+			} else if (source->is_timer) {
+				uint64_t count;
+				while (read(user_data->timer_fd, &count, sizeof(count)) < 0 && errno == EINTR);
+				serial_port_expire_transaction(&user_data->base);
+				_arm_transaction_timer(user_data);
+			} else {
+				_service_rx(user_data, events[i].events);
+				// What came in may have moved the deadline of a Modbus poll
+				_arm_transaction_timer(user_data);
+			}
+
+			if (user_data != NULL && !user_data->touched) {
+				user_data->touched = true;
+				touched[num_touched++] = user_data;
+			}
+		}
+
+		for (int i = 0; i < num_touched; i++) {
+			touched[i]->touched = false;
+			_service_paused_rx(touched[i]);
+			_service_tx(touched[i]);
+		}
+	}
+	return NULL;
+}
+
+// Hands the port over to its hub's I/O loop, or to a loop of its own
+static bool _start_io_thread(data_struct * user_data) {
+	io_loop *loop = user_data->base.hub != NULL ? &((hub_struct *) user_data->base.hub)->loop : &user_data->own_loop;
+	if (!_loop_start(loop))
+		return false;
+
+	user_data->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	user_data->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	user_data->line_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (user_data->wake_fd < 0 || user_data->timer_fd < 0 || user_data->line_timer_fd < 0) {
+		fprintf(stderr, "Error creating I/O thread descriptors: %s\n", strerror(errno));
+		return false;
+	}
+	user_data->watching_out = false;
+	user_data->reading = true;
+	user_data->overruns_paused_valid = false;
+	user_data->sent = false;
+	user_data->hung_up = false;
+	user_data->touched = false;
+	user_data->loop = loop;
+	// The first look at the modem lines only sets what later ones compare with
+	user_data->modem_poll_at = user_data->base.options.modem_events ? 0 : -1;
+	user_data->break_end = 0;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = &user_data->wake_source;
+	if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, user_data->wake_fd, &ev) == 0) {
+		ev.data.ptr = &user_data->timer_source;
+		if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, user_data->timer_fd, &ev) == 0) {
+			ev.data.ptr = &user_data->line_source;
+			if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, user_data->line_timer_fd, &ev) == 0) {
+				ev.data.ptr = &user_data->port_source;
+				if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, user_data->fd, &ev) == 0) {
+					user_data->base.threaded = true;
+					// The loop reads the modem lines the first time it wakes up
+					_wake_io_thread(user_data);
+					return true;
+				}
+			}
+		}
+	}
+
+	// _close() takes it from here, as if the port had been attached
+	fprintf(stderr, "Error watching port: %s\n", strerror(errno));
+	return false;
+}
+
+// The part of the termios settings open() and reconfigure() both change
+static void _set_line(struct termios *tty, speed_t speed, godot_serial_config config) {
+	const int bitlength = (config & GODOT_SERIAL_BIT_LENGTH_MASK) >> 8;
+	const int parity = (config & GODOT_SERIAL_PARITY_MASK) >> 4;
+	const int stopbits = config & GODOT_SERIAL_STOP_BIT_MASK;
+
+	tty->c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB);
+	tty->c_cflag |= bitlength == 5 ? CS5 : bitlength == 6 ? CS6 : bitlength == 7 ? CS7 : CS8;
+	if (parity == 3)
+		tty->c_cflag |= PARENB | PARODD;
+	else if (parity == 2)
+		tty->c_cflag |= PARENB;
+	if (stopbits == 2)
+		tty->c_cflag |= CSTOPB;
+	cfsetispeed(tty, speed);
+	cfsetospeed(tty, speed);
+}
+
+// Flow control, which reconfigure() leaves as open() set it. Linux has no DTR/DSR handshake.
+static bool _set_flow_control(struct termios *tty, serial_flow_control flow_control) {
+	tty->c_cflag &= ~CRTSCTS;
+	tty->c_iflag &= ~(IXON | IXOFF | IXANY);
+
+	switch (flow_control) {
+	case SERIAL_FLOW_RTS_CTS:
+		tty->c_cflag |= CRTSCTS;
+		break;
+	case SERIAL_FLOW_DTR_DSR:
+		fprintf(stderr, "DTR/DSR flow control is not supported on this system\n");
+		return false;
+	case SERIAL_FLOW_XON_XOFF:
+		// The driver acts on them and keeps them out of what is read
+		tty->c_iflag |= IXON | IXOFF;
+		tty->c_cc[VSTART] = 0x11;
+		tty->c_cc[VSTOP] = 0x13;
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+static bool _open(data_struct * user_data, const char* port_name, int baudrate, godot_serial_config config, serial_flow_control flow_control) {
+	const speed_t speed = _baudrate_to_speed(baudrate);
+	if (speed == B0) {
+		fprintf(stderr, "Unsupported baud rate: %i\n", baudrate);
+		return false;
+	}
+
+	// Non-blocking from the start: neither open() nor any later read/write may stall the game thread
+	int fd = open(port_name, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "Error opening given communication port: %s : %s\n", port_name, strerror(errno));
+		return false;
+	}
+	user_data->fd = fd;
+	user_data->line_errors_opened_valid = _read_line_errors(fd, &user_data->line_errors_opened);
+	if (user_data->line_errors_opened_valid)
+		user_data->counts_line_errors = true;
+
+	// No sharing, just like on Windows
+	if (ioctl(fd, TIOCEXCL) != 0) {
+		fprintf(stderr, "Error getting exclusive access to port: %s\n", strerror(errno));
+		_disconnect(user_data);
+		return false;
+	}
+
+	struct termios tty;
+	if (tcgetattr(fd, &tty) != 0) {
+		fprintf(stderr, "Error getting current termios: %s\n", strerror(errno));
+		_disconnect(user_data);
+		return false;
+	}
+
+	cfmakeraw(&tty);
+	tty.c_cflag |= CLOCAL | CREAD;
+	// Reads return whatever is available right away, and a single byte is enough to wake epoll up.
+	// That is already the lowest latency the tty layer offers, so "low_latency" leaves these alone.
+	tty.c_cc[VMIN] = 0;
+	tty.c_cc[VTIME] = 0;
+	_set_line(&tty, speed, config);
+	if (!_set_flow_control(&tty, flow_control)) {
+		_disconnect(user_data);
+		return false;
+	}
+
+	if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+		fprintf(stderr, "Error setting termios (control bits): %03X: %s\n", config, strerror(errno));
+		_disconnect(user_data);
+		return false;
+	}
+	_apply_latency_settings(user_data, port_name);
+
+	user_data->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (user_data->epoll_fd < 0) {
+		fprintf(stderr, "Error creating epoll instance: %s\n", strerror(errno));
+		_disconnect(user_data);
+		return false;
+	}
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(user_data->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		fprintf(stderr, "Error watching port: %s\n", strerror(errno));
+		_disconnect(user_data);
+		return false;
+	}
+
+	return true;
+}
+
+// Port enumeration: a cache of /sys/class/tty built on first use and kept current by a
+// thread watching /dev through inotify, so neither list_ports() nor reconnecting ports
+// touch the system between hotplug events. GODOT_SERIAL_SYSFS_ROOT and GODOT_SERIAL_DEV_ROOT
+// move both trees elsewhere, which is how tests feed it devices.
+static pthread_mutex_t _enum_lock = PTHREAD_MUTEX_INITIALIZER;
+static serial_port_list _enum_ports;
+static bool _enum_started = false;
+static pthread_t _hotplug_thread;
+static int _hotplug_fd = -1;
+static int _hotplug_stop_fd = -1;
+static data_struct *_reconnecting = NULL;
+
+static const char * _sysfs_root(void) {
+	const char *root = getenv("GODOT_SERIAL_SYSFS_ROOT");
+	return root != NULL ? root : "/sys";
+}
+
+static const char * _dev_root(void) {
+	const char *root = getenv("GODOT_SERIAL_DEV_ROOT");
+	return root != NULL ? root : "/dev";
+}
+
+// First line of a sysfs attribute
+static bool _read_attribute(const char *p_path, char *r_value, size_t p_size) {
+	int fd = open(p_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	ssize_t n = read(fd, r_value, p_size - 1);
+	close(fd);
+	if (n < 0)
+		return false;
+	r_value[n] = '\0';
+	r_value[strcspn(r_value, "\n")] = '\0';
+	return true;
+}
+
+// Last component of where a sysfs link points
+static bool _read_link_name(const char *p_path, char *r_name, size_t p_size) {
+	char target[PATH_MAX];
+	ssize_t n = readlink(p_path, target, sizeof(target) - 1);
+	if (n < 0)
+		return false;
+	target[n] = '\0';
+
+	const char *slash = strrchr(target, '/');
+	return _fits(snprintf(r_name, p_size, "%s", slash != NULL ? slash + 1 : target), p_size);
+}
+
+static bool _describe_port(const char *p_name, serial_port_info *r_info) {
+	char path[PATH_MAX], device[PATH_MAX];
+
+	// Virtual consoles and ptys have no device behind them
+	if (!_fits(snprintf(path, sizeof(path), "%s/class/tty/%s/device", _sysfs_root(), p_name), sizeof(path)) || realpath(path, device) == NULL)
+		return false;
+
+	// Legacy 8250 ports are registered on the platform bus whether or not the hardware exists
+	char name[64];
+	if (_fits(snprintf(path, sizeof(path), "%s/subsystem", device), sizeof(path)) && _read_link_name(path, name, sizeof(name)) && strcmp(name, "platform") == 0)
+		return false;
+
+	// A port whose path does not fit could never be opened from the list
+	memset(r_info, 0, sizeof(*r_info));
+	if (!_fits(snprintf(r_info->path, sizeof(r_info->path), "%s/%s", _dev_root(), p_name), sizeof(r_info->path)))
+		return false;
+	if (_fits(snprintf(path, sizeof(path), "%s/driver", device), sizeof(path)))
+		_read_link_name(path, r_info->driver, sizeof(r_info->driver));
+	r_info->vid = -1;
+	r_info->pid = -1;
+
+	// The USB device an interface belongs to is its closest ancestor with an idVendor
+	for (char *slash = strrchr(device, '/'); slash != NULL && slash != device; slash = strrchr(device, '/')) {
+		char value[16];
+		if (_fits(snprintf(path, sizeof(path), "%s/idVendor", device), sizeof(path)) && _read_attribute(path, value, sizeof(value))) {
+			r_info->vid = strtol(value, NULL, 16);
+			if (_fits(snprintf(path, sizeof(path), "%s/idProduct", device), sizeof(path)) && _read_attribute(path, value, sizeof(value)))
+				r_info->pid = strtol(value, NULL, 16);
+			if (_fits(snprintf(path, sizeof(path), "%s/serial", device), sizeof(path)))
+				_read_attribute(path, r_info->serial_number, sizeof(r_info->serial_number));
+			break;
+		}
+		*slash = '\0';
+	}
+	return true;
+}
+
+// Applies a batch of /dev events to the cache, one port at a time
+static bool _apply_hotplug_events(const char *p_events, ssize_t p_length) {
+	bool changed = false;
+	const char *end = p_events + p_length;
+	while (p_events < end) {
+		const struct inotify_event *event = (const struct inotify_event *) p_events;
+		p_events += sizeof(struct inotify_event) + event->len;
+		if (event->len == 0)
+			continue;
+
+		if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+			// Names too long to list were never added
+			char path[sizeof(((serial_port_info *) NULL)->path)];
+			if (_fits(snprintf(path, sizeof(path), "%s/%s", _dev_root(), event->name), sizeof(path)))
+				changed = serial_enum_remove(&_enum_ports, path) || changed;
+		} else {
+			serial_port_info info;
+			if (_describe_port(event->name, &info))
+				changed = serial_enum_add(&_enum_ports, &info) || changed;
+		}
+	}
+	return changed;
+}
+
+static void * _hotplug_main(void *p_data) {
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd fds[2] = { { _hotplug_fd, POLLIN, 0 }, { _hotplug_stop_fd, POLLIN, 0 } };
+
+	for (;;) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Error waiting for hotplug events: %s\n", strerror(errno));
+			break;
+		}
+		if (fds[1].revents != 0)
+			break;
+
+		ssize_t length = read(_hotplug_fd, events, sizeof(events));
+		if (length <= 0)
+			continue;
+
+		pthread_mutex_lock(&_enum_lock);
+		if (_apply_hotplug_events(events, length)) {
+			// Each reconnecting port sorts itself out on the main thread
+			for (data_struct *port = _reconnecting; port != NULL; port = port->next_reconnecting)
+				serial_port_call_deferred(&port->base, "_check_connection");
+		}
+		pthread_mutex_unlock(&_enum_lock);
+	}
+	return NULL;
+}
+
+// Builds the cache and starts tracking hotplug events; called with _enum_lock held
+static void _enum_start(void) {
+	if (_enum_started)
+		return;
+	_enum_started = true;
+
+	// Watch first, so no device slips in between the scan and the first event
+	_hotplug_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	_hotplug_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_hotplug_fd < 0 || _hotplug_stop_fd < 0 || inotify_add_watch(_hotplug_fd, _dev_root(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) < 0
+			|| pthread_create(&_hotplug_thread, NULL, _hotplug_main, NULL) != 0) {
+		fprintf(stderr, "Error tracking hotplug events, the port list will not change: %s\n", strerror(errno));
+		if (_hotplug_fd >= 0)
+			close(_hotplug_fd);
+		if (_hotplug_stop_fd >= 0)
+			close(_hotplug_stop_fd);
+		_hotplug_fd = -1;
+		_hotplug_stop_fd = -1;
+	}
+
+	serial_enum_clear(&_enum_ports);
+	char path[PATH_MAX];
+	DIR *dir = _fits(snprintf(path, sizeof(path), "%s/class/tty", _sysfs_root()), sizeof(path)) ? opendir(path) : NULL;
+	if (dir == NULL)
+		return;
+	for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+		serial_port_info info;
+		if (entry->d_name[0] != '.' && _describe_port(entry->d_name, &info))
+			serial_enum_add(&_enum_ports, &info);
+	}
+	closedir(dir);
+}
+
+void godot_serial_terminate(void) {
+	pthread_mutex_lock(&_enum_lock);
+	const bool tracking = _hotplug_fd >= 0;
+	pthread_mutex_unlock(&_enum_lock);
+
+	if (tracking) {
+		uint64_t one = 1;
+		while (write(_hotplug_stop_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+		pthread_join(_hotplug_thread, NULL);
+		close(_hotplug_fd);
+		close(_hotplug_stop_fd);
+		_hotplug_fd = -1;
+		_hotplug_stop_fd = -1;
+	}
+	_enum_started = false;
+}
+
+// Remembers which device the port was opened on, so it can be found again after being unplugged
+static void _track_device(data_struct * user_data, const char *p_path) {
+	pthread_mutex_lock(&_enum_lock);
+	_enum_start();
+
+	// Symlinks such as /dev/serial/by-id/... name the same device as the node they point to
+	char resolved[PATH_MAX];
+	const serial_port_info *info = serial_enum_find(&_enum_ports, p_path);
+	if (info == NULL && realpath(p_path, resolved) != NULL)
+		info = serial_enum_find(&_enum_ports, resolved);
+
+	if (info != NULL) {
+		user_data->base.device = *info;
+	} else {
+		memset(&user_data->base.device, 0, sizeof(user_data->base.device));
+		snprintf(user_data->base.device.path, sizeof(user_data->base.device.path), "%s", p_path);
+		user_data->base.device.vid = -1;
+		user_data->base.device.pid = -1;
+	}
+
+	user_data->next_reconnecting = _reconnecting;
+	_reconnecting = user_data;
+	pthread_mutex_unlock(&_enum_lock);
+}
+
+static void _untrack_device(data_struct * user_data) {
+	pthread_mutex_lock(&_enum_lock);
+	for (data_struct **port = &_reconnecting; *port != NULL; port = &(*port)->next_reconnecting) {
+		if (*port == user_data) {
+			*port = user_data->next_reconnecting;
+			break;
+		}
+	}
+	user_data->next_reconnecting = NULL;
+	pthread_mutex_unlock(&_enum_lock);
+}
+
+// Raises or lowers RTS or DTR
+static bool _set_modem_output(data_struct * user_data, serial_modem_line p_line, bool p_level) {
+	int bits = p_line == SERIAL_MODEM_RTS ? TIOCM_RTS : TIOCM_DTR;
+	if (ioctl(user_data->fd, p_level ? TIOCMBIS : TIOCMBIC, &bits) != 0) {
+		fprintf(stderr, "Error setting %s: %s\n", p_line == SERIAL_MODEM_RTS ? "RTS" : "DTR", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+static bool _reconnect(data_struct * user_data) {
+	if (!_open(user_data, user_data->base.device.path, user_data->base.baudrate, user_data->base.config, user_data->base.options.flow_control))
+		return false;
+
+	// Opening raised both again
+	if (!(user_data->base.modem_outputs & SERIAL_MODEM_RTS))
+		_set_modem_output(user_data, SERIAL_MODEM_RTS, false);
+	if (!(user_data->base.modem_outputs & SERIAL_MODEM_DTR))
+		_set_modem_output(user_data, SERIAL_MODEM_DTR, false);
+
+	// Whatever was queued for the old connection went nowhere
+	ring_buffer_clear(&user_data->base.tx);
+	user_data->base.tx_wake_pending = 0;
+	if (user_data->base.options.threaded && !_start_io_thread(user_data)) {
+		_disconnect(user_data);
+		return false;
+	}
+	return true;
+}
+
+static GDCALLINGCONV godot_variant list_ports(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	godot_array ports;
+
+	pthread_mutex_lock(&_enum_lock);
+	_enum_start();
+	serial_enum_to_array(&_enum_ports, &ports);
+	pthread_mutex_unlock(&_enum_lock);
+
+	api->godot_variant_new_array(&ret, &ports);
+	api->godot_array_destroy(&ports);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant check_connection(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	if (user_data->base.is_open && user_data->base.options.reconnect) {
+		pthread_mutex_lock(&_enum_lock);
+		const serial_port_info *info = serial_enum_find_device(&_enum_ports, &user_data->base.device);
+		serial_port_info found;
+		if (info != NULL)
+			found = *info;
+		pthread_mutex_unlock(&_enum_lock);
+
+		// Gone, or already back under another name after a quick replug
+		if (!user_data->base.lost && (info == NULL || strcmp(found.path, user_data->base.device.path) != 0)) {
+			_disconnect(user_data);
+			user_data->base.lost = true;
+		}
+		if (user_data->base.lost && info != NULL) {
+			user_data->base.device = found;
+			user_data->base.lost = !_reconnect(user_data);
+		}
+	}
+
+	api->godot_variant_new_nil(&ret);
+	return ret;
+}
+
+// Reads "low_latency" and "latency_timer_ms", which every later connection of the port applies
+static bool _parse_latency_options(data_struct * user_data, const godot_variant *p_options) {
+	godot_variant value;
+	bool valid = true;
+
+	user_data->low_latency = false;
+	if (serial_port_get_option(p_options, "low_latency", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_BOOL)
+			user_data->low_latency = api->godot_variant_as_bool(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	user_data->latency_timer_ms = 0;
+	if (serial_port_get_option(p_options, "latency_timer_ms", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_INT && api->godot_variant_as_int(&value) >= 1 && api->godot_variant_as_int(&value) <= 255)
+			user_data->latency_timer_ms = api->godot_variant_as_int(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	return valid;
+}
+
+static GDCALLINGCONV godot_variant open_port(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	bool success = false;
+	if (p_num_args >= 1) {
+		godot_string port_name_str = api->godot_variant_as_string(p_args[0]);
+		godot_char_string port_name_ascii_str = api->godot_string_ascii(&port_name_str);
+
+		serial_port_settings settings;
+		bool valid = serial_port_parse_settings(p_num_args - 1, p_args + 1, &settings);
+		if (!user_data->base.is_open)
+			valid = _parse_latency_options(user_data, settings.options_arg) && valid;
+
+		if (valid && api->godot_char_string_length(&port_name_ascii_str) > 0 && !user_data->base.is_open) {
+			const char *port_name_ascii_str_buffer = api->godot_char_string_get_data(&port_name_ascii_str);
+			user_data->counts_line_errors = false;
+			memset(&user_data->line_errors_before, 0, sizeof(user_data->line_errors_before));
+			if (_open(user_data, port_name_ascii_str_buffer, settings.baudrate, settings.config, settings.options.flow_control)) {
+				if (serial_port_prepare(&user_data->base, &settings.options) && (!settings.options.threaded || _start_io_thread(user_data))) {
+					user_data->base.is_open = true;
+					user_data->base.config = settings.config;
+					user_data->base.baudrate = settings.baudrate;
+					if (settings.options.reconnect)
+						_track_device(user_data, port_name_ascii_str_buffer);
+					api->godot_string_destroy(&user_data->base.port);
+					api->godot_string_new_copy(&user_data->base.port, &port_name_str);
+
+					success = true;
+				} else {
+					_close(user_data);
+				}
+			}
+		}
+		api->godot_char_string_destroy(&port_name_ascii_str);
+		api->godot_string_destroy(&port_name_str);
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant close_port(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	if (user_data->base.is_open) {
+		// do close
+		_close(user_data);
+		user_data->base.is_open = false;
+	}
+
+	api->godot_variant_new_bool(&ret, true);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant is_connected(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	api->godot_variant_new_bool(&ret, user_data->base.is_open && !user_data->base.lost);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant available_for_write(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	// Without the I/O thread writes go straight to the port, limited only by the timeout
+	if (user_data->base.threaded)
+		api->godot_variant_new_int(&ret, serial_port_tx_free_space(&user_data->base));
+	else
+		api->godot_variant_new_int(&ret, ring_buffer_capacity(&user_data->base.tx));
+	return ret;
+}
+
+
+// flush(timeout_ms): waits for everything written to go out, but no longer than timeout_ms since
+// flow control can hold it back for good. Returns whether it did.
+static GDCALLINGCONV godot_variant flush(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	bool drained = false;
+
+	if (user_data->base.is_open) {
+		const int timeout_ms = serial_port_parse_flush(&user_data->base, p_num_args, p_args, serial_port_tx_pending(&user_data->base) + _driver_pending(user_data));
+		// tcdrain() alone would wait for as long as the other end keeps CTS down
+		drained = true;
+		for (int waited = 0; serial_port_tx_pending(&user_data->base) > 0 || _driver_pending(user_data) > 0; waited++) {
+			if (waited >= timeout_ms) {
+				drained = false;
+				break;
+			}
+			usleep(1000);
+		}
+		if (drained)
+			tcdrain(user_data->fd);
+	}
+
+	api->godot_variant_new_bool(&ret, drained);
+	return ret;
+}
+
+// Writes everything or gives up once the timeout expires; the port is non-blocking,
+// so with the default timeout of 0 a congested port never stalls the caller.
+static bool _write_all(serial_port *p_port, const uint8_t *data, uint32_t length) {
+	data_struct * user_data = (data_struct *) p_port;
+
+	while (length > 0) {
+		ssize_t n = write(user_data->fd, data, length);
+		serial_stats_write(&user_data->base.stats, n);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return false;
+			if (user_data->base.timeout <= 0 || !_wait_for(user_data, EPOLLOUT, user_data->base.timeout))
+				return false;
+			continue;
+		}
+		serial_port_log_traffic(&user_data->base, true, data, n);
+		data += n;
+		length -= n;
+	}
+	return true;
+}
+
+// Queues for the I/O thread when there is one, writes straight to the port otherwise
+static bool _send(serial_port *p_port, const uint8_t *data, uint32_t length) {
+	if (p_port->threaded)
+		return serial_port_enqueue(p_port, data, length);
+	return _write_all(p_port, data, length);
+}
+
+// Wakes the I/O thread once for everything a call queued
+static void _flush_queued(data_struct * user_data) {
+	if (user_data->base.threaded && serial_port_tx_pending(&user_data->base) > 0 && serial_port_needs_wake(&user_data->base))
+		_wake_io_thread(user_data);
+}
+
+static GDCALLINGCONV godot_variant write_data(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	int num_errors = serial_port_write_args(&user_data->base, p_num_args, p_args, _send);
+	_flush_queued(user_data);
+
+	api->godot_variant_new_int(&ret, num_errors);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant write_packet(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	bool success = serial_port_write_packet(&user_data->base, p_num_args, p_args, _send);
+	_flush_queued(user_data);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// The I/O thread sees the response arrive, and the timerfd wakes it up at the deadline
+static GDCALLINGCONV godot_variant transact(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	bool success = serial_port_transact(&user_data->base, p_num_args, p_args, _send);
+	if (success)
+		_arm_transaction_timer(user_data);
+	_flush_queued(user_data);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant modbus_poll(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	// The I/O thread sends even the first request, once the line has been silent long enough. It
+	// changes the poll's state from the start, so it arms the timerfd for it itself.
+	bool success = serial_port_modbus_poll(&user_data->base, p_num_args, p_args);
+	if (success)
+		_wake_io_thread(user_data);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// reconfigure(baudrate, config) or reconfigure(config: SerialConfig): changes the line of an open
+// port in place, keeping its handle, buffers and I/O thread. Only the baud rate and config apply,
+// the options stay as open() set them. Bytes still queued go out with the new settings.
+static GDCALLINGCONV godot_variant reconfigure(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	bool success = false;
+
+	serial_port_settings settings;
+	if (user_data->base.is_open && serial_port_parse_settings(p_num_args, p_args, &settings)) {
+		const speed_t speed = _baudrate_to_speed(settings.baudrate);
+		struct termios tty;
+		if (speed == B0) {
+			fprintf(stderr, "Unsupported baud rate: %i\n", settings.baudrate);
+		} else if (user_data->base.lost) {
+			// Applied once the device is back
+			success = true;
+		} else if (tcgetattr(user_data->fd, &tty) != 0) {
+			fprintf(stderr, "Error getting current termios: %s\n", strerror(errno));
+		} else {
+			_set_line(&tty, speed, settings.config);
+			success = tcsetattr(user_data->fd, TCSANOW, &tty) == 0;
+			if (!success)
+				fprintf(stderr, "Error setting termios (control bits): %03X: %s\n", settings.config, strerror(errno));
+		}
+
+		if (success) {
+			user_data->base.baudrate = settings.baudrate;
+			user_data->base.config = settings.config;
+		}
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static godot_variant _set_output(data_struct * user_data, serial_modem_line p_line, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	uint32_t outputs;
+
+	bool success = serial_port_parse_modem_output(&user_data->base, p_line, p_num_args, p_args, &outputs);
+	// Applied once the device is back
+	if (success && !user_data->base.lost)
+		success = _set_modem_output(user_data, p_line, outputs & p_line);
+	if (success)
+		serial_atomic_store_u32(&user_data->base.modem_outputs, outputs);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// set_rts(level) and set_dtr(level): refused for the line the flow control of the port drives
+static GDCALLINGCONV godot_variant set_rts(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	return _set_output((data_struct *) p_user_data, SERIAL_MODEM_RTS, p_num_args, p_args);
+}
+
+static GDCALLINGCONV godot_variant set_dtr(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	return _set_output((data_struct *) p_user_data, SERIAL_MODEM_DTR, p_num_args, p_args);
+}
+
+// send_break(duration_ms = 250): holds the line in the break state that long. A threaded port
+// returns at once: its I/O thread starts the break once everything written before is out, and
+// emits break_completed(success) when it is over; writes are refused until then. A polled port
+// has no thread to hand it to, so it returns once the break is over, blocking for duration_ms,
+// and bytes the driver still holds may be cut by it: flush() first if that matters.
+static GDCALLINGCONV godot_variant send_break(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	int duration_ms;
+
+	bool success = serial_port_parse_break(&user_data->base, p_num_args, p_args, &duration_ms) && !user_data->base.lost;
+	if (success && user_data->base.threaded) {
+		success = serial_port_request_break(&user_data->base, duration_ms);
+		if (success)
+			_wake_io_thread(user_data);
+	} else if (success) {
+		success = ioctl(user_data->fd, TIOCSBRK) == 0;
+		if (success) {
+			usleep(duration_ms * 1000);
+			ioctl(user_data->fd, TIOCCBRK);
+		} else {
+			fprintf(stderr, "Error sending break: %s\n", strerror(errno));
+		}
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// The lines as the driver sees them right now, empty while the port is not connected or when the driver cannot tell
+static GDCALLINGCONV godot_variant get_modem_lines(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	int bits;
+	if (user_data->fd >= 0 && ioctl(user_data->fd, TIOCMGET, &bits) == 0)
+		serial_port_modem_lines_to_variant(_modem_lines(bits), &ret);
+	else
+		serial_port_modem_lines_to_variant(SERIAL_MODEM_UNKNOWN, &ret);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant set_timeout(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	bool success = false;
+
+	if (p_num_args > 0 && api->godot_variant_get_type(p_args[0]) == GODOT_VARIANT_TYPE_INT) {
+		user_data->base.timeout = api->godot_variant_as_int(p_args[0]);
+		success = true;
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant get_stats(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	serial_line_errors line_errors;
+	serial_port_get_stats(&user_data->base, _line_errors(user_data, &line_errors) ? &line_errors : NULL, &ret);
+	return ret;
+}
+
+static void _set_setting(godot_dictionary *p_settings, const char *p_key, const godot_variant *p_value) {
+	godot_string key;
+	godot_variant key_variant;
+	api->godot_string_new(&key);
+	api->godot_string_parse_utf8(&key, p_key);
+	api->godot_variant_new_string(&key_variant, &key);
+	api->godot_dictionary_set(p_settings, &key_variant, p_value);
+	api->godot_variant_destroy(&key_variant);
+	api->godot_string_destroy(&key);
+}
+
+static void _set_int_setting(godot_dictionary *p_settings, const char *p_key, int64_t p_value) {
+	godot_variant value;
+	api->godot_variant_new_int(&value, p_value);
+	_set_setting(p_settings, p_key, &value);
+	api->godot_variant_destroy(&value);
+}
+
+// What the driver currently does, read back from it rather than from what open() was given:
+// "low_latency", "latency_timer_ms" for adapters that have one, and the termios "vmin" and "vtime".
+// Empty while the port is not connected.
+static GDCALLINGCONV godot_variant get_latency_settings(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	godot_dictionary settings;
+	api->godot_dictionary_new(&settings);
+	if (user_data->fd >= 0) {
+		godot_variant value;
+		api->godot_variant_new_bool(&value, _get_low_latency(user_data->fd));
+		_set_setting(&settings, "low_latency", &value);
+		api->godot_variant_destroy(&value);
+
+		const int timer_ms = _read_latency_timer(user_data->latency_timer_path);
+		if (timer_ms > 0)
+			_set_int_setting(&settings, "latency_timer_ms", timer_ms);
+
+		struct termios tty;
+		if (tcgetattr(user_data->fd, &tty) == 0) {
+			_set_int_setting(&settings, "vmin", tty.c_cc[VMIN]);
+			_set_int_setting(&settings, "vtime", tty.c_cc[VTIME]);
+		}
+	}
+
+	api->godot_variant_new_dictionary(&ret, &settings);
+	api->godot_dictionary_destroy(&settings);
+	return ret;
+}
+
+godot_serial_interface godot_serial_implementation = {0x13,
+                                                      constructor, destructor,
+                                                      open_port, close_port, is_connected,
+                                                      serial_port_available_for_read, available_for_write,
+                                                      flush, serial_port_peek, serial_port_read, serial_port_read_string, write_data,
+                                                      set_timeout, serial_port_get_overflow_count,
+                                                      serial_port_read_bytes, serial_port_read_all,
+                                                      serial_port_read_line, serial_port_read_until,
+                                                      serial_port_read_packet, write_packet,
+                                                      serial_port_get_rejected_frames,
+                                                      serial_port_unpack, list_ports, get_stats,
+                                                      serial_port_read_with_timestamps, get_latency_settings, transact, serial_port_record, modbus_poll,
+                                                      reconfigure, set_rts, set_dtr, send_break, get_modem_lines,
+                                                      serial_port_dispatch_notifications, check_connection};
+
+static GDCALLINGCONV void * hub_constructor(godot_object *p_instance, void *p_method_data) {
+	hub_struct *hub = api->godot_alloc(sizeof(hub_struct));
+	serial_hub_init(&hub->base, p_instance);
+	_loop_init(&hub->loop);
+	return hub;
+}
+
+static GDCALLINGCONV void hub_destructor(godot_object *p_instance, void *p_method_data, void *p_user_data) {
+	hub_struct *hub = (hub_struct *) p_user_data;
+	// Open ports keep their hub alive, so the loop has none left to service
+	_loop_stop(&hub->loop);
+	serial_hub_destroy(&hub->base);
+	api->godot_free(p_user_data);
+}
+
+godot_serial_hub_interface godot_serial_hub_implementation = {hub_constructor, hub_destructor,
+                                                              serial_hub_poll};
@@ -0,0 +1,399 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "godot_serial.h"
+#include "serial_interface.h"
+#include "serial_port.h"
+#include "serial_hub.h"
+#include "serial_sim.h"
+#include "serial_log.h"
+#include "serial_atomic.h"
+#include "serial_thread.h"
+#include <string.h>
+#include <stdio.h>
+
+// SerialReplay: plays back a capture file written by record() behind the same methods as
+// Serial, so a session recorded in the field can be reproduced and benchmarked offline.
+// open() takes the path of the capture file in place of the port name; the baud rate and
+// config are accepted for the sake of scripts written for Serial, but the capture sets the
+// pace. Received bytes arrive when they did in the capture, relative to open(); what was sent
+// is skipped, and so is everything written, which only counts in get_stats(). On top of the
+// options of Serial:
+//   "speed": float - how many times faster than recorded to play, or 0 for as fast as the
+//                    script reads (default 1)
+// Once everything has been played and read, is_connected() is false. Without an I/O thread,
+// the capture moves along whenever the port is read from.
+
+typedef struct {
+	serial_sim sim;
+
+	double speed;
+	int64_t start_usec;
+
+	// The capture. Only touched by the player thread when threaded, by the caller otherwise.
+	serial_log_reader log;
+	serial_log_record record; // received bytes not all in rx yet
+	uint32_t record_delivered;
+	bool has_record;
+	volatile uint32_t finished; // every received byte is in rx
+	bool sent;                  // bytes went out since the queue was last empty
+} data_struct;
+
+// When the record is due, in serial_time_usec()
+static int64_t _due_usec(data_struct * user_data, const serial_log_record *p_record) {
+	if (user_data->speed <= 0)
+		return user_data->start_usec;
+	return user_data->start_usec + (int64_t) (p_record->usec / user_data->speed);
+}
+
+// Finds the next record of received bytes, skipping those that were sent
+static bool _next_record(data_struct * user_data) {
+	if (user_data->has_record)
+		return true;
+
+	while (serial_log_next(&user_data->log, &user_data->record)) {
+		if (!user_data->record.sent) {
+			user_data->record_delivered = 0;
+			user_data->has_record = true;
+			return true;
+		}
+	}
+	serial_atomic_store_u32(&user_data->finished, 1);
+	return false;
+}
+
+// Moves everything due by p_now_usec into rx, as far as it fits, returning how many bytes made it.
+// A full rx holds the capture back rather than losing part of it.
+static uint32_t _play(data_struct * user_data, int64_t p_now_usec) {
+	uint32_t buffered = 0;
+
+	while (_next_record(user_data) && _due_usec(user_data, &user_data->record) <= p_now_usec) {
+		const uint8_t *src = user_data->record.data + user_data->record_delivered;
+		const uint32_t length = user_data->record.length - user_data->record_delivered;
+		const uint32_t written = ring_buffer_write(&user_data->sim.base.rx, src, length);
+		if (written == 0)
+			break;
+
+		serial_port_log_traffic(&user_data->sim.base, false, src, written);
+		serial_stats_read(&user_data->sim.base.stats, &user_data->sim.base.rx, written);
+		buffered += written;
+		user_data->record_delivered += written;
+		if (written < length)
+			break;
+		user_data->has_record = false;
+	}
+	return buffered;
+}
+
+// When the next received bytes are due, or -1 if there are none left
+static int64_t _next_due(data_struct * user_data) {
+	if (!_next_record(user_data))
+		return -1;
+	return _due_usec(user_data, &user_data->record);
+}
+
+static int _read_and_buffer(serial_port *p_port) {
+	data_struct * user_data = (data_struct *) p_port;
+
+	int64_t now = serial_time_usec();
+	uint32_t buffered = _play(user_data, now);
+
+	// Blocking reads wait for the capture just like they would for a real device
+	if (buffered == 0 && p_port->timeout > 0 && ring_buffer_free_space(&p_port->rx) > 0) {
+		const int64_t next = _next_due(user_data);
+		if (next >= 0 && next - now <= (int64_t) p_port->timeout * 1000) {
+			serial_sleep_usec(next - now);
+			buffered = _play(user_data, serial_time_usec());
+		}
+	}
+
+	if (buffered == 0 && ring_buffer_free_space(&p_port->rx) == 0)
+		return -1;
+	return buffered;
+}
+
+// Nobody is on the other end of a capture: what the script writes only counts in the stats
+static void _skip_written(serial_sim *p_sim, const uint8_t *p_data, uint32_t p_length) {
+}
+
+static void _player_main(void *p_data) {
+	data_struct * user_data = (data_struct *) p_data;
+	ring_buffer *tx = &user_data->sim.base.tx;
+
+	while (!serial_sim_stopping(&user_data->sim)) {
+		// Anything queued after this point comes with a new wake-up
+		serial_port_clear_wake(&user_data->sim.base);
+
+		// Nobody is on the other end: what the script writes goes out at once
+		for (;;) {
+			const uint8_t *src;
+			const uint32_t length = ring_buffer_read_region(tx, &src);
+			if (length == 0)
+				break;
+			serial_port_log_traffic(&user_data->sim.base, true, src, length);
+			ring_buffer_consume(tx, length);
+			serial_stats_write(&user_data->sim.base.stats, length);
+			user_data->sent = true;
+		}
+		if (user_data->sent) {
+			user_data->sent = false;
+			serial_port_emit_deferred(&user_data->sim.base, "write_completed", 0, NULL);
+		}
+
+		const int64_t now = serial_time_usec();
+		if (_play(user_data, now) > 0)
+			serial_port_notify_received(&user_data->sim.base);
+		serial_port_expire_transaction(&user_data->sim.base);
+
+		// Sleep until the next bytes are due, the script made room for them or a transaction
+		// times out, unless a write comes first. Bytes already due only wait because rx is full.
+		int64_t wake_at = _next_due(user_data);
+		if (wake_at >= 0 && wake_at <= now) {
+			serial_port_pause_rx(&user_data->sim.base);
+			wake_at = serial_atomic_load_u32(&user_data->sim.base.rx_paused) ? -1 : now;
+		}
+		const int64_t deadline = serial_port_transaction_deadline(&user_data->sim.base);
+		if (deadline >= 0 && (wake_at < 0 || deadline < wake_at))
+			wake_at = deadline;
+		// A Modbus poll may just have queued its next request from this thread
+		if (ring_buffer_available(tx) > 0)
+			continue;
+		if (wake_at < 0) {
+			serial_event_wait(&user_data->sim.wake, -1);
+		} else {
+			const int64_t wait_usec = wake_at - serial_time_usec();
+			if (wait_usec > 0)
+				serial_event_wait(&user_data->sim.wake, wait_usec);
+		}
+	}
+}
+
+static void _close(data_struct * user_data) {
+	serial_sim_stop_thread(&user_data->sim);
+	serial_log_reader_close(&user_data->log);
+	user_data->has_record = false;
+	serial_hub_leave(&user_data->sim.base);
+}
+
+static GDCALLINGCONV void * constructor(godot_object *p_instance, void *p_method_data) {
+	data_struct *data = api->godot_alloc(sizeof(data_struct));
+	serial_sim_init(&data->sim, p_instance, "replay", _read_and_buffer, _player_main, _skip_written);
+
+	serial_log_reader_init(&data->log);
+	data->has_record = false;
+	data->finished = 0;
+
+	return data;
+}
+
+static GDCALLINGCONV void destructor(godot_object *p_instance, void *p_method_data, void *p_user_data) {
+	data_struct *data = (data_struct *) p_user_data;
+	_close(data);
+	serial_port_destroy(&data->sim.base);
+	api->godot_free(p_user_data);
+}
+
+// Reads the options only SerialReplay understands
+static bool _configure(data_struct * user_data, const godot_variant *p_options) {
+	user_data->speed = 1;
+	user_data->has_record = false;
+	user_data->finished = 0;
+	user_data->sent = false;
+
+	godot_variant value;
+	bool valid = true;
+
+	if (serial_port_get_option(p_options, "speed", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_INT && api->godot_variant_as_int(&value) >= 0)
+			user_data->speed = api->godot_variant_as_int(&value);
+		else if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_REAL && api->godot_variant_as_real(&value) >= 0)
+			user_data->speed = api->godot_variant_as_real(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	return valid;
+}
+
+static GDCALLINGCONV godot_variant open(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	bool success = false;
+	if (p_num_args >= 1 && !user_data->sim.base.is_open) {
+		godot_string path_str = api->godot_variant_as_string(p_args[0]);
+
+		serial_port_settings settings;
+		bool valid = serial_port_parse_settings(p_num_args - 1, p_args + 1, &settings);
+		valid = _configure(user_data, settings.options_arg) && valid;
+
+		if (valid && api->godot_string_length(&path_str) > 0) {
+			godot_char_string path_utf8 = api->godot_string_utf8(&path_str);
+			if (serial_log_open(&user_data->log, api->godot_char_string_get_data(&path_utf8)) && serial_port_prepare(&user_data->sim.base, &settings.options)) {
+				user_data->start_usec = serial_time_usec();
+				if (!settings.options.threaded || serial_sim_start_thread(&user_data->sim)) {
+					user_data->sim.base.is_open = true;
+					user_data->sim.base.config = settings.config;
+					user_data->sim.base.baudrate = settings.baudrate;
+					api->godot_string_destroy(&user_data->sim.base.port);
+					api->godot_string_new_copy(&user_data->sim.base.port, &path_str);
+
+					success = true;
+				}
+			}
+			if (!success)
+				_close(user_data);
+			api->godot_char_string_destroy(&path_utf8);
+		}
+		api->godot_string_destroy(&path_str);
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant close(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	if (user_data->sim.base.is_open) {
+		_close(user_data);
+		user_data->sim.base.is_open = false;
+	}
+
+	api->godot_variant_new_bool(&ret, true);
+	return ret;
+}
+
+// The session is over once the capture has been played and everything it received read
+static GDCALLINGCONV godot_variant is_connected(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	bool connected = user_data->sim.base.is_open;
+	if (connected && serial_atomic_load_u32(&user_data->finished))
+		connected = ring_buffer_available(&user_data->sim.base.rx) > 0;
+
+	api->godot_variant_new_bool(&ret, connected);
+	return ret;
+}
+
+// flush(timeout_ms): writes go nowhere, so only the thread taking them can keep it waiting.
+// Returns whether it was done within timeout_ms.
+static GDCALLINGCONV godot_variant flush(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	bool drained = user_data->sim.base.is_open;
+
+	if (drained && user_data->sim.base.threaded)
+		drained = serial_sim_wait_tx_empty(&user_data->sim, serial_port_parse_flush(&user_data->sim.base, p_num_args, p_args, serial_port_tx_pending(&user_data->sim.base)));
+
+	api->godot_variant_new_bool(&ret, drained);
+	return ret;
+}
+
+// reconfigure(baudrate, config) or reconfigure(config: SerialConfig): only remembered, like what
+// open() was given, since the capture keeps its pace
+static GDCALLINGCONV godot_variant reconfigure(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	bool success = false;
+
+	serial_port_settings settings;
+	if (user_data->sim.base.is_open && serial_port_parse_settings(p_num_args, p_args, &settings)) {
+		user_data->sim.base.baudrate = settings.baudrate;
+		user_data->sim.base.config = settings.config;
+		success = true;
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static godot_variant _set_output(data_struct * user_data, serial_modem_line p_line, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	uint32_t outputs;
+
+	bool success = serial_port_parse_modem_output(&user_data->sim.base, p_line, p_num_args, p_args, &outputs);
+	if (success)
+		serial_atomic_store_u32(&user_data->sim.base.modem_outputs, outputs);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// set_rts(level), set_dtr(level) and send_break(duration_ms): accepted and skipped like writes,
+// since nothing in the capture answers them. A threaded port still emits break_completed.
+static GDCALLINGCONV godot_variant set_rts(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	return _set_output((data_struct *) p_user_data, SERIAL_MODEM_RTS, p_num_args, p_args);
+}
+
+static GDCALLINGCONV godot_variant set_dtr(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	return _set_output((data_struct *) p_user_data, SERIAL_MODEM_DTR, p_num_args, p_args);
+}
+
+static GDCALLINGCONV godot_variant send_break(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	int duration_ms;
+
+	bool success = serial_port_parse_break(&user_data->sim.base, p_num_args, p_args, &duration_ms);
+	if (success && user_data->sim.base.threaded)
+		serial_port_complete_break(&user_data->sim.base, true);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// Modem lines are not part of a capture, so there is never anything to report, nor any modem_lines_changed
+static GDCALLINGCONV godot_variant get_modem_lines(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port_modem_lines_to_variant(SERIAL_MODEM_UNKNOWN, &ret);
+	return ret;
+}
+
+// Line errors are not part of a capture
+static GDCALLINGCONV godot_variant get_stats(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	serial_port_get_stats(&user_data->sim.base, NULL, &ret);
+	return ret;
+}
+
+godot_serial_interface godot_serial_replay_implementation = {0x13,
+                                                             constructor, destructor,
+                                                             open, close, is_connected,
+                                                             serial_port_available_for_read, serial_sim_available_for_write,
+                                                             flush, serial_port_peek, serial_port_read, serial_port_read_string, serial_sim_write,
+                                                             serial_sim_set_timeout, serial_port_get_overflow_count,
+                                                             serial_port_read_bytes, serial_port_read_all,
+                                                             serial_port_read_line, serial_port_read_until,
+                                                             serial_port_read_packet, serial_sim_write_packet,
+                                                             serial_port_get_rejected_frames,
+                                                             serial_port_unpack, serial_sim_list_ports, get_stats,
+                                                             serial_port_read_with_timestamps, serial_sim_get_latency_settings, serial_sim_transact, serial_port_record, serial_sim_modbus_poll,
+                                                             reconfigure, set_rts, set_dtr, send_break, get_modem_lines,
+                                                             serial_port_dispatch_notifications, serial_sim_check_connection};
@@ -0,0 +1,191 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "ring_buffer.h"
+#include "godot_serial.h"
+#include "serial_atomic.h"
+#include "serial_scan.h"
+#include <string.h>
+
+bool ring_buffer_init(ring_buffer *p_ring, uint32_t p_capacity) {
+	if (p_capacity == 0 || (p_capacity & (p_capacity - 1)) != 0)
+		return false;
+
+	p_ring->data = api->godot_alloc(p_capacity);
+	if (p_ring->data == NULL)
+		return false;
+	p_ring->mask = p_capacity - 1;
+	p_ring->head = 0;
+	p_ring->tail = 0;
+	return true;
+}
+
+void ring_buffer_destroy(ring_buffer *p_ring) {
+	if (p_ring->data != NULL)
+		api->godot_free(p_ring->data);
+	p_ring->data = NULL;
+	p_ring->mask = 0;
+	p_ring->head = 0;
+	p_ring->tail = 0;
+}
+
+void ring_buffer_clear(ring_buffer *p_ring) {
+	serial_atomic_store_u32(&p_ring->tail, 0);
+	serial_atomic_store_u32(&p_ring->head, 0);
+}
+
+bool ring_buffer_resize(ring_buffer *p_ring, uint32_t p_capacity) {
+	if (p_capacity == ring_buffer_capacity(p_ring))
+		return true;
+
+	const uint32_t pending = ring_buffer_available(p_ring);
+	ring_buffer resized;
+	if (pending > p_capacity || !ring_buffer_init(&resized, p_capacity))
+		return false;
+
+	ring_buffer_peek(p_ring, resized.data, pending);
+	resized.head = pending;
+	ring_buffer_destroy(p_ring);
+	*p_ring = resized;
+	return true;
+}
+
+// Smallest power of two able to hold p_size bytes, or 0 if there is none
+uint32_t ring_buffer_round_capacity(uint32_t p_size) {
+	if (p_size == 0 || p_size > 0x80000000u)
+		return 0;
+
+	uint32_t capacity = 1;
+	while (capacity < p_size)
+		capacity <<= 1;
+	return capacity;
+}
+
+uint32_t ring_buffer_capacity(const ring_buffer *p_ring) {
+	return p_ring->data != NULL ? p_ring->mask + 1 : 0;
+}
+
+uint32_t ring_buffer_available(ring_buffer *p_ring) {
+	return serial_atomic_load_u32(&p_ring->head) - p_ring->tail;
+}
+
+uint32_t ring_buffer_read_region(ring_buffer *p_ring, const uint8_t **r_data) {
+	const uint32_t available = ring_buffer_available(p_ring);
+	const uint32_t offset = p_ring->tail & p_ring->mask;
+	const uint32_t contiguous = p_ring->mask + 1 - offset;
+
+	*r_data = p_ring->data + offset;
+	return available < contiguous ? available : contiguous;
+}
+
+uint32_t ring_buffer_peek(ring_buffer *p_ring, uint8_t *r_data, uint32_t p_length) {
+	const uint32_t available = ring_buffer_available(p_ring);
+	if (p_length > available)
+		p_length = available;
+
+	// At most two copies: up to the end of storage, then from its start
+	const uint32_t offset = p_ring->tail & p_ring->mask;
+	const uint32_t contiguous = p_ring->mask + 1 - offset;
+	if (p_length <= contiguous) {
+		memcpy(r_data, p_ring->data + offset, p_length);
+	} else {
+		memcpy(r_data, p_ring->data + offset, contiguous);
+		memcpy(r_data + contiguous, p_ring->data, p_length - contiguous);
+	}
+	return p_length;
+}
+
+void ring_buffer_consume(ring_buffer *p_ring, uint32_t p_length) {
+	serial_atomic_store_u32(&p_ring->tail, p_ring->tail + p_length);
+}
+
+uint8_t ring_buffer_at(ring_buffer *p_ring, uint32_t p_offset) {
+	return p_ring->data[(p_ring->tail + p_offset) & p_ring->mask];
+}
+
+uint32_t ring_buffer_read(ring_buffer *p_ring, uint8_t *r_data, uint32_t p_length) {
+	p_length = ring_buffer_peek(p_ring, r_data, p_length);
+	ring_buffer_consume(p_ring, p_length);
+	return p_length;
+}
+
+int64_t ring_buffer_find(ring_buffer *p_ring, uint8_t p_byte, uint32_t p_from) {
+	const uint32_t available = ring_buffer_available(p_ring);
+	if (p_from >= available)
+		return -1;
+
+	// Up to the end of storage, then from its start
+	const uint32_t offset = (p_ring->tail + p_from) & p_ring->mask;
+	const uint32_t length = available - p_from;
+	const uint32_t contiguous = p_ring->mask + 1 - offset;
+	const uint32_t first = length < contiguous ? length : contiguous;
+
+	const uint8_t *found = serial_scan_byte(p_ring->data + offset, first, p_byte);
+	if (found != NULL)
+		return p_from + (found - (p_ring->data + offset));
+	if (first < length) {
+		found = serial_scan_byte(p_ring->data, length - first, p_byte);
+		if (found != NULL)
+			return p_from + first + (found - p_ring->data);
+	}
+	return -1;
+}
+
+uint32_t ring_buffer_free_space(ring_buffer *p_ring) {
+	return p_ring->mask + 1 - (p_ring->head - serial_atomic_load_u32(&p_ring->tail));
+}
+
+uint32_t ring_buffer_pending(ring_buffer *p_ring) {
+	return p_ring->head - serial_atomic_load_u32(&p_ring->tail);
+}
+
+uint32_t ring_buffer_write_region(ring_buffer *p_ring, uint8_t **r_data) {
+	const uint32_t free_space = ring_buffer_free_space(p_ring);
+	const uint32_t offset = p_ring->head & p_ring->mask;
+	const uint32_t contiguous = p_ring->mask + 1 - offset;
+
+	*r_data = p_ring->data + offset;
+	return free_space < contiguous ? free_space : contiguous;
+}
+
+void ring_buffer_commit(ring_buffer *p_ring, uint32_t p_length) {
+	serial_atomic_store_u32(&p_ring->head, p_ring->head + p_length);
+}
+
+uint32_t ring_buffer_write(ring_buffer *p_ring, const uint8_t *p_data, uint32_t p_length) {
+	const uint32_t free_space = ring_buffer_free_space(p_ring);
+	if (p_length > free_space)
+		p_length = free_space;
+
+	const uint32_t offset = p_ring->head & p_ring->mask;
+	const uint32_t contiguous = p_ring->mask + 1 - offset;
+	if (p_length <= contiguous) {
+		memcpy(p_ring->data + offset, p_data, p_length);
+	} else {
+		memcpy(p_ring->data + offset, p_data, contiguous);
+		memcpy(p_ring->data, p_data + contiguous, p_length - contiguous);
+	}
+	ring_buffer_commit(p_ring, p_length);
+	return p_length;
+}
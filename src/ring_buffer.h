@@ -0,0 +1,72 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lock-free single-producer/single-consumer byte queue.
+// head and tail are free-running counters: the producer only ever moves head,
+// the consumer only ever moves tail, and capacity is a power of two so both
+// wrap with a mask instead of a branch.
+typedef struct {
+	uint8_t *data;
+	uint32_t mask;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+} ring_buffer;
+
+bool ring_buffer_init(ring_buffer *p_ring, uint32_t p_capacity);
+void ring_buffer_destroy(ring_buffer *p_ring);
+// Only safe while no producer is running
+void ring_buffer_clear(ring_buffer *p_ring);
+// Moves pending bytes to new storage; fails if they would not fit. Only safe while no producer is running.
+bool ring_buffer_resize(ring_buffer *p_ring, uint32_t p_capacity);
+
+uint32_t ring_buffer_round_capacity(uint32_t p_size);
+
+uint32_t ring_buffer_capacity(const ring_buffer *p_ring);
+
+// Consumer side
+uint32_t ring_buffer_available(ring_buffer *p_ring);
+uint32_t ring_buffer_read_region(ring_buffer *p_ring, const uint8_t **r_data);
+uint32_t ring_buffer_peek(ring_buffer *p_ring, uint8_t *r_data, uint32_t p_length);
+void ring_buffer_consume(ring_buffer *p_ring, uint32_t p_length);
+uint32_t ring_buffer_read(ring_buffer *p_ring, uint8_t *r_data, uint32_t p_length);
+// Pending byte at p_offset from the oldest one, which must be below ring_buffer_available()
+uint8_t ring_buffer_at(ring_buffer *p_ring, uint32_t p_offset);
+// Offset of the first p_byte among the pending bytes, starting at p_from, or -1 if there is none
+int64_t ring_buffer_find(ring_buffer *p_ring, uint8_t p_byte, uint32_t p_from);
+
+// Producer side
+uint32_t ring_buffer_free_space(ring_buffer *p_ring);
+// Bytes the consumer has yet to take, as seen from the producer
+uint32_t ring_buffer_pending(ring_buffer *p_ring);
+uint32_t ring_buffer_write_region(ring_buffer *p_ring, uint8_t **r_data);
+void ring_buffer_commit(ring_buffer *p_ring, uint32_t p_length);
+uint32_t ring_buffer_write(ring_buffer *p_ring, const uint8_t *p_data, uint32_t p_length);
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,83 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_ATOMIC_H
+#define SERIAL_ATOMIC_H
+
+#include <stdint.h>
+
+// Just enough atomics for single-producer/single-consumer hand-offs between
+// the I/O thread and the game thread. MSVC has no <stdatomic.h> in C mode.
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+static __forceinline uint32_t serial_atomic_load_u32(volatile uint32_t *p_value) {
+	return (uint32_t) _InterlockedOr((volatile long *) p_value, 0);
+}
+
+static __forceinline void serial_atomic_store_u32(volatile uint32_t *p_value, uint32_t p_new) {
+	_InterlockedExchange((volatile long *) p_value, (long) p_new);
+}
+
+static __forceinline uint32_t serial_atomic_exchange_u32(volatile uint32_t *p_value, uint32_t p_new) {
+	return (uint32_t) _InterlockedExchange((volatile long *) p_value, (long) p_new);
+}
+
+static __forceinline uint64_t serial_atomic_load_u64(volatile uint64_t *p_value) {
+	return (uint64_t) _InterlockedOr64((volatile __int64 *) p_value, 0);
+}
+
+static __forceinline void serial_atomic_add_u64(volatile uint64_t *p_value, uint64_t p_delta) {
+	_InterlockedExchangeAdd64((volatile __int64 *) p_value, (__int64) p_delta);
+}
+
+#else
+
+static inline uint32_t serial_atomic_load_u32(volatile uint32_t *p_value) {
+	return __atomic_load_n(p_value, __ATOMIC_ACQUIRE);
+}
+
+static inline void serial_atomic_store_u32(volatile uint32_t *p_value, uint32_t p_new) {
+	__atomic_store_n(p_value, p_new, __ATOMIC_RELEASE);
+}
+
+// Full barrier, for wake-up flags that must not miss data published just before them
+static inline uint32_t serial_atomic_exchange_u32(volatile uint32_t *p_value, uint32_t p_new) {
+	return __atomic_exchange_n(p_value, p_new, __ATOMIC_SEQ_CST);
+}
+
+// Counters only need to be tear-free, not ordered with the data they count
+static inline uint64_t serial_atomic_load_u64(volatile uint64_t *p_value) {
+	return __atomic_load_n(p_value, __ATOMIC_RELAXED);
+}
+
+static inline void serial_atomic_add_u64(volatile uint64_t *p_value, uint64_t p_delta) {
+	__atomic_fetch_add(p_value, p_delta, __ATOMIC_RELAXED);
+}
+
+#endif
+
+#endif // SERIAL_ATOMIC_H
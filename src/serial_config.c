@@ -0,0 +1,149 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_config.h"
+#include "godot_serial.h"
+
+static serial_config *_configs = NULL;
+
+GDCALLINGCONV void *serial_config_constructor(godot_object *p_instance, void *p_method_data) {
+	serial_config *config = api->godot_alloc(sizeof(serial_config));
+	config->instance = p_instance;
+	config->valid = false;
+	config->baudrate = 0;
+	config->config = SERIAL_8N1;
+	serial_port_parse_options(NULL, &config->options);
+	api->godot_variant_new_nil(&config->options_arg);
+
+	config->next = _configs;
+	_configs = config;
+	return config;
+}
+
+GDCALLINGCONV void serial_config_destructor(godot_object *p_instance, void *p_method_data, void *p_user_data) {
+	serial_config *config = (serial_config *) p_user_data;
+	for (serial_config **entry = &_configs; *entry != NULL; entry = &(*entry)->next) {
+		if (*entry == config) {
+			*entry = config->next;
+			break;
+		}
+	}
+	api->godot_variant_destroy(&config->options_arg);
+	api->godot_free(p_user_data);
+}
+
+serial_config *serial_config_find(const godot_variant *p_value) {
+	if (api->godot_variant_get_type(p_value) != GODOT_VARIANT_TYPE_OBJECT)
+		return NULL;
+
+	godot_object *instance = api->godot_variant_as_object(p_value);
+	for (serial_config *config = _configs; config != NULL; config = config->next) {
+		if (config->instance == instance)
+			return config;
+	}
+	return NULL;
+}
+
+// Dictionaries are shared, so the config keeps its own: editing the one given to setup()
+// afterwards must not change what was checked
+static void _copy_options(const godot_variant *p_options, godot_variant *r_copy) {
+	if (p_options == NULL || api->godot_variant_get_type(p_options) != GODOT_VARIANT_TYPE_DICTIONARY) {
+		api->godot_variant_new_nil(r_copy);
+		return;
+	}
+
+	godot_dictionary options = api->godot_variant_as_dictionary(p_options);
+	godot_array keys = api->godot_dictionary_keys(&options);
+	godot_dictionary copy;
+	api->godot_dictionary_new(&copy);
+	for (godot_int i = 0; i < api->godot_array_size(&keys); i++) {
+		godot_variant key = api->godot_array_get(&keys, i);
+		godot_variant value = api->godot_dictionary_get(&options, &key);
+		api->godot_dictionary_set(&copy, &key, &value);
+		api->godot_variant_destroy(&value);
+		api->godot_variant_destroy(&key);
+	}
+
+	api->godot_variant_new_dictionary(r_copy, &copy);
+	api->godot_dictionary_destroy(&copy);
+	api->godot_array_destroy(&keys);
+	api->godot_dictionary_destroy(&options);
+}
+
+// setup(baudrate = 19200, config = "8N1", options = {}): takes what open() would after the port
+// name, or another SerialConfig to copy. Options only a backend understands are left for its open().
+GDCALLINGCONV godot_variant serial_config_setup(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_config * config = (serial_config *) p_user_data;
+
+	serial_port_settings settings;
+	config->valid = serial_port_parse_settings(p_num_args, p_args, &settings);
+	if (config->valid) {
+		// Copied first, since it may be the one held already
+		godot_variant options_arg;
+		_copy_options(settings.options_arg, &options_arg);
+		api->godot_variant_destroy(&config->options_arg);
+		config->options_arg = options_arg;
+
+		config->baudrate = settings.baudrate;
+		config->config = settings.config;
+		config->options = settings.options;
+	}
+
+	api->godot_variant_new_bool(&ret, config->valid);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_config_is_valid(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_config * config = (serial_config *) p_user_data;
+
+	api->godot_variant_new_bool(&ret, config->valid);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_config_get_baudrate(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_config * config = (serial_config *) p_user_data;
+
+	api->godot_variant_new_int(&ret, config->baudrate);
+	return ret;
+}
+
+// As the godot_serial_config value, whichever way setup() was given it
+GDCALLINGCONV godot_variant serial_config_get_config(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_config * config = (serial_config *) p_user_data;
+
+	api->godot_variant_new_int(&ret, config->config);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_config_get_options(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_config * config = (serial_config *) p_user_data;
+
+	_copy_options(&config->options_arg, &ret);
+	return ret;
+}
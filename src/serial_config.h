@@ -0,0 +1,60 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_CONFIG_H
+#define SERIAL_CONFIG_H
+
+#include <gdnative_api_struct.gen.h>
+#include "serial_port.h"
+
+typedef struct serial_config serial_config;
+
+// SerialConfig: everything open() takes after the port name, checked once by setup() and
+// kept ready to be handed to open() or reconfigure() of any backend as often as needed.
+struct serial_config {
+	godot_object *instance;
+	serial_config *next; // every live config, to recognise them among the arguments of open()
+
+	bool valid;
+	int baudrate;
+	godot_serial_config config;
+	serial_port_options options;
+	// The Dictionary setup() was given, for the options only a backend understands.
+	// It also keeps the SerialHub among them alive.
+	godot_variant options_arg;
+};
+
+// The live config p_value holds, or NULL if it is anything else
+serial_config *serial_config_find(const godot_variant *p_value);
+
+GDCALLINGCONV void *serial_config_constructor(godot_object *p_instance, void *p_method_data);
+GDCALLINGCONV void serial_config_destructor(godot_object *p_instance, void *p_method_data, void *p_user_data);
+
+GDCALLINGCONV godot_variant serial_config_setup(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_config_is_valid(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_config_get_baudrate(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_config_get_config(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_config_get_options(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+#endif // SERIAL_CONFIG_H
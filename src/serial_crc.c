@@ -0,0 +1,142 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_crc.h"
+
+static bool _initialized = false;
+static uint16_t _ccitt_table[256];
+static uint16_t _modbus_table[256];
+// Slice-by-8: _crc32_table[k][b] is the CRC of byte b followed by k zero bytes
+static uint32_t _crc32_table[8][256];
+
+void serial_crc_init(void) {
+	if (_initialized)
+		return;
+
+	for (uint32_t i = 0; i < 256; i++) {
+		uint16_t ccitt = (uint16_t) (i << 8);
+		uint16_t modbus = (uint16_t) i;
+		uint32_t crc32 = i;
+		for (int bit = 0; bit < 8; bit++) {
+			ccitt = (ccitt & 0x8000) ? (uint16_t) ((ccitt << 1) ^ 0x1021) : (uint16_t) (ccitt << 1);
+			modbus = (modbus & 1) ? (modbus >> 1) ^ 0xa001 : modbus >> 1;
+			crc32 = (crc32 & 1) ? (crc32 >> 1) ^ 0xedb88320u : crc32 >> 1;
+		}
+		_ccitt_table[i] = ccitt;
+		_modbus_table[i] = modbus;
+		_crc32_table[0][i] = crc32;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		for (int k = 1; k < 8; k++)
+			_crc32_table[k][i] = (_crc32_table[k - 1][i] >> 8) ^ _crc32_table[0][_crc32_table[k - 1][i] & 0xff];
+	}
+	_initialized = true;
+}
+
+uint16_t serial_crc16_ccitt(const uint8_t *p_data, uint32_t p_length) {
+	uint16_t crc = 0xffff;
+	for (uint32_t i = 0; i < p_length; i++)
+		crc = (uint16_t) (crc << 8) ^ _ccitt_table[((crc >> 8) ^ p_data[i]) & 0xff];
+	return crc;
+}
+
+uint16_t serial_crc16_modbus(const uint8_t *p_data, uint32_t p_length) {
+	uint16_t crc = 0xffff;
+	for (uint32_t i = 0; i < p_length; i++)
+		crc = (crc >> 8) ^ _modbus_table[(crc ^ p_data[i]) & 0xff];
+	return crc;
+}
+
+static inline uint32_t _load_le32(const uint8_t *p_data) {
+	return (uint32_t) p_data[0] | (uint32_t) p_data[1] << 8 | (uint32_t) p_data[2] << 16 | (uint32_t) p_data[3] << 24;
+}
+
+uint32_t serial_crc32(const uint8_t *p_data, uint32_t p_length) {
+	uint32_t crc = 0xffffffffu;
+
+	// Eight bytes per step through independent table lookups
+	for (; p_length >= 8; p_data += 8, p_length -= 8) {
+		const uint32_t one = _load_le32(p_data) ^ crc;
+		const uint32_t two = _load_le32(p_data + 4);
+		crc = _crc32_table[7][one & 0xff] ^ _crc32_table[6][(one >> 8) & 0xff] ^
+		      _crc32_table[5][(one >> 16) & 0xff] ^ _crc32_table[4][one >> 24] ^
+		      _crc32_table[3][two & 0xff] ^ _crc32_table[2][(two >> 8) & 0xff] ^
+		      _crc32_table[1][(two >> 16) & 0xff] ^ _crc32_table[0][two >> 24];
+	}
+	for (; p_length > 0; p_data++, p_length--)
+		crc = (crc >> 8) ^ _crc32_table[0][(crc ^ *p_data) & 0xff];
+
+	return crc ^ 0xffffffffu;
+}
+
+uint32_t serial_checksum_size(serial_checksum p_checksum) {
+	switch (p_checksum) {
+	case SERIAL_CHECKSUM_CRC16_CCITT:
+	case SERIAL_CHECKSUM_MODBUS:
+		return 2;
+	case SERIAL_CHECKSUM_CRC32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+void serial_checksum_append(serial_checksum p_checksum, const uint8_t *p_data, uint32_t p_length, uint8_t *r_dst) {
+	switch (p_checksum) {
+	case SERIAL_CHECKSUM_CRC16_CCITT: {
+		const uint16_t crc = serial_crc16_ccitt(p_data, p_length);
+		r_dst[0] = (uint8_t) (crc >> 8);
+		r_dst[1] = (uint8_t) crc;
+		break;
+	}
+	case SERIAL_CHECKSUM_MODBUS: {
+		const uint16_t crc = serial_crc16_modbus(p_data, p_length);
+		r_dst[0] = (uint8_t) crc;
+		r_dst[1] = (uint8_t) (crc >> 8);
+		break;
+	}
+	case SERIAL_CHECKSUM_CRC32: {
+		const uint32_t crc = serial_crc32(p_data, p_length);
+		for (int i = 0; i < 4; i++)
+			r_dst[i] = (uint8_t) (crc >> (8 * i));
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+bool serial_checksum_verify(serial_checksum p_checksum, const uint8_t *p_data, uint32_t p_length) {
+	const uint32_t size = serial_checksum_size(p_checksum);
+	if (p_length < size)
+		return false;
+
+	uint8_t expected[4];
+	serial_checksum_append(p_checksum, p_data, p_length - size, expected);
+	for (uint32_t i = 0; i < size; i++) {
+		if (expected[i] != p_data[p_length - size + i])
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,52 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_CRC_H
+#define SERIAL_CRC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+	SERIAL_CHECKSUM_NONE,
+	SERIAL_CHECKSUM_CRC16_CCITT, // poly 0x1021, init 0xFFFF, sent high byte first
+	SERIAL_CHECKSUM_CRC32,       // IEEE 802.3, sent low byte first
+	SERIAL_CHECKSUM_MODBUS,      // CRC-16/MODBUS, sent low byte first
+} serial_checksum;
+
+// Builds the lookup tables; call once from the main thread before anything below
+void serial_crc_init(void);
+
+uint16_t serial_crc16_ccitt(const uint8_t *p_data, uint32_t p_length);
+uint16_t serial_crc16_modbus(const uint8_t *p_data, uint32_t p_length);
+uint32_t serial_crc32(const uint8_t *p_data, uint32_t p_length);
+
+// Bytes the checksum takes on the wire
+uint32_t serial_checksum_size(serial_checksum p_checksum);
+// Writes the checksum of p_data, in wire order, to r_dst
+void serial_checksum_append(serial_checksum p_checksum, const uint8_t *p_data, uint32_t p_length, uint8_t *r_dst);
+// Whether the last serial_checksum_size() bytes of p_data match the ones before them
+bool serial_checksum_verify(serial_checksum p_checksum, const uint8_t *p_data, uint32_t p_length);
+
+#endif // SERIAL_CRC_H
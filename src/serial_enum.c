@@ -0,0 +1,130 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_enum.h"
+#include "godot_serial.h"
+#include <string.h>
+
+void serial_enum_clear(serial_port_list *p_list) {
+	p_list->num_ports = 0;
+}
+
+bool serial_enum_add(serial_port_list *p_list, const serial_port_info *p_info) {
+	uint32_t i = 0;
+	while (i < p_list->num_ports && strcmp(p_list->ports[i].path, p_info->path) < 0)
+		i++;
+
+	if (i == p_list->num_ports || strcmp(p_list->ports[i].path, p_info->path) != 0) {
+		if (p_list->num_ports == SERIAL_ENUM_MAX_PORTS)
+			return false;
+		memmove(&p_list->ports[i + 1], &p_list->ports[i], (p_list->num_ports - i) * sizeof(serial_port_info));
+		p_list->num_ports++;
+	}
+	p_list->ports[i] = *p_info;
+	return true;
+}
+
+bool serial_enum_remove(serial_port_list *p_list, const char *p_path) {
+	const serial_port_info *info = serial_enum_find(p_list, p_path);
+	if (info == NULL)
+		return false;
+
+	const uint32_t i = info - p_list->ports;
+	memmove(&p_list->ports[i], &p_list->ports[i + 1], (p_list->num_ports - i - 1) * sizeof(serial_port_info));
+	p_list->num_ports--;
+	return true;
+}
+
+const serial_port_info *serial_enum_find(const serial_port_list *p_list, const char *p_path) {
+	for (uint32_t i = 0; i < p_list->num_ports; i++) {
+		if (strcmp(p_list->ports[i].path, p_path) == 0)
+			return &p_list->ports[i];
+	}
+	return NULL;
+}
+
+const serial_port_info *serial_enum_find_device(const serial_port_list *p_list, const serial_port_info *p_device) {
+	if (p_device->serial_number[0] == '\0')
+		return serial_enum_find(p_list, p_device->path);
+
+	for (uint32_t i = 0; i < p_list->num_ports; i++) {
+		const serial_port_info *info = &p_list->ports[i];
+		if (strcmp(info->serial_number, p_device->serial_number) == 0 && info->vid == p_device->vid && info->pid == p_device->pid)
+			return info;
+	}
+	return NULL;
+}
+
+static void _set_string(godot_dictionary *p_dict, const char *p_key, const char *p_value) {
+	godot_string key, value;
+	godot_variant key_variant, value_variant;
+	api->godot_string_new(&key);
+	api->godot_string_parse_utf8(&key, p_key);
+	api->godot_string_new(&value);
+	api->godot_string_parse_utf8(&value, p_value);
+	api->godot_variant_new_string(&key_variant, &key);
+	api->godot_variant_new_string(&value_variant, &value);
+
+	api->godot_dictionary_set(p_dict, &key_variant, &value_variant);
+
+	api->godot_variant_destroy(&value_variant);
+	api->godot_variant_destroy(&key_variant);
+	api->godot_string_destroy(&value);
+	api->godot_string_destroy(&key);
+}
+
+static void _set_int(godot_dictionary *p_dict, const char *p_key, int64_t p_value) {
+	godot_string key;
+	godot_variant key_variant, value_variant;
+	api->godot_string_new(&key);
+	api->godot_string_parse_utf8(&key, p_key);
+	api->godot_variant_new_string(&key_variant, &key);
+	api->godot_variant_new_int(&value_variant, p_value);
+
+	api->godot_dictionary_set(p_dict, &key_variant, &value_variant);
+
+	api->godot_variant_destroy(&value_variant);
+	api->godot_variant_destroy(&key_variant);
+	api->godot_string_destroy(&key);
+}
+
+void serial_enum_to_array(const serial_port_list *p_list, godot_array *r_ports) {
+	api->godot_array_new(r_ports);
+	for (uint32_t i = 0; i < p_list->num_ports; i++) {
+		const serial_port_info *info = &p_list->ports[i];
+		godot_dictionary port;
+		api->godot_dictionary_new(&port);
+		_set_string(&port, "path", info->path);
+		_set_string(&port, "driver", info->driver);
+		_set_string(&port, "serial_number", info->serial_number);
+		_set_int(&port, "vid", info->vid);
+		_set_int(&port, "pid", info->pid);
+
+		godot_variant item;
+		api->godot_variant_new_dictionary(&item, &port);
+		api->godot_array_append(r_ports, &item);
+		api->godot_variant_destroy(&item);
+		api->godot_dictionary_destroy(&port);
+	}
+}
@@ -0,0 +1,60 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_ENUM_H
+#define SERIAL_ENUM_H
+
+#include <gdnative_api_struct.gen.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SERIAL_ENUM_MAX_PORTS 128
+
+typedef struct {
+	char path[128];
+	char driver[64];
+	char serial_number[128]; // empty when the device reports none
+	int32_t vid;             // -1 unless it is a USB device
+	int32_t pid;
+} serial_port_info;
+
+// Ports present on the system, sorted by path. Backends keep one up to date as
+// devices come and go, so listing them never has to touch the system.
+typedef struct {
+	serial_port_info ports[SERIAL_ENUM_MAX_PORTS];
+	uint32_t num_ports;
+} serial_port_list;
+
+void serial_enum_clear(serial_port_list *p_list);
+// Adds p_info, replacing the entry with the same path. Returns false if the list is full.
+bool serial_enum_add(serial_port_list *p_list, const serial_port_info *p_info);
+bool serial_enum_remove(serial_port_list *p_list, const char *p_path);
+const serial_port_info *serial_enum_find(const serial_port_list *p_list, const char *p_path);
+// Where p_device is now: the port with the same serial number, or with the same path if it has none
+const serial_port_info *serial_enum_find_device(const serial_port_list *p_list, const serial_port_info *p_device);
+
+// One Dictionary per port: "path", "driver", "serial_number", "vid" and "pid"
+void serial_enum_to_array(const serial_port_list *p_list, godot_array *r_ports);
+
+#endif // SERIAL_ENUM_H
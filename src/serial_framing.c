@@ -0,0 +1,160 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_framing.h"
+#include <string.h>
+
+#define SLIP_ESC 0xdb
+#define SLIP_ESC_END 0xdc
+#define SLIP_ESC_ESC 0xdd
+
+uint32_t serial_framing_max_encoded(serial_framing p_framing, uint32_t p_length, uint32_t p_length_size) {
+	switch (p_framing) {
+	case SERIAL_FRAMING_LENGTH:
+		return p_length_size + p_length;
+	case SERIAL_FRAMING_COBS:
+		// One code byte per 254 payload bytes, at least one, plus the delimiter
+		return p_length + p_length / 254 + 2;
+	case SERIAL_FRAMING_SLIP:
+		// Every byte escaped, between two END bytes
+		return 2 * p_length + 2;
+	default:
+		return p_length;
+	}
+}
+
+static uint32_t _cobs_encode(const uint8_t *p_data, uint32_t p_length, uint8_t *r_dst) {
+	uint32_t code_at = 0;
+	uint32_t out = 1;
+	uint8_t code = 1;
+
+	for (uint32_t i = 0; i < p_length; i++) {
+		if (p_data[i] == 0) {
+			r_dst[code_at] = code;
+			code_at = out++;
+			code = 1;
+			continue;
+		}
+		r_dst[out++] = p_data[i];
+		if (++code == 0xff && i + 1 < p_length) {
+			// A full block carries no implicit zero; the last one needs no successor
+			r_dst[code_at] = code;
+			code_at = out++;
+			code = 1;
+		}
+	}
+	r_dst[code_at] = code;
+	r_dst[out++] = SERIAL_FRAMING_COBS_DELIMITER;
+	return out;
+}
+
+static bool _cobs_decode(uint8_t *p_data, uint32_t p_length, uint32_t *r_length) {
+	uint32_t in = 0;
+	uint32_t out = 0;
+
+	while (in < p_length) {
+		const uint8_t code = p_data[in++];
+		if (code == 0 || in + code - 1 > p_length)
+			return false;
+
+		// Output never overtakes input, so decoding in place is safe
+		memmove(p_data + out, p_data + in, code - 1);
+		out += code - 1;
+		in += code - 1;
+		if (code != 0xff && in < p_length)
+			p_data[out++] = 0;
+	}
+	*r_length = out;
+	return true;
+}
+
+static uint32_t _slip_encode(const uint8_t *p_data, uint32_t p_length, uint8_t *r_dst) {
+	uint32_t out = 0;
+
+	// A leading END flushes any line noise the receiver has accumulated
+	r_dst[out++] = SERIAL_FRAMING_SLIP_END;
+	for (uint32_t i = 0; i < p_length; i++) {
+		if (p_data[i] == SERIAL_FRAMING_SLIP_END) {
+			r_dst[out++] = SLIP_ESC;
+			r_dst[out++] = SLIP_ESC_END;
+		} else if (p_data[i] == SLIP_ESC) {
+			r_dst[out++] = SLIP_ESC;
+			r_dst[out++] = SLIP_ESC_ESC;
+		} else {
+			r_dst[out++] = p_data[i];
+		}
+	}
+	r_dst[out++] = SERIAL_FRAMING_SLIP_END;
+	return out;
+}
+
+static bool _slip_decode(uint8_t *p_data, uint32_t p_length, uint32_t *r_length) {
+	uint32_t out = 0;
+
+	for (uint32_t in = 0; in < p_length; in++) {
+		if (p_data[in] != SLIP_ESC) {
+			p_data[out++] = p_data[in];
+			continue;
+		}
+		if (++in == p_length)
+			return false;
+		if (p_data[in] == SLIP_ESC_END)
+			p_data[out++] = SERIAL_FRAMING_SLIP_END;
+		else if (p_data[in] == SLIP_ESC_ESC)
+			p_data[out++] = SLIP_ESC;
+		else
+			return false;
+	}
+	*r_length = out;
+	return true;
+}
+
+uint32_t serial_framing_encode(serial_framing p_framing, uint32_t p_length_size, const uint8_t *p_data, uint32_t p_length, uint8_t *r_dst) {
+	switch (p_framing) {
+	case SERIAL_FRAMING_LENGTH:
+		for (uint32_t i = 0; i < p_length_size; i++)
+			r_dst[i] = (uint8_t) (p_length >> (8 * i));
+		memcpy(r_dst + p_length_size, p_data, p_length);
+		return p_length_size + p_length;
+	case SERIAL_FRAMING_COBS:
+		return _cobs_encode(p_data, p_length, r_dst);
+	case SERIAL_FRAMING_SLIP:
+		return _slip_encode(p_data, p_length, r_dst);
+	default:
+		memcpy(r_dst, p_data, p_length);
+		return p_length;
+	}
+}
+
+bool serial_framing_decode(serial_framing p_framing, uint8_t *p_data, uint32_t p_length, uint32_t *r_length) {
+	switch (p_framing) {
+	case SERIAL_FRAMING_COBS:
+		return _cobs_decode(p_data, p_length, r_length);
+	case SERIAL_FRAMING_SLIP:
+		return _slip_decode(p_data, p_length, r_length);
+	default:
+		*r_length = p_length;
+		return true;
+	}
+}
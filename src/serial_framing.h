@@ -0,0 +1,51 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_FRAMING_H
+#define SERIAL_FRAMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+	SERIAL_FRAMING_NONE,
+	SERIAL_FRAMING_LENGTH, // little-endian length header of 1, 2 or 4 bytes, then the payload
+	SERIAL_FRAMING_COBS,   // Consistent Overhead Byte Stuffing, each frame ending with 0x00
+	SERIAL_FRAMING_SLIP,   // RFC 1055, each frame between END (0xC0) bytes
+} serial_framing;
+
+#define SERIAL_FRAMING_COBS_DELIMITER 0x00
+#define SERIAL_FRAMING_SLIP_END 0xc0
+
+// Largest encoding of a p_length byte payload, delimiters included
+uint32_t serial_framing_max_encoded(serial_framing p_framing, uint32_t p_length, uint32_t p_length_size);
+
+// Encodes p_data into r_dst, which must hold serial_framing_max_encoded() bytes,
+// and returns the encoded length. Delimited modes terminate the frame themselves.
+uint32_t serial_framing_encode(serial_framing p_framing, uint32_t p_length_size, const uint8_t *p_data, uint32_t p_length, uint8_t *r_dst);
+
+// Decodes a COBS or SLIP frame, delimiter excluded, in place. Returns false if it is malformed.
+bool serial_framing_decode(serial_framing p_framing, uint8_t *p_data, uint32_t p_length, uint32_t *r_length);
+
+#endif // SERIAL_FRAMING_H
@@ -0,0 +1,137 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_hub.h"
+#include "godot_serial.h"
+#include "serial_atomic.h"
+#include <stdio.h>
+
+static serial_hub *_hubs = NULL;
+
+void serial_hub_init(serial_hub *p_hub, godot_object *p_instance) {
+	p_hub->instance = p_instance;
+	p_hub->num_ports = 0;
+	ring_buffer_init(&p_hub->ready, SERIAL_HUB_MAX_PORTS * sizeof(serial_port *));
+	p_hub->num_active = 0;
+
+	p_hub->next = _hubs;
+	_hubs = p_hub;
+}
+
+void serial_hub_destroy(serial_hub *p_hub) {
+	for (serial_hub **hub = &_hubs; *hub != NULL; hub = &(*hub)->next) {
+		if (*hub == p_hub) {
+			*hub = p_hub->next;
+			break;
+		}
+	}
+	ring_buffer_destroy(&p_hub->ready);
+}
+
+serial_hub *serial_hub_find(const godot_variant *p_value) {
+	if (api->godot_variant_get_type(p_value) != GODOT_VARIANT_TYPE_OBJECT)
+		return NULL;
+
+	godot_object *instance = api->godot_variant_as_object(p_value);
+	for (serial_hub *hub = _hubs; hub != NULL; hub = hub->next) {
+		if (hub->instance == instance)
+			return hub;
+	}
+	return NULL;
+}
+
+bool serial_hub_join(serial_hub *p_hub, serial_port *p_port) {
+	if (p_hub->num_ports >= SERIAL_HUB_MAX_PORTS) {
+		fprintf(stderr, "SerialHub cannot take more than %d ports\n", SERIAL_HUB_MAX_PORTS);
+		return false;
+	}
+
+	p_hub->num_ports++;
+	p_port->hub = p_hub;
+	p_port->hub_ready = 0;
+	api->godot_variant_new_object(&p_port->hub_ref, p_hub->instance);
+	return true;
+}
+
+// Moves everything the I/O loop queued over to active
+static void _collect_ready(serial_hub *p_hub) {
+	serial_port *port;
+	while (ring_buffer_read(&p_hub->ready, (uint8_t *) &port, sizeof(port)) == sizeof(port))
+		p_hub->active[p_hub->num_active++] = port;
+}
+
+void serial_hub_leave(serial_port *p_port) {
+	serial_hub *hub = p_port->hub;
+	if (hub == NULL)
+		return;
+
+	_collect_ready(hub);
+	for (uint32_t i = 0; i < hub->num_active; i++) {
+		if (hub->active[i] == p_port) {
+			hub->active[i] = hub->active[--hub->num_active];
+			break;
+		}
+	}
+
+	hub->num_ports--;
+	p_port->hub = NULL;
+	api->godot_variant_destroy(&p_port->hub_ref);
+}
+
+void serial_hub_mark_ready(serial_port *p_port) {
+	if (serial_atomic_exchange_u32(&p_port->hub_ready, 1) == 0)
+		ring_buffer_write(&p_port->hub->ready, (const uint8_t *) &p_port, sizeof(p_port));
+}
+
+GDCALLINGCONV godot_variant serial_hub_poll(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_hub * hub = (serial_hub *) p_user_data;
+
+	// Only ports that received something since they were last found empty are looked at
+	_collect_ready(hub);
+
+	godot_array ports;
+	api->godot_array_new(&ports);
+	for (uint32_t i = 0; i < hub->num_active;) {
+		serial_port *port = hub->active[i];
+		if (ring_buffer_available(&port->rx) == 0) {
+			serial_atomic_exchange_u32(&port->hub_ready, 0);
+			// Data buffered meanwhile has either queued the port again or is seen here
+			if (ring_buffer_available(&port->rx) == 0 || serial_atomic_exchange_u32(&port->hub_ready, 1) != 0) {
+				hub->active[i] = hub->active[--hub->num_active];
+				continue;
+			}
+		}
+
+		godot_variant instance;
+		api->godot_variant_new_object(&instance, port->instance);
+		api->godot_array_append(&ports, &instance);
+		api->godot_variant_destroy(&instance);
+		i++;
+	}
+
+	api->godot_variant_new_array(&ret, &ports);
+	api->godot_array_destroy(&ports);
+	return ret;
+}
@@ -0,0 +1,65 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_HUB_H
+#define SERIAL_HUB_H
+
+#include <gdnative_api_struct.gen.h>
+#include "serial_port.h"
+
+#define SERIAL_HUB_MAX_PORTS 64
+
+typedef struct serial_hub serial_hub;
+
+// State shared by every backend's SerialHub. A hub services all the ports opened
+// with it from a single I/O loop, so the script polls it once per frame instead of
+// every port. Backends embed it as the first member of their hub data.
+struct serial_hub {
+	godot_object *instance;
+	serial_hub *next; // every live hub, to recognise them among the options given to open()
+	uint32_t num_ports;
+
+	// Ports the I/O loop found data for, as serial_port pointers. A port is queued only
+	// while its hub_ready flag is down, so at most once, and the flag stays up while
+	// poll() keeps reporting it from active.
+	ring_buffer ready;
+	serial_port *active[SERIAL_HUB_MAX_PORTS];
+	uint32_t num_active;
+};
+
+void serial_hub_init(serial_hub *p_hub, godot_object *p_instance);
+void serial_hub_destroy(serial_hub *p_hub);
+
+// The live hub p_value holds, or NULL if it is anything else
+serial_hub *serial_hub_find(const godot_variant *p_value);
+// Registers a port being opened; the port keeps the hub alive until it leaves
+bool serial_hub_join(serial_hub *p_hub, serial_port *p_port);
+// Called once the hub's I/O loop no longer services the port. May free the hub.
+void serial_hub_leave(serial_port *p_port);
+// Called by the hub's I/O loop after buffering data for p_port
+void serial_hub_mark_ready(serial_port *p_port);
+
+GDCALLINGCONV godot_variant serial_hub_poll(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+#endif // SERIAL_HUB_H
@@ -79,8 +79,66 @@ typedef struct {
 	GDCALLINGCONV godot_variant (*write) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
 
 	GDCALLINGCONV godot_variant (*set_timeout) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*get_overflow_count) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*read_bytes) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+	GDCALLINGCONV godot_variant (*read_all) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*read_line) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+	GDCALLINGCONV godot_variant (*read_until) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*read_packet) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+	GDCALLINGCONV godot_variant (*write_packet) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*get_rejected_frames) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*unpack) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*list_ports) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*get_stats) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*read_with_timestamps) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*get_latency_settings) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*transact) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*record) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*modbus_poll) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*reconfigure) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	GDCALLINGCONV godot_variant (*set_rts) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+	GDCALLINGCONV godot_variant (*set_dtr) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+	GDCALLINGCONV godot_variant (*send_break) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+	GDCALLINGCONV godot_variant (*get_modem_lines) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+	// Internal: deferred from the I/O thread to emit the data signals on the main thread
+	GDCALLINGCONV godot_variant (*dispatch_notifications) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+	// Internal: deferred from the hotplug tracker to reconnect ports opened with "reconnect"
+	GDCALLINGCONV godot_variant (*check_connection) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
 } godot_serial_interface;
 
 extern godot_serial_interface godot_serial_implementation;
+// VirtualSerial: a simulated device, the same on every platform
+extern godot_serial_interface godot_serial_virtual_implementation;
+// SerialReplay: plays back a capture file written by record(), the same on every platform
+extern godot_serial_interface godot_serial_replay_implementation;
+
+// SerialHub: one I/O loop servicing every port opened with it
+typedef struct {
+	GDCALLINGCONV void * (*constructor) (godot_object *p_instance, void *p_method_data);
+	GDCALLINGCONV void (*destructor) (godot_object *p_instance, void *p_method_data, void *p_user_data);
+
+	GDCALLINGCONV godot_variant (*poll) (godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+} godot_serial_hub_interface;
+
+extern godot_serial_hub_interface godot_serial_hub_implementation;
+
+// Releases what a backend keeps beyond its objects, such as its hotplug tracking
+void godot_serial_terminate(void);
 
 #endif // GODOT_SERIAL_H
@@ -0,0 +1,287 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_log.h"
+#include "serial_thread.h"
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SERIAL_LOG_INITIAL_SIZE (1024 * 1024)
+#define SERIAL_LOG_MAX_GROWTH (64 * 1024 * 1024)
+
+static const uint8_t _magic[8] = { 'G', 'D', 'S', 'E', 'R', 'L', 'O', 'G' };
+
+static void _put_u32(uint8_t *p_dst, uint32_t p_value) {
+	for (int i = 0; i < 4; i++)
+		p_dst[i] = (uint8_t) (p_value >> (8 * i));
+}
+
+static void _put_i64(uint8_t *p_dst, int64_t p_value) {
+	for (int i = 0; i < 8; i++)
+		p_dst[i] = (uint8_t) ((uint64_t) p_value >> (8 * i));
+}
+
+static uint32_t _get_u32(const uint8_t *p_src) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++)
+		value |= (uint32_t) p_src[i] << (8 * i);
+	return value;
+}
+
+static int64_t _get_i64(const uint8_t *p_src) {
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++)
+		value |= (uint64_t) p_src[i] << (8 * i);
+	return (int64_t) value;
+}
+
+static uint64_t _padded(uint64_t p_length) {
+	return (p_length + 7) & ~(uint64_t) 7;
+}
+
+// Sizes the file to p_size and maps all of it in place of the previous mapping
+static bool _map(serial_log_writer *p_log, uint64_t p_size) {
+#if defined(_WIN32)
+	HANDLE mapping = CreateFileMappingA(p_log->file, NULL, PAGE_READWRITE, (DWORD) (p_size >> 32), (DWORD) p_size, NULL);
+	if (mapping == NULL)
+		return false;
+	uint8_t *data = (uint8_t *) MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T) p_size);
+	if (data == NULL) {
+		CloseHandle(mapping);
+		return false;
+	}
+	if (p_log->data != NULL) {
+		UnmapViewOfFile(p_log->data);
+		CloseHandle(p_log->mapping);
+	}
+	p_log->mapping = mapping;
+#else
+	if (ftruncate(p_log->fd, (off_t) p_size) != 0)
+		return false;
+	void *data = mmap(NULL, p_size, PROT_READ | PROT_WRITE, MAP_SHARED, p_log->fd, 0);
+	if (data == MAP_FAILED)
+		return false;
+	if (p_log->data != NULL)
+		munmap(p_log->data, p_log->size);
+#endif
+	p_log->data = (uint8_t *) data;
+	p_log->size = p_size;
+	return true;
+}
+
+void serial_log_writer_init(serial_log_writer *p_log) {
+#if defined(_WIN32)
+	p_log->file = INVALID_HANDLE_VALUE;
+	p_log->mapping = NULL;
+#else
+	p_log->fd = -1;
+#endif
+	p_log->data = NULL;
+	p_log->size = 0;
+	p_log->used = 0;
+	p_log->start_usec = 0;
+	p_log->failed = false;
+}
+
+bool serial_log_create(serial_log_writer *p_log, const char *p_path) {
+	serial_log_writer_init(p_log);
+#if defined(_WIN32)
+	p_log->file = CreateFileA(p_path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (p_log->file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Error creating capture file: %s : %i\n", p_path, GetLastError());
+		return false;
+	}
+#else
+	p_log->fd = open(p_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (p_log->fd < 0) {
+		fprintf(stderr, "Error creating capture file: %s : %s\n", p_path, strerror(errno));
+		return false;
+	}
+#endif
+	if (!_map(p_log, SERIAL_LOG_INITIAL_SIZE)) {
+		fprintf(stderr, "Error mapping capture file: %s\n", p_path);
+		serial_log_close(p_log);
+		return false;
+	}
+
+	memcpy(p_log->data, _magic, sizeof(_magic));
+	_put_u32(p_log->data + 8, SERIAL_LOG_VERSION);
+	_put_u32(p_log->data + 12, 0);
+	_put_i64(p_log->data + 16, (int64_t) time(NULL));
+	p_log->used = SERIAL_LOG_HEADER_SIZE;
+	p_log->start_usec = serial_time_usec();
+	return true;
+}
+
+void serial_log_append(serial_log_writer *p_log, bool p_sent, const uint8_t *p_data, uint32_t p_length) {
+	if (p_length == 0 || p_length > SERIAL_LOG_MAX_RECORD || p_log->failed || p_log->data == NULL)
+		return;
+
+	const uint64_t record_size = SERIAL_LOG_RECORD_HEADER_SIZE + _padded(p_length);
+	if (p_log->used + record_size > p_log->size) {
+		uint64_t size = p_log->size;
+		while (p_log->used + record_size > size)
+			size += size < SERIAL_LOG_MAX_GROWTH ? size : SERIAL_LOG_MAX_GROWTH;
+		if (!_map(p_log, size)) {
+			fprintf(stderr, "Error growing capture file, recording stops here\n");
+			p_log->failed = true;
+			return;
+		}
+	}
+
+	// Padding is already zero: the file grows zero-filled and nothing is ever written twice
+	uint8_t *record = p_log->data + p_log->used;
+	_put_i64(record, serial_time_usec() - p_log->start_usec);
+	_put_u32(record + 8, p_length | (p_sent ? SERIAL_LOG_SENT : 0));
+	_put_u32(record + 12, 0);
+	memcpy(record + SERIAL_LOG_RECORD_HEADER_SIZE, p_data, p_length);
+	p_log->used += record_size;
+}
+
+void serial_log_close(serial_log_writer *p_log) {
+#if defined(_WIN32)
+	if (p_log->data != NULL) {
+		UnmapViewOfFile(p_log->data);
+		CloseHandle(p_log->mapping);
+	}
+	if (p_log->file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER end;
+		end.QuadPart = (LONGLONG) p_log->used;
+		if (SetFilePointerEx(p_log->file, end, NULL, FILE_BEGIN))
+			SetEndOfFile(p_log->file);
+		CloseHandle(p_log->file);
+	}
+#else
+	if (p_log->data != NULL)
+		munmap(p_log->data, p_log->size);
+	if (p_log->fd >= 0) {
+		if (ftruncate(p_log->fd, (off_t) p_log->used) != 0)
+			fprintf(stderr, "Error trimming capture file: %s\n", strerror(errno));
+		close(p_log->fd);
+	}
+#endif
+	serial_log_writer_init(p_log);
+}
+
+void serial_log_reader_init(serial_log_reader *p_log) {
+#if defined(_WIN32)
+	p_log->file = INVALID_HANDLE_VALUE;
+	p_log->mapping = NULL;
+#else
+	p_log->fd = -1;
+#endif
+	p_log->data = NULL;
+	p_log->size = 0;
+	p_log->offset = 0;
+}
+
+bool serial_log_open(serial_log_reader *p_log, const char *p_path) {
+	serial_log_reader_init(p_log);
+#if defined(_WIN32)
+	p_log->file = CreateFileA(p_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if (p_log->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(p_log->file, &size)) {
+		fprintf(stderr, "Error opening capture file: %s : %i\n", p_path, GetLastError());
+		serial_log_reader_close(p_log);
+		return false;
+	}
+	p_log->size = (uint64_t) size.QuadPart;
+	if (p_log->size >= SERIAL_LOG_HEADER_SIZE) {
+		p_log->mapping = CreateFileMappingA(p_log->file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (p_log->mapping != NULL)
+			p_log->data = (const uint8_t *) MapViewOfFile(p_log->mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	struct stat info;
+	p_log->fd = open(p_path, O_RDONLY | O_CLOEXEC);
+	if (p_log->fd < 0 || fstat(p_log->fd, &info) != 0) {
+		fprintf(stderr, "Error opening capture file: %s : %s\n", p_path, strerror(errno));
+		serial_log_reader_close(p_log);
+		return false;
+	}
+	p_log->size = (uint64_t) info.st_size;
+	if (p_log->size >= SERIAL_LOG_HEADER_SIZE) {
+		void *data = mmap(NULL, p_log->size, PROT_READ, MAP_SHARED, p_log->fd, 0);
+		if (data != MAP_FAILED)
+			p_log->data = (const uint8_t *) data;
+	}
+#endif
+
+	if (p_log->data == NULL || memcmp(p_log->data, _magic, sizeof(_magic)) != 0 || _get_u32(p_log->data + 8) != SERIAL_LOG_VERSION) {
+		fprintf(stderr, "Not a capture file: %s\n", p_path);
+		serial_log_reader_close(p_log);
+		return false;
+	}
+	p_log->offset = SERIAL_LOG_HEADER_SIZE;
+	return true;
+}
+
+bool serial_log_next(serial_log_reader *p_log, serial_log_record *r_record) {
+	if (p_log->data == NULL || p_log->size - p_log->offset < SERIAL_LOG_RECORD_HEADER_SIZE)
+		return false;
+
+	const uint8_t *record = p_log->data + p_log->offset;
+	const uint32_t length = _get_u32(record + 8) & ~SERIAL_LOG_SENT;
+	if (length == 0 || p_log->size - p_log->offset - SERIAL_LOG_RECORD_HEADER_SIZE < length)
+		return false;
+
+	r_record->usec = _get_i64(record);
+	r_record->sent = (_get_u32(record + 8) & SERIAL_LOG_SENT) != 0;
+	r_record->data = record + SERIAL_LOG_RECORD_HEADER_SIZE;
+	r_record->length = length;
+
+	const uint64_t record_size = SERIAL_LOG_RECORD_HEADER_SIZE + _padded(length);
+	p_log->offset = record_size < p_log->size - p_log->offset ? p_log->offset + record_size : p_log->size;
+	return true;
+}
+
+void serial_log_rewind(serial_log_reader *p_log) {
+	p_log->offset = SERIAL_LOG_HEADER_SIZE;
+}
+
+void serial_log_reader_close(serial_log_reader *p_log) {
+#if defined(_WIN32)
+	if (p_log->data != NULL)
+		UnmapViewOfFile(p_log->data);
+	if (p_log->mapping != NULL)
+		CloseHandle(p_log->mapping);
+	if (p_log->file != INVALID_HANDLE_VALUE)
+		CloseHandle(p_log->file);
+#else
+	if (p_log->data != NULL)
+		munmap((void *) p_log->data, p_log->size);
+	if (p_log->fd >= 0)
+		close(p_log->fd);
+#endif
+	serial_log_reader_init(p_log);
+}
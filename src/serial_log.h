@@ -0,0 +1,96 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_LOG_H
+#define SERIAL_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+// Capture files written by record() and played back by SerialReplay. A header, then one record
+// per chunk of traffic in the order it went through the port, all integers little-endian:
+//   header: "GDSERLOG", uint32 version, uint32 reserved, int64 start time in seconds since the Unix epoch
+//   record: int64 usec since the start, uint32 length with SERIAL_LOG_SENT set for bytes sent
+//           rather than received, uint32 reserved, the bytes, padded to a multiple of 8
+// The file is mapped and grown in steps while it is written, so a capture cut short by a crash
+// ends in zeroes, which read as the end: no record is empty.
+#define SERIAL_LOG_VERSION 1
+#define SERIAL_LOG_HEADER_SIZE 24
+#define SERIAL_LOG_RECORD_HEADER_SIZE 16
+#define SERIAL_LOG_SENT 0x80000000u
+#define SERIAL_LOG_MAX_RECORD 0x7fffffffu
+
+typedef struct {
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+	uint8_t *data;
+	uint64_t size; // mapped, the size of the file until it is closed
+	uint64_t used;
+	int64_t start_usec; // serial_time_usec() when it was created
+	bool failed; // the file could not grow, so nothing more goes in
+} serial_log_writer;
+
+typedef struct {
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+	const uint8_t *data;
+	uint64_t size;
+	uint64_t offset; // of the next record
+} serial_log_reader;
+
+typedef struct {
+	int64_t usec;
+	bool sent;
+	const uint8_t *data; // into the mapping, valid until the reader is closed
+	uint32_t length;
+} serial_log_record;
+
+void serial_log_writer_init(serial_log_writer *p_log);
+// Creates p_path, or empties it if it exists
+bool serial_log_create(serial_log_writer *p_log, const char *p_path);
+// Only ever called by one thread at a time
+void serial_log_append(serial_log_writer *p_log, bool p_sent, const uint8_t *p_data, uint32_t p_length);
+// Cuts the file down to what was written
+void serial_log_close(serial_log_writer *p_log);
+
+void serial_log_reader_init(serial_log_reader *p_log);
+bool serial_log_open(serial_log_reader *p_log, const char *p_path);
+// The next record, or false at the end of the capture
+bool serial_log_next(serial_log_reader *p_log, serial_log_record *r_record);
+void serial_log_rewind(serial_log_reader *p_log);
+void serial_log_reader_close(serial_log_reader *p_log);
+
+#endif // SERIAL_LOG_H
@@ -0,0 +1,179 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_modbus.h"
+#include "serial_crc.h"
+#include <string.h>
+
+static bool _is_read(uint8_t p_function) {
+	return p_function >= SERIAL_MODBUS_READ_COILS && p_function <= SERIAL_MODBUS_READ_INPUT_REGISTERS;
+}
+
+static bool _is_bits(uint8_t p_function) {
+	return p_function == SERIAL_MODBUS_READ_COILS || p_function == SERIAL_MODBUS_READ_DISCRETE_INPUTS || p_function == SERIAL_MODBUS_WRITE_MULTIPLE_COILS;
+}
+
+static void _put_u16(uint8_t *p_dst, uint16_t p_value) {
+	p_dst[0] = (uint8_t) (p_value >> 8);
+	p_dst[1] = (uint8_t) p_value;
+}
+
+static uint16_t _get_u16(const uint8_t *p_src) {
+	return (uint16_t) ((p_src[0] << 8) | p_src[1]);
+}
+
+bool serial_modbus_encode(serial_modbus_request *r_request, uint8_t p_slave, uint8_t p_function, uint16_t p_address, uint16_t p_count, const uint16_t *p_values) {
+	// Broadcasts are never answered, so they have no place in a poll
+	if (p_slave < 1 || p_slave > 247 || p_count == 0 || (uint32_t) p_address + p_count > 0x10000)
+		return false;
+
+	uint8_t *frame = r_request->frame;
+	frame[0] = p_slave;
+	frame[1] = p_function;
+	_put_u16(frame + 2, p_address);
+	uint32_t length = 4;
+
+	switch (p_function) {
+	case SERIAL_MODBUS_READ_COILS:
+	case SERIAL_MODBUS_READ_DISCRETE_INPUTS:
+	case SERIAL_MODBUS_READ_HOLDING_REGISTERS:
+	case SERIAL_MODBUS_READ_INPUT_REGISTERS: {
+		const uint32_t max_count = _is_bits(p_function) ? SERIAL_MODBUS_MAX_READ_BITS : SERIAL_MODBUS_MAX_READ_REGISTERS;
+		if (p_count > max_count)
+			return false;
+		_put_u16(frame + length, p_count);
+		length += 2;
+		r_request->response_length = 5 + (_is_bits(p_function) ? (p_count + 7) / 8 : p_count * 2);
+		break;
+	}
+	case SERIAL_MODBUS_WRITE_SINGLE_COIL:
+	case SERIAL_MODBUS_WRITE_SINGLE_REGISTER:
+		if (p_count != 1)
+			return false;
+		if (p_function == SERIAL_MODBUS_WRITE_SINGLE_COIL)
+			_put_u16(frame + length, p_values[0] ? 0xff00 : 0x0000);
+		else
+			_put_u16(frame + length, p_values[0]);
+		length += 2;
+		r_request->response_length = 8;
+		break;
+	case SERIAL_MODBUS_WRITE_MULTIPLE_COILS:
+	case SERIAL_MODBUS_WRITE_MULTIPLE_REGISTERS: {
+		const uint32_t max_count = _is_bits(p_function) ? SERIAL_MODBUS_MAX_WRITE_BITS : SERIAL_MODBUS_MAX_WRITE_REGISTERS;
+		if (p_count > max_count)
+			return false;
+		_put_u16(frame + length, p_count);
+		if (_is_bits(p_function)) {
+			const uint32_t num_bytes = (p_count + 7) / 8;
+			frame[length + 2] = (uint8_t) num_bytes;
+			memset(frame + length + 3, 0, num_bytes);
+			for (uint32_t i = 0; i < p_count; i++) {
+				if (p_values[i])
+					frame[length + 3 + i / 8] |= 1 << (i % 8);
+			}
+			length += 3 + num_bytes;
+		} else {
+			frame[length + 2] = (uint8_t) (p_count * 2);
+			for (uint32_t i = 0; i < p_count; i++)
+				_put_u16(frame + length + 3 + i * 2, p_values[i]);
+			length += 3 + p_count * 2;
+		}
+		r_request->response_length = 8;
+		break;
+	}
+	default:
+		return false;
+	}
+
+	const uint16_t crc = serial_crc16_modbus(frame, length);
+	frame[length] = (uint8_t) crc;
+	frame[length + 1] = (uint8_t) (crc >> 8);
+	r_request->frame_length = length + 2;
+	r_request->response_offset = 0;
+	r_request->received = 0;
+	return true;
+}
+
+uint32_t serial_modbus_frame_length(const uint8_t *p_data, uint32_t p_length) {
+	if (p_length < 2)
+		return 0;
+	if (p_data[1] & 0x80)
+		return 5; // slave, function | 0x80, exception code, CRC
+	if (!_is_read(p_data[1]))
+		return 8;
+	if (p_length < 3)
+		return 0;
+	return 5 + p_data[2];
+}
+
+int serial_modbus_decode(const serial_modbus_request *p_request, const uint8_t *p_data, uint32_t p_length, uint16_t *r_values, uint32_t *r_count) {
+	*r_count = 0;
+	if (p_length == 0)
+		return SERIAL_MODBUS_NO_RESPONSE;
+
+	const uint8_t *request = p_request->frame;
+	if (p_length < 5 || p_data[0] != request[0] || (p_data[1] & 0x7f) != request[1] || serial_modbus_frame_length(p_data, p_length) != p_length)
+		return SERIAL_MODBUS_BAD_RESPONSE;
+	const uint16_t crc = serial_crc16_modbus(p_data, p_length - 2);
+	if (p_data[p_length - 2] != (uint8_t) crc || p_data[p_length - 1] != (uint8_t) (crc >> 8))
+		return SERIAL_MODBUS_BAD_RESPONSE;
+	if (p_data[1] & 0x80)
+		return p_data[2] > 0 ? p_data[2] : SERIAL_MODBUS_BAD_RESPONSE;
+
+	const uint8_t function = request[1];
+	if (_is_read(function)) {
+		if (p_length != p_request->response_length)
+			return SERIAL_MODBUS_BAD_RESPONSE;
+		const uint16_t count = _get_u16(request + 4);
+		for (uint32_t i = 0; i < count; i++)
+			r_values[i] = _is_bits(function) ? (p_data[3 + i / 8] >> (i % 8)) & 1 : _get_u16(p_data + 3 + i * 2);
+		*r_count = count;
+	} else if (function == SERIAL_MODBUS_WRITE_SINGLE_COIL || function == SERIAL_MODBUS_WRITE_SINGLE_REGISTER) {
+		// The slave echoes the request
+		if (memcmp(p_data, request, 6) != 0)
+			return SERIAL_MODBUS_BAD_RESPONSE;
+		const uint16_t value = _get_u16(p_data + 4);
+		r_values[0] = function == SERIAL_MODBUS_WRITE_SINGLE_COIL ? value != 0 : value;
+		*r_count = 1;
+	} else {
+		// The slave confirms the address and how many it wrote
+		if (memcmp(p_data + 2, request + 2, 4) != 0)
+			return SERIAL_MODBUS_BAD_RESPONSE;
+		r_values[0] = _get_u16(p_data + 4);
+		*r_count = 1;
+	}
+	return SERIAL_MODBUS_OK;
+}
+
+int64_t serial_modbus_silence_usec(int p_baudrate, godot_serial_config p_config) {
+	if (p_baudrate <= 0 || p_baudrate > 19200)
+		return 1750;
+
+	// A start bit, the data bits, an optional parity bit and the stop bits
+	const int bitlength = (p_config & GODOT_SERIAL_BIT_LENGTH_MASK) >> 8;
+	const int parity = (p_config & GODOT_SERIAL_PARITY_MASK) >> 4;
+	const int stopbits = p_config & GODOT_SERIAL_STOP_BIT_MASK;
+	const int64_t char_bits = 1 + bitlength + (parity != 0) + stopbits;
+	return (char_bits * 35 * 1000000 / 10 + p_baudrate - 1) / p_baudrate;
+}
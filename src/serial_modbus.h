@@ -0,0 +1,83 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_MODBUS_H
+#define SERIAL_MODBUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "serial_interface.h"
+
+// Modbus RTU, master side: requests out, responses checked and taken apart. Frames are the
+// slave address, the function code, its data and a CRC-16/MODBUS, at most 256 bytes.
+#define SERIAL_MODBUS_MAX_FRAME 256
+#define SERIAL_MODBUS_MAX_READ_REGISTERS 125
+#define SERIAL_MODBUS_MAX_READ_BITS 2000
+#define SERIAL_MODBUS_MAX_WRITE_REGISTERS 123
+#define SERIAL_MODBUS_MAX_WRITE_BITS 1968
+
+typedef enum {
+	SERIAL_MODBUS_READ_COILS = 1,
+	SERIAL_MODBUS_READ_DISCRETE_INPUTS = 2,
+	SERIAL_MODBUS_READ_HOLDING_REGISTERS = 3,
+	SERIAL_MODBUS_READ_INPUT_REGISTERS = 4,
+	SERIAL_MODBUS_WRITE_SINGLE_COIL = 5,
+	SERIAL_MODBUS_WRITE_SINGLE_REGISTER = 6,
+	SERIAL_MODBUS_WRITE_MULTIPLE_COILS = 15,
+	SERIAL_MODBUS_WRITE_MULTIPLE_REGISTERS = 16,
+} serial_modbus_function;
+
+// What a request came to when it did not bring back values; exception codes from the slave are positive
+#define SERIAL_MODBUS_OK 0
+#define SERIAL_MODBUS_NO_RESPONSE -1
+#define SERIAL_MODBUS_BAD_RESPONSE -2 // wrong CRC, slave, function or length
+
+typedef struct {
+	uint8_t frame[SERIAL_MODBUS_MAX_FRAME];
+	uint32_t frame_length;
+	uint32_t response_length; // of a normal response, the longest one expected
+
+	// Where the response landed in rx, counted from where the batch started, and how long it is;
+	// 0 if nothing came back in time
+	uint32_t response_offset;
+	uint32_t received;
+} serial_modbus_request;
+
+// Builds the request frame. Reads take p_count coils or registers; writes take p_count values
+// from p_values, coils as 0 or 1. Returns false if the request cannot be expressed.
+bool serial_modbus_encode(serial_modbus_request *r_request, uint8_t p_slave, uint8_t p_function, uint16_t p_address, uint16_t p_count, const uint16_t *p_values);
+
+// Length of the response that starts with p_data, or 0 while fewer than 3 bytes tell too little
+uint32_t serial_modbus_frame_length(const uint8_t *p_data, uint32_t p_length);
+
+// Checks a response against its request and extracts what it holds: registers or coils read, or
+// for writes what the slave confirmed. r_values holds SERIAL_MODBUS_MAX_READ_BITS values. Returns
+// SERIAL_MODBUS_OK, the exception code the slave answered with, or SERIAL_MODBUS_NO_RESPONSE or
+// SERIAL_MODBUS_BAD_RESPONSE.
+int serial_modbus_decode(const serial_modbus_request *p_request, const uint8_t *p_data, uint32_t p_length, uint16_t *r_values, uint32_t *r_count);
+
+// The silent interval that separates frames: 3.5 characters, or 1750 us above 19200 baud
+int64_t serial_modbus_silence_usec(int p_baudrate, godot_serial_config p_config);
+
+#endif // SERIAL_MODBUS_H
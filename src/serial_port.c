@@ -0,0 +1,1801 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_port.h"
+#include "serial_hub.h"
+#include "serial_config.h"
+#include "godot_serial.h"
+#include "serial_atomic.h"
+#include "serial_utf8.h"
+#include "serial_thread.h"
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+
+// Object::call_deferred and Object::emit_signal, looked up once from the main thread
+static godot_method_bind *_call_deferred = NULL;
+static godot_method_bind *_emit_signal = NULL;
+
+void serial_port_init(serial_port *p_port, godot_object *p_instance, serial_port_pump_func p_pump) {
+	p_port->is_open = false;
+	p_port->config = SERIAL_8N1;
+	api->godot_string_new(&p_port->port);
+	p_port->timeout = 0;
+
+	p_port->baudrate = 0;
+	serial_port_parse_options(NULL, &p_port->options);
+	memset(&p_port->device, 0, sizeof(p_port->device));
+	p_port->lost = false;
+
+	p_port->threaded = false;
+	ring_buffer_init(&p_port->rx, SERIAL_PORT_DEFAULT_BUFFER_SIZE);
+	p_port->pump = p_pump;
+
+	p_port->overflow = 0;
+	p_port->rx_paused = 0;
+	p_port->resume_rx = NULL;
+	p_port->modem_outputs = SERIAL_MODEM_RTS | SERIAL_MODEM_DTR;
+	p_port->modem_lines = SERIAL_MODEM_UNKNOWN;
+	serial_stats_reset(&p_port->stats);
+
+	ring_buffer_init(&p_port->tx, SERIAL_PORT_DEFAULT_BUFFER_SIZE);
+	p_port->tx_wake_pending = 0;
+
+	p_port->instance = p_instance;
+	p_port->hub = NULL;
+	p_port->hub_ready = 0;
+	if (_call_deferred == NULL) {
+		_call_deferred = api->godot_method_bind_get_method("Object", "call_deferred");
+		_emit_signal = api->godot_method_bind_get_method("Object", "emit_signal");
+	}
+
+	p_port->notify = SERIAL_PORT_NOTIFY_NONE;
+	p_port->notify_pending = 0;
+
+	p_port->transaction_state = SERIAL_TRANSACTION_IDLE;
+	p_port->transaction_terminator_length = 0;
+	p_port->transaction_length = 0;
+	p_port->transaction_scanned = 0;
+	p_port->transaction_deadline = 0;
+
+	p_port->modbus_requests = NULL;
+	p_port->modbus_num_requests = 0;
+
+	p_port->break_ms = 0;
+
+	serial_log_writer_init(&p_port->log);
+	p_port->recording = 0;
+	p_port->log_busy = 0;
+
+	p_port->framing = SERIAL_FRAMING_NONE;
+	p_port->length_size = 2;
+
+	p_port->checksum = SERIAL_CHECKSUM_NONE;
+	p_port->rejected_frames = 0;
+	serial_crc_init();
+
+	p_port->scan_delimiter_length = 0;
+	p_port->scan_tail = 0;
+	p_port->scan_end = 0;
+
+	api->godot_string_new(&p_port->unpack_source);
+	p_port->unpack_compiled = false;
+}
+
+// Puts p_log in place of the capture file being written, if any, and closes that one. An I/O
+// thread that finds log_busy taken in the meantime leaves its bytes out rather than wait.
+static void _replace_log(serial_port *p_port, const serial_log_writer *p_log) {
+	serial_atomic_store_u32(&p_port->recording, 0);
+	while (serial_atomic_exchange_u32(&p_port->log_busy, 1) != 0)
+		serial_sleep_usec(50);
+
+	serial_log_writer previous = p_port->log;
+	if (p_log != NULL) {
+		p_port->log = *p_log;
+		serial_atomic_store_u32(&p_port->recording, 1);
+	} else {
+		serial_log_writer_init(&p_port->log);
+	}
+	serial_atomic_store_u32(&p_port->log_busy, 0);
+
+	serial_log_close(&previous);
+}
+
+// Lets go of the requests of a modbus_poll() that was reported or will never be
+static void _free_modbus_requests(serial_port *p_port) {
+	if (p_port->modbus_requests != NULL)
+		api->godot_free(p_port->modbus_requests);
+	p_port->modbus_requests = NULL;
+	p_port->modbus_num_requests = 0;
+}
+
+void serial_port_destroy(serial_port *p_port) {
+	_replace_log(p_port, NULL);
+	_free_modbus_requests(p_port);
+	ring_buffer_destroy(&p_port->tx);
+	ring_buffer_destroy(&p_port->rx);
+	api->godot_string_destroy(&p_port->unpack_source);
+	api->godot_string_destroy(&p_port->port);
+}
+
+static bool _get_option(const godot_dictionary *p_options, const char *p_key, godot_variant *r_value) {
+	godot_string key_str;
+	godot_variant key;
+	api->godot_string_new(&key_str);
+	api->godot_string_parse_utf8(&key_str, p_key);
+	api->godot_variant_new_string(&key, &key_str);
+
+	bool found = api->godot_dictionary_has(p_options, &key);
+	if (found)
+		*r_value = api->godot_dictionary_get(p_options, &key);
+
+	api->godot_variant_destroy(&key);
+	api->godot_string_destroy(&key_str);
+	return found;
+}
+
+static bool _get_buffer_size(const godot_variant *p_value, uint32_t *r_size) {
+	if (api->godot_variant_get_type(p_value) != GODOT_VARIANT_TYPE_INT)
+		return false;
+
+	const int64_t size = api->godot_variant_as_int(p_value);
+	if (size <= 0 || size > SERIAL_PORT_MAX_BUFFER_SIZE)
+		return false;
+	*r_size = ring_buffer_round_capacity((uint32_t) size);
+	return true;
+}
+
+// Maps a String option onto the index of the matching entry of p_choices
+static bool _get_choice(const godot_variant *p_value, const char *const *p_choices, int p_num_choices, int *r_choice) {
+	if (api->godot_variant_get_type(p_value) != GODOT_VARIANT_TYPE_STRING)
+		return false;
+
+	godot_string str = api->godot_variant_as_string(p_value);
+	godot_char_string cstr = api->godot_string_ascii(&str);
+	const char *choice = api->godot_char_string_get_data(&cstr);
+	bool valid = false;
+
+	for (int i = 0; i < p_num_choices && !valid; i++) {
+		if (strcmp(choice, p_choices[i]) == 0) {
+			*r_choice = i;
+			valid = true;
+		}
+	}
+
+	api->godot_char_string_destroy(&cstr);
+	api->godot_string_destroy(&str);
+	return valid;
+}
+
+bool serial_port_parse_options(const godot_variant *p_options, serial_port_options *r_options) {
+	r_options->threaded = false;
+	r_options->buffer_size = SERIAL_PORT_DEFAULT_BUFFER_SIZE;
+	r_options->write_buffer_size = SERIAL_PORT_DEFAULT_BUFFER_SIZE;
+	r_options->notify = SERIAL_PORT_NOTIFY_NONE;
+	r_options->framing = SERIAL_FRAMING_NONE;
+	r_options->length_size = 2;
+	r_options->checksum = SERIAL_CHECKSUM_NONE;
+	r_options->hub = NULL;
+	r_options->reconnect = false;
+	r_options->flow_control = SERIAL_FLOW_NONE;
+	r_options->modem_events = false;
+
+	if (p_options == NULL || api->godot_variant_get_type(p_options) == GODOT_VARIANT_TYPE_NIL)
+		return true;
+	if (api->godot_variant_get_type(p_options) != GODOT_VARIANT_TYPE_DICTIONARY)
+		return false;
+
+	godot_dictionary options = api->godot_variant_as_dictionary(p_options);
+	godot_variant value;
+	bool valid = true;
+
+	if (_get_option(&options, "threaded", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_BOOL)
+			r_options->threaded = api->godot_variant_as_bool(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "buffer_size", &value)) {
+		valid = _get_buffer_size(&value, &r_options->buffer_size) && valid;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "write_buffer_size", &value)) {
+		valid = _get_buffer_size(&value, &r_options->write_buffer_size) && valid;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "notify", &value)) {
+		// Same order as serial_port_notify
+		static const char *const notify_modes[] = { "", "data", "line", "packet", "chunks" };
+		int notify;
+		if (_get_choice(&value, notify_modes, sizeof(notify_modes) / sizeof(notify_modes[0]), &notify))
+			r_options->notify = (serial_port_notify) notify;
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+	// Signals are driven by the I/O thread
+	if (r_options->notify != SERIAL_PORT_NOTIFY_NONE)
+		r_options->threaded = true;
+
+	if (_get_option(&options, "framing", &value)) {
+		// Same order as serial_framing
+		static const char *const framing_modes[] = { "", "length", "cobs", "slip" };
+		int framing;
+		if (_get_choice(&value, framing_modes, sizeof(framing_modes) / sizeof(framing_modes[0]), &framing))
+			r_options->framing = (serial_framing) framing;
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "length_size", &value)) {
+		const int64_t size = api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_INT ? api->godot_variant_as_int(&value) : 0;
+		if (size == 1 || size == 2 || size == 4)
+			r_options->length_size = (uint32_t) size;
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "checksum", &value)) {
+		// Same order as serial_checksum
+		static const char *const checksums[] = { "", "crc16_ccitt", "crc32", "modbus" };
+		int checksum;
+		if (_get_choice(&value, checksums, sizeof(checksums) / sizeof(checksums[0]), &checksum))
+			r_options->checksum = (serial_checksum) checksum;
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "hub", &value)) {
+		r_options->hub = serial_hub_find(&value);
+		if (r_options->hub != NULL)
+			r_options->threaded = true;
+		else if (api->godot_variant_get_type(&value) != GODOT_VARIANT_TYPE_NIL)
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "reconnect", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_BOOL)
+			r_options->reconnect = api->godot_variant_as_bool(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "flow_control", &value)) {
+		// Same order as serial_flow_control
+		static const char *const flow_modes[] = { "", "rts_cts", "dtr_dsr", "xon_xoff" };
+		int flow_control;
+		if (_get_choice(&value, flow_modes, sizeof(flow_modes) / sizeof(flow_modes[0]), &flow_control))
+			r_options->flow_control = (serial_flow_control) flow_control;
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (_get_option(&options, "modem_events", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_BOOL)
+			r_options->modem_events = api->godot_variant_as_bool(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	// Only an I/O thread can keep writing whenever the device lets it, without the script waiting
+	if (r_options->flow_control != SERIAL_FLOW_NONE)
+		r_options->threaded = true;
+	// Nor can anything else watch the modem lines while the script does something else
+	if (r_options->modem_events)
+		r_options->threaded = true;
+
+	// Packets and their checksums only make sense once there is a framing to cut them out
+	if ((r_options->notify == SERIAL_PORT_NOTIFY_PACKET || r_options->checksum != SERIAL_CHECKSUM_NONE) && r_options->framing == SERIAL_FRAMING_NONE)
+		valid = false;
+
+	api->godot_dictionary_destroy(&options);
+	return valid;
+}
+
+bool serial_port_get_option(const godot_variant *p_options, const char *p_key, godot_variant *r_value) {
+	if (p_options == NULL || api->godot_variant_get_type(p_options) != GODOT_VARIANT_TYPE_DICTIONARY)
+		return false;
+
+	godot_dictionary options = api->godot_variant_as_dictionary(p_options);
+	bool found = _get_option(&options, p_key, r_value);
+	api->godot_dictionary_destroy(&options);
+	return found;
+}
+
+bool serial_port_parse_config(const godot_variant *p_value, godot_serial_config *r_config) {
+	int config = 0;
+	if (api->godot_variant_get_type(p_value) == GODOT_VARIANT_TYPE_INT) {
+		const int64_t value = api->godot_variant_as_int(p_value);
+		if (value > 0 && value <= 0xfff)
+			config = (int) value;
+	} else if (api->godot_variant_get_type(p_value) == GODOT_VARIANT_TYPE_STRING) {
+		godot_string format_str = api->godot_variant_as_string(p_value);
+		godot_char_string format_ascii_str = api->godot_string_ascii(&format_str);
+		const char *format = api->godot_char_string_get_data(&format_ascii_str);
+		if (api->godot_char_string_length(&format_ascii_str) == 3 && format[0] >= '5' && format[0] <= '8' && format[2] >= '1' && format[2] <= '2') {
+			config = (format[0] - '0') << 8 | (format[2] - '0');
+			if (format[1] == 'O' || format[1] == 'o')
+				config |= 0x030;
+			else if (format[1] == 'E' || format[1] == 'e')
+				config |= 0x020;
+			else if (format[1] != 'N' && format[1] != 'n')
+				config = 0;
+		}
+		api->godot_char_string_destroy(&format_ascii_str);
+		api->godot_string_destroy(&format_str);
+	}
+
+	// Only what godot_serial_config lists: 5 to 8 data bits, no, even or odd parity, 1 or 2 stop bits
+	const int bitlength = (config & GODOT_SERIAL_BIT_LENGTH_MASK) >> 8;
+	const int parity = (config & GODOT_SERIAL_PARITY_MASK) >> 4;
+	const int stopbits = config & GODOT_SERIAL_STOP_BIT_MASK;
+	if (bitlength < 5 || bitlength > 8 || parity == 1 || parity > 3 || stopbits < 1 || stopbits > 2)
+		return false;
+
+	*r_config = (godot_serial_config) config;
+	return true;
+}
+
+bool serial_port_parse_settings(int p_num_args, godot_variant **p_args, serial_port_settings *r_settings) {
+	// Checked once by SerialConfig.setup(), so only copied here
+	const serial_config *config = p_num_args >= 1 ? serial_config_find(p_args[0]) : NULL;
+	if (config != NULL) {
+		r_settings->baudrate = config->baudrate;
+		r_settings->config = config->config;
+		r_settings->options = config->options;
+		r_settings->options_arg = &config->options_arg;
+		return config->valid && p_num_args == 1;
+	}
+
+	r_settings->baudrate = 19200;
+	r_settings->config = SERIAL_8N1;
+	r_settings->options_arg = p_num_args >= 3 ? p_args[2] : NULL;
+	bool valid = serial_port_parse_options(r_settings->options_arg, &r_settings->options);
+
+	if (p_num_args >= 1) {
+		const int64_t baudrate = api->godot_variant_get_type(p_args[0]) == GODOT_VARIANT_TYPE_INT ? api->godot_variant_as_int(p_args[0]) : 0;
+		if (baudrate > 0 && baudrate <= INT32_MAX)
+			r_settings->baudrate = (int) baudrate;
+		else
+			valid = false;
+	}
+	if (p_num_args >= 2)
+		valid = serial_port_parse_config(p_args[1], &r_settings->config) && valid;
+
+	return valid;
+}
+
+bool serial_port_prepare(serial_port *p_port, const serial_port_options *p_options) {
+	ring_buffer_clear(&p_port->rx);
+	if (!ring_buffer_resize(&p_port->rx, p_options->buffer_size)) {
+		fprintf(stderr, "Error allocating a receive buffer of %u bytes\n", p_options->buffer_size);
+		return false;
+	}
+	ring_buffer_clear(&p_port->tx);
+	if (!ring_buffer_resize(&p_port->tx, p_options->write_buffer_size)) {
+		fprintf(stderr, "Error allocating a transmit buffer of %u bytes\n", p_options->write_buffer_size);
+		return false;
+	}
+	p_port->tx_wake_pending = 0;
+	p_port->notify = p_options->notify;
+	p_port->notify_pending = 0;
+	p_port->transaction_state = SERIAL_TRANSACTION_IDLE;
+	_free_modbus_requests(p_port);
+	p_port->framing = p_options->framing;
+	p_port->length_size = p_options->length_size;
+	p_port->checksum = p_options->checksum;
+	p_port->rejected_frames = 0;
+	p_port->scan_delimiter_length = 0;
+	p_port->overflow = 0;
+	p_port->rx_paused = 0;
+	// Opening the device raises both
+	p_port->modem_outputs = SERIAL_MODEM_RTS | SERIAL_MODEM_DTR;
+	p_port->modem_lines = SERIAL_MODEM_UNKNOWN;
+	serial_stats_reset(&p_port->stats);
+	p_port->options = *p_options;
+	p_port->lost = false;
+	return p_options->hub == NULL || serial_hub_join(p_options->hub, p_port);
+}
+
+void serial_port_count_overflow(serial_port *p_port, uint64_t p_bytes) {
+	serial_atomic_add_u64(&p_port->overflow, p_bytes);
+}
+
+void serial_port_pause_rx(serial_port *p_port) {
+	// Exchanges on both sides, so either the consumer sees the flag or this sees its room
+	serial_atomic_exchange_u32(&p_port->rx_paused, 1);
+	if (ring_buffer_free_space(&p_port->rx) > 0)
+		serial_atomic_exchange_u32(&p_port->rx_paused, 0);
+}
+
+void serial_port_log_traffic(serial_port *p_port, bool p_sent, const uint8_t *p_data, uint32_t p_length) {
+	if (!serial_atomic_load_u32(&p_port->recording) || serial_atomic_exchange_u32(&p_port->log_busy, 1) != 0)
+		return;
+	if (serial_atomic_load_u32(&p_port->recording))
+		serial_log_append(&p_port->log, p_sent, p_data, p_length);
+	serial_atomic_store_u32(&p_port->log_busy, 0);
+}
+
+static bool _enqueue(serial_port *p_port, const uint8_t *p_data, uint32_t p_length) {
+	if (ring_buffer_free_space(&p_port->tx) < p_length)
+		return false;
+	ring_buffer_write(&p_port->tx, p_data, p_length);
+	serial_stats_queued(&p_port->stats, &p_port->tx);
+	return true;
+}
+
+bool serial_port_enqueue(serial_port *p_port, const uint8_t *p_data, uint32_t p_length) {
+	// The bus belongs to modbus_poll() until it reports, and tx to the I/O thread sending its requests.
+	// Bytes written after send_break() wait for its break_completed rather than slip in ahead of it.
+	if (p_port->modbus_requests != NULL || serial_atomic_load_u32(&p_port->break_ms) != 0)
+		return false;
+	return _enqueue(p_port, p_data, p_length);
+}
+
+uint32_t serial_port_tx_pending(serial_port *p_port) {
+	return p_port->modbus_requests == NULL ? ring_buffer_pending(&p_port->tx) : 0;
+}
+
+uint32_t serial_port_tx_free_space(serial_port *p_port) {
+	return p_port->modbus_requests == NULL && serial_atomic_load_u32(&p_port->break_ms) == 0 ? ring_buffer_free_space(&p_port->tx) : 0;
+}
+
+bool serial_port_needs_wake(serial_port *p_port) {
+	return serial_atomic_exchange_u32(&p_port->tx_wake_pending, 1) == 0;
+}
+
+void serial_port_clear_wake(serial_port *p_port) {
+	serial_atomic_exchange_u32(&p_port->tx_wake_pending, 0);
+}
+
+static void _new_string_variant(godot_variant *r_variant, const char *p_value) {
+	godot_string str;
+	api->godot_string_new(&str);
+	api->godot_string_parse_utf8(&str, p_value);
+	api->godot_variant_new_string(r_variant, &str);
+	api->godot_string_destroy(&str);
+}
+
+// p_method(p_name, args...) on the port's object, with at most 3 extra arguments
+static void _call_named(serial_port *p_port, godot_method_bind *p_method, const char *p_name, int p_num_args, const godot_variant *p_args) {
+	const godot_variant *args[4];
+	godot_variant name;
+
+	if (p_num_args > 3)
+		p_num_args = 3;
+
+	_new_string_variant(&name, p_name);
+	args[0] = &name;
+	for (int i = 0; i < p_num_args; i++)
+		args[1 + i] = &p_args[i];
+
+	godot_variant_call_error error;
+	godot_variant ret = api->godot_method_bind_call(p_method, p_port->instance, args, 1 + p_num_args, &error);
+	api->godot_variant_destroy(&ret);
+	api->godot_variant_destroy(&name);
+}
+
+void serial_port_emit_deferred(serial_port *p_port, const char *p_signal, int p_num_args, const godot_variant *p_args) {
+	// call_deferred("emit_signal", p_signal, args...)
+	godot_variant args[3];
+	if (p_num_args > 2)
+		p_num_args = 2;
+
+	_new_string_variant(&args[0], p_signal);
+	for (int i = 0; i < p_num_args; i++)
+		args[1 + i] = p_args[i];
+
+	_call_named(p_port, _call_deferred, "emit_signal", 1 + p_num_args, args);
+	api->godot_variant_destroy(&args[0]);
+}
+
+void serial_port_call_deferred(serial_port *p_port, const char *p_method) {
+	_call_named(p_port, _call_deferred, p_method, 0, NULL);
+}
+
+static void _set_line_state(godot_dictionary *p_lines, const char *p_key, bool p_state) {
+	godot_variant key, value;
+	_new_string_variant(&key, p_key);
+	api->godot_variant_new_bool(&value, p_state);
+	api->godot_dictionary_set(p_lines, &key, &value);
+	api->godot_variant_destroy(&value);
+	api->godot_variant_destroy(&key);
+}
+
+void serial_port_modem_lines_to_variant(uint32_t p_lines, godot_variant *r_ret) {
+	godot_dictionary lines;
+	api->godot_dictionary_new(&lines);
+	if (p_lines != SERIAL_MODEM_UNKNOWN) {
+		_set_line_state(&lines, "cts", p_lines & SERIAL_MODEM_CTS);
+		_set_line_state(&lines, "dsr", p_lines & SERIAL_MODEM_DSR);
+		_set_line_state(&lines, "dcd", p_lines & SERIAL_MODEM_DCD);
+		_set_line_state(&lines, "ri", p_lines & SERIAL_MODEM_RI);
+		_set_line_state(&lines, "rts", p_lines & SERIAL_MODEM_RTS);
+		_set_line_state(&lines, "dtr", p_lines & SERIAL_MODEM_DTR);
+	}
+	api->godot_variant_new_dictionary(r_ret, &lines);
+	api->godot_dictionary_destroy(&lines);
+}
+
+void serial_port_report_modem_lines(serial_port *p_port, uint32_t p_lines) {
+	const uint32_t previous = p_port->modem_lines;
+	p_port->modem_lines = p_lines;
+	// The first look only sets what later ones compare with
+	if (previous == SERIAL_MODEM_UNKNOWN || ((previous ^ p_lines) & SERIAL_MODEM_INPUTS) == 0)
+		return;
+
+	// Queued one by one rather than through _dispatch_notifications, so no edge is lost to a later one
+	godot_variant lines;
+	serial_port_modem_lines_to_variant(p_lines, &lines);
+	serial_port_emit_deferred(p_port, "modem_lines_changed", 1, &lines);
+	api->godot_variant_destroy(&lines);
+}
+
+bool serial_port_parse_modem_output(serial_port *p_port, serial_modem_line p_line, int p_num_args, godot_variant **p_args, uint32_t *r_outputs) {
+	if (!p_port->is_open || p_num_args < 1 || api->godot_variant_get_type(p_args[0]) != GODOT_VARIANT_TYPE_BOOL)
+		return false;
+	if ((p_line == SERIAL_MODEM_RTS && p_port->options.flow_control == SERIAL_FLOW_RTS_CTS) || (p_line == SERIAL_MODEM_DTR && p_port->options.flow_control == SERIAL_FLOW_DTR_DSR)) {
+		fprintf(stderr, "%s is driven by flow control\n", p_line == SERIAL_MODEM_RTS ? "RTS" : "DTR");
+		return false;
+	}
+
+	if (api->godot_variant_as_bool(p_args[0]))
+		*r_outputs = p_port->modem_outputs | p_line;
+	else
+		*r_outputs = p_port->modem_outputs & ~(uint32_t) p_line;
+	return true;
+}
+
+bool serial_port_parse_break(serial_port *p_port, int p_num_args, godot_variant **p_args, int *r_duration_ms) {
+	*r_duration_ms = SERIAL_PORT_DEFAULT_BREAK_MS;
+	if (!p_port->is_open)
+		return false;
+	if (p_num_args < 1)
+		return true;
+	if (api->godot_variant_get_type(p_args[0]) != GODOT_VARIANT_TYPE_INT || api->godot_variant_as_int(p_args[0]) <= 0 || api->godot_variant_as_int(p_args[0]) > 10000)
+		return false;
+	*r_duration_ms = (int) api->godot_variant_as_int(p_args[0]);
+	return true;
+}
+
+bool serial_port_request_break(serial_port *p_port, int p_duration_ms) {
+	if (serial_atomic_load_u32(&p_port->break_ms) != 0) {
+		fprintf(stderr, "send_break() is still waiting for the break before to complete\n");
+		return false;
+	}
+	serial_atomic_store_u32(&p_port->break_ms, (uint32_t) p_duration_ms);
+	return true;
+}
+
+void serial_port_complete_break(serial_port *p_port, bool p_success) {
+	// Cleared first, so a send_break() answering the signal is not refused
+	serial_atomic_store_u32(&p_port->break_ms, 0);
+	godot_variant success;
+	api->godot_variant_new_bool(&success, p_success);
+	serial_port_emit_deferred(p_port, "break_completed", 1, &success);
+	api->godot_variant_destroy(&success);
+}
+
+int serial_port_parse_flush(serial_port *p_port, int p_num_args, godot_variant **p_args, uint32_t p_queued) {
+	if (p_num_args > 0 && api->godot_variant_get_type(p_args[0]) == GODOT_VARIANT_TYPE_INT && api->godot_variant_as_int(p_args[0]) >= 0)
+		return (int) (api->godot_variant_as_int(p_args[0]) < INT_MAX ? api->godot_variant_as_int(p_args[0]) : INT_MAX);
+	if (p_port->timeout > 0)
+		return p_port->timeout;
+	if (p_port->baudrate <= 0)
+		return SERIAL_PORT_FLUSH_MARGIN_MS;
+
+	// A start bit, the data bits, an optional parity bit and the stop bits
+	const int bitlength = (p_port->config & GODOT_SERIAL_BIT_LENGTH_MASK) >> 8;
+	const int parity = (p_port->config & GODOT_SERIAL_PARITY_MASK) >> 4;
+	const int stopbits = p_port->config & GODOT_SERIAL_STOP_BIT_MASK;
+	const int64_t line_ms = (int64_t) p_queued * (1 + bitlength + (parity != 0) + stopbits) * 1000 / p_port->baudrate;
+	return (int) (line_ms < INT_MAX - SERIAL_PORT_FLUSH_MARGIN_MS ? line_ms + SERIAL_PORT_FLUSH_MARGIN_MS : INT_MAX);
+}
+
+// Moves a modbus_poll() on once the response to modbus_current is in, returning whether that was the last
+static bool _next_modbus_request(serial_port *p_port, uint32_t p_received) {
+	p_port->modbus_requests[p_port->modbus_current].received = p_received;
+	if (++p_port->modbus_current == p_port->modbus_num_requests)
+		return true;
+
+	p_port->modbus_sending = true;
+	p_port->transaction_deadline = serial_time_usec() + p_port->modbus_silence_usec;
+	return false;
+}
+
+// Whether the last response of a modbus_poll() is in: responses end at the length their first
+// bytes announce, and the next request waits for the I/O thread to see the line silent
+static bool _check_modbus(serial_port *p_port) {
+	if (p_port->modbus_sending)
+		return false;
+
+	ring_buffer *rx = &p_port->rx;
+	const uint32_t offset = p_port->modbus_requests[p_port->modbus_current].response_offset;
+	const uint32_t received = ring_buffer_available(rx) - offset;
+	if (received == p_port->modbus_seen)
+		return false;
+	p_port->modbus_seen = received;
+	p_port->modbus_last_rx = serial_time_usec();
+
+	uint8_t head[3];
+	const uint32_t head_length = received < sizeof(head) ? received : sizeof(head);
+	for (uint32_t i = 0; i < head_length; i++)
+		head[i] = ring_buffer_at(rx, offset + i);
+	const uint32_t length = serial_modbus_frame_length(head, head_length);
+	return length > 0 && received >= length && _next_modbus_request(p_port, length);
+}
+
+// Whether the response to the waiting transaction is complete, looking only at bytes not seen before
+static bool _check_transaction(serial_port *p_port) {
+	if (p_port->modbus_requests != NULL)
+		return _check_modbus(p_port);
+
+	ring_buffer *rx = &p_port->rx;
+	const uint32_t available = ring_buffer_available(rx);
+	const uint32_t length = p_port->transaction_terminator_length;
+	if (length == 0)
+		return available >= p_port->transaction_length;
+
+	// Every match ends with the last terminator byte: scan for that one, then compare what precedes it
+	const uint8_t *terminator = p_port->transaction_terminator;
+	int64_t end;
+	while ((end = ring_buffer_find(rx, terminator[length - 1], p_port->transaction_scanned)) >= 0) {
+		p_port->transaction_scanned = end + 1;
+		if (end + 1 < length)
+			continue;
+		uint32_t matched = 1;
+		while (matched < length && ring_buffer_at(rx, end - matched) == terminator[length - 1 - matched])
+			matched++;
+		if (matched == length) {
+			p_port->transaction_length = end + 1;
+			return true;
+		}
+	}
+	p_port->transaction_scanned = available;
+	return false;
+}
+
+static void _schedule_dispatch(serial_port *p_port) {
+	if (serial_atomic_exchange_u32(&p_port->notify_pending, 1) == 0)
+		serial_port_call_deferred(p_port, "_dispatch_notifications");
+}
+
+static void _end_transaction(serial_port *p_port) {
+	serial_atomic_store_u32(&p_port->transaction_state, SERIAL_TRANSACTION_DONE);
+	_schedule_dispatch(p_port);
+}
+
+void serial_port_notify_received(serial_port *p_port) {
+	if (p_port->hub != NULL)
+		serial_hub_mark_ready(p_port);
+	if (serial_atomic_load_u32(&p_port->transaction_state) == SERIAL_TRANSACTION_WAITING && _check_transaction(p_port))
+		_end_transaction(p_port);
+	if (p_port->notify != SERIAL_PORT_NOTIFY_NONE)
+		_schedule_dispatch(p_port);
+}
+
+int serial_port_write_args(serial_port *p_port, int p_num_args, godot_variant **p_args, serial_port_write_func p_write) {
+	int num_errors = 0;
+
+	for (int n_arg = 0; n_arg < p_num_args; n_arg++) {
+		bool success;
+		switch (api->godot_variant_get_type(p_args[n_arg])) {
+		case GODOT_VARIANT_TYPE_BOOL: {
+			godot_bool val = api->godot_variant_as_bool(p_args[n_arg]);
+			if (val == GODOT_FALSE)
+				success = p_write(p_port, (const uint8_t *) "false", 5);
+			else
+				success = p_write(p_port, (const uint8_t *) "true", 4);
+			break;
+		}
+		case GODOT_VARIANT_TYPE_STRING: {
+			godot_string str = api->godot_variant_as_string(p_args[n_arg]);
+			godot_char_string cstr = api->godot_string_utf8(&str);
+			int length = api->godot_char_string_length(&cstr);
+			const char * val = api->godot_char_string_get_data(&cstr);
+			success = length == 0 || p_write(p_port, (const uint8_t *) val, length);
+			api->godot_char_string_destroy(&cstr);
+			api->godot_string_destroy(&str);
+			break;
+		}
+		case GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY: {
+			// Shares the array's storage, nothing is copied until it reaches the OS
+			godot_pool_byte_array bytes = api->godot_variant_as_pool_byte_array(p_args[n_arg]);
+			godot_int length = api->godot_pool_byte_array_size(&bytes);
+			if (length > 0) {
+				godot_pool_byte_array_read_access *read = api->godot_pool_byte_array_read(&bytes);
+				success = p_write(p_port, api->godot_pool_byte_array_read_access_ptr(read), length);
+				api->godot_pool_byte_array_read_access_destroy(read);
+			} else {
+				success = true;
+			}
+			api->godot_pool_byte_array_destroy(&bytes);
+			break;
+		}
+		default:
+			success = false;
+		}
+
+		if (!success)
+			num_errors++;
+	}
+
+	return num_errors;
+}
+
+static bool _encode_and_write(serial_port *p_port, const uint8_t *p_data, uint32_t p_length, serial_port_write_func p_write) {
+	const uint32_t checksum_size = serial_checksum_size(p_port->checksum);
+	const uint32_t payload_length = p_length + checksum_size;
+
+	// The header has to be able to express the length
+	if (p_port->framing == SERIAL_FRAMING_LENGTH && p_port->length_size < 4 && payload_length >> (8 * p_port->length_size) != 0)
+		return false;
+
+	// One allocation: the payload with its checksum appended, then its encoding
+	uint8_t *payload = api->godot_alloc(payload_length + serial_framing_max_encoded(p_port->framing, payload_length, p_port->length_size));
+	uint8_t *frame = payload + payload_length;
+	memcpy(payload, p_data, p_length);
+	serial_checksum_append(p_port->checksum, p_data, p_length, payload + p_length);
+
+	const uint32_t length = serial_framing_encode(p_port->framing, p_port->length_size, payload, payload_length, frame);
+	const bool success = p_write(p_port, frame, length);
+	api->godot_free(payload);
+	return success;
+}
+
+bool serial_port_write_packet(serial_port *p_port, int p_num_args, godot_variant **p_args, serial_port_write_func p_write) {
+	if (p_port->framing == SERIAL_FRAMING_NONE || p_num_args < 1)
+		return false;
+
+	bool success;
+	switch (api->godot_variant_get_type(p_args[0])) {
+	case GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY: {
+		godot_pool_byte_array bytes = api->godot_variant_as_pool_byte_array(p_args[0]);
+		godot_pool_byte_array_read_access *read = api->godot_pool_byte_array_read(&bytes);
+		success = _encode_and_write(p_port, api->godot_pool_byte_array_read_access_ptr(read), api->godot_pool_byte_array_size(&bytes), p_write);
+		api->godot_pool_byte_array_read_access_destroy(read);
+		api->godot_pool_byte_array_destroy(&bytes);
+		break;
+	}
+	case GODOT_VARIANT_TYPE_STRING: {
+		godot_string str = api->godot_variant_as_string(p_args[0]);
+		godot_char_string cstr = api->godot_string_utf8(&str);
+		success = _encode_and_write(p_port, (const uint8_t *) api->godot_char_string_get_data(&cstr), api->godot_char_string_length(&cstr), p_write);
+		api->godot_char_string_destroy(&cstr);
+		api->godot_string_destroy(&str);
+		break;
+	}
+	default:
+		success = false;
+	}
+	return success;
+}
+
+// Wakes up an I/O thread waiting for room in rx, once
+static void _made_room(serial_port * port) {
+	if (serial_atomic_exchange_u32(&port->rx_paused, 0) != 0)
+		port->resume_rx(port);
+}
+
+// Every byte scripts take out of rx goes through these two, so the stats see how long it waited
+// and a paused I/O thread hears about the room
+static void _consume(serial_port * port, uint32_t p_length) {
+	ring_buffer_consume(&port->rx, p_length);
+	serial_stats_consumed(&port->stats, &port->rx);
+	_made_room(port);
+}
+
+static void _take(serial_port * port, uint8_t *r_data, uint32_t p_length) {
+	ring_buffer_read(&port->rx, r_data, p_length);
+	serial_stats_consumed(&port->stats, &port->rx);
+	_made_room(port);
+}
+
+// From transact() or modbus_poll() until its signal has handed the response over, the I/O thread
+// finds the response by its position in rx, so scripts reading then get nothing, as if rx were empty
+static inline bool _rx_reserved(serial_port * port) {
+	return serial_atomic_load_u32(&port->transaction_state) != SERIAL_TRANSACTION_IDLE;
+}
+
+// Without an I/O thread, pulls from the OS only when fewer than p_wanted bytes are buffered
+static uint32_t _available_for_read(serial_port * port, uint32_t p_wanted) {
+	uint32_t available = ring_buffer_available(&port->rx);
+	if (available < p_wanted && port->is_open && !port->threaded) {
+		port->pump(port);
+		available = ring_buffer_available(&port->rx);
+	}
+	return available;
+}
+
+GDCALLINGCONV godot_variant serial_port_available_for_read(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	// Counting the reserved bytes would keep a read loop spinning on reads that return nothing,
+	// and never let the dispatch that releases them run
+	api->godot_variant_new_int(&ret, _rx_reserved(port) ? 0 : ring_buffer_available(&port->rx));
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_port_peek(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	int val;
+	serial_port * port = (serial_port *) p_user_data;
+
+	const uint8_t *data;
+	if (!_rx_reserved(port) && _available_for_read(port, 1) > 0 && ring_buffer_read_region(&port->rx, &data) > 0)
+		val = data[0];
+	else
+		val = -1;
+
+	api->godot_variant_new_int(&ret, val);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_port_read(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	int val;
+	serial_port * port = (serial_port *) p_user_data;
+
+	const uint8_t *data;
+	if (!_rx_reserved(port) && _available_for_read(port, 1) > 0 && ring_buffer_read_region(&port->rx, &data) > 0) {
+		val = data[0];
+		_consume(port, 1);
+	} else
+		val = -1;
+
+	api->godot_variant_new_int(&ret, val);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_port_read_string(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	// Only goes to the OS when there is nothing buffered, or for the rest of a character cut short
+	uint32_t available = _rx_reserved(port) ? 0 : _available_for_read(port, 1);
+	if (available == 0) {
+		api->godot_variant_new_nil(&ret);
+		return ret;
+	}
+
+	const uint8_t *data;
+	char *str = NULL;
+	uint32_t complete;
+	for (bool pumped = false;; pumped = true) {
+		// Parse in place unless the pending bytes wrap around the end of storage
+		if (ring_buffer_read_region(&port->rx, &data) < available) {
+			str = api->godot_alloc(available);
+			ring_buffer_peek(&port->rx, (uint8_t *) str, available);
+			data = (const uint8_t *) str;
+		}
+		complete = serial_utf8_complete_length(data, available);
+
+		const uint32_t pulled = complete < available && !pumped ? _available_for_read(port, available + 1) : available;
+		if (pulled == available)
+			break;
+		if (str != NULL)
+			api->godot_free(str);
+		str = NULL;
+		available = pulled;
+	}
+
+	// A character cut short by the end of the buffer stays there until the rest of it arrives.
+	// Malformed bytes in front could never parse, so they are dropped instead of blocking the stream.
+	uint32_t skipped = 0;
+	uint32_t valid = 0;
+	while (skipped < complete && (valid = serial_utf8_valid_length(data + skipped, complete - skipped)) == 0)
+		skipped++;
+
+	if (valid == 0) {
+		api->godot_variant_new_nil(&ret);
+	} else {
+		godot_string string;
+		api->godot_string_new(&string);
+		api->godot_string_parse_utf8_with_len(&string, (const char *) data + skipped, valid);
+		api->godot_variant_new_string(&ret, &string);
+		api->godot_string_destroy(&string);
+	}
+	_consume(port, skipped + valid);
+
+	if (str != NULL)
+		api->godot_free(str);
+
+	return ret;
+}
+
+// Copies up to p_max bytes (all of them if negative) straight from rx into a PoolByteArray
+static void _read_bytes(serial_port * port, int64_t p_max, godot_variant *r_ret) {
+	const uint32_t available = _available_for_read(port, p_max < 0 || p_max > UINT32_MAX ? UINT32_MAX : (uint32_t) p_max);
+	const uint32_t length = p_max < 0 || p_max > available ? available : (uint32_t) p_max;
+
+	godot_pool_byte_array bytes;
+	api->godot_pool_byte_array_new(&bytes);
+	if (length > 0) {
+		api->godot_pool_byte_array_resize(&bytes, length);
+		godot_pool_byte_array_write_access *write = api->godot_pool_byte_array_write(&bytes);
+		_take(port, api->godot_pool_byte_array_write_access_ptr(write), length);
+		api->godot_pool_byte_array_write_access_destroy(write);
+	}
+
+	api->godot_variant_new_pool_byte_array(r_ret, &bytes);
+	api->godot_pool_byte_array_destroy(&bytes);
+}
+
+GDCALLINGCONV godot_variant serial_port_read_bytes(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	if (p_num_args > 0 && api->godot_variant_get_type(p_args[0]) != GODOT_VARIANT_TYPE_INT) {
+		api->godot_variant_new_nil(&ret);
+		return ret;
+	}
+
+	_read_bytes(port, _rx_reserved(port) ? 0 : p_num_args > 0 ? api->godot_variant_as_int(p_args[0]) : -1, &ret);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_port_read_all(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	_read_bytes(port, _rx_reserved(port) ? 0 : -1, &ret);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_port_get_overflow_count(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	api->godot_variant_new_int(&ret, serial_atomic_load_u64(&port->overflow));
+	return ret;
+}
+
+static void _set_stat(godot_dictionary *p_stats, const char *p_key, const godot_variant *p_value) {
+	godot_string key;
+	godot_variant key_variant;
+	api->godot_string_new(&key);
+	api->godot_string_parse_utf8(&key, p_key);
+	api->godot_variant_new_string(&key_variant, &key);
+	api->godot_dictionary_set(p_stats, &key_variant, p_value);
+	api->godot_variant_destroy(&key_variant);
+	api->godot_string_destroy(&key);
+}
+
+static void _set_count(godot_dictionary *p_stats, const char *p_key, uint64_t p_count) {
+	godot_variant value;
+	api->godot_variant_new_int(&value, (int64_t) p_count);
+	_set_stat(p_stats, p_key, &value);
+	api->godot_variant_destroy(&value);
+}
+
+void serial_port_get_stats(serial_port *p_port, const serial_line_errors *p_line_errors, godot_variant *r_ret) {
+	serial_stats *stats = &p_port->stats;
+	godot_dictionary dict;
+	api->godot_dictionary_new(&dict);
+
+	_set_count(&dict, "bytes_in", serial_atomic_load_u64(&stats->bytes_in));
+	_set_count(&dict, "bytes_out", serial_atomic_load_u64(&stats->bytes_out));
+	_set_count(&dict, "reads", serial_atomic_load_u64(&stats->reads));
+	_set_count(&dict, "writes", serial_atomic_load_u64(&stats->writes));
+	_set_count(&dict, "overflow", serial_atomic_load_u64(&p_port->overflow));
+	_set_count(&dict, "rejected_frames", p_port->rejected_frames);
+	_set_count(&dict, "max_rx_pending", serial_atomic_load_u32(&stats->max_rx_pending));
+	_set_count(&dict, "max_tx_pending", serial_atomic_load_u32(&stats->max_tx_pending));
+
+	if (p_line_errors != NULL) {
+		_set_count(&dict, "frame_errors", p_line_errors->frame_errors);
+		_set_count(&dict, "parity_errors", p_line_errors->parity_errors);
+		_set_count(&dict, "overruns", p_line_errors->overruns);
+		_set_count(&dict, "breaks", p_line_errors->breaks);
+	}
+
+	godot_array latency;
+	godot_variant value;
+	api->godot_array_new(&latency);
+	api->godot_array_resize(&latency, SERIAL_STATS_LATENCY_BUCKETS);
+	for (int i = 0; i < SERIAL_STATS_LATENCY_BUCKETS; i++) {
+		api->godot_variant_new_int(&value, (int64_t) serial_atomic_load_u64(&stats->read_latency[i]));
+		api->godot_array_set(&latency, i, &value);
+		api->godot_variant_destroy(&value);
+	}
+	api->godot_variant_new_array(&value, &latency);
+	_set_stat(&dict, "read_latency_usec", &value);
+	api->godot_variant_destroy(&value);
+	api->godot_array_destroy(&latency);
+
+	api->godot_variant_new_dictionary(r_ret, &dict);
+	api->godot_dictionary_destroy(&dict);
+}
+
+// Up to p_max pending bytes (all of them if negative) as an Array with one Dictionary per chunk
+// the producer buffered at once: "bytes", "time_usec" when its first byte was buffered, on the
+// serial_time_usec() clock, and "age_usec" how long ago that was. The first chunk may have been
+// partly read already, and the last one may be cut at p_max, with the rest left for the next call.
+static void _read_chunks(serial_port * port, int64_t p_max, godot_variant *r_ret) {
+	const uint32_t available = _available_for_read(port, p_max < 0 || p_max > UINT32_MAX ? UINT32_MAX : (uint32_t) p_max);
+	uint32_t left = p_max < 0 || p_max > available ? available : (uint32_t) p_max;
+	const int64_t now = serial_time_usec();
+
+	godot_array chunks;
+	api->godot_array_new(&chunks);
+	while (left > 0) {
+		// Taking a chunk in full pops its stamp, so the next one is always the oldest.
+		// Bytes past the last stamp were buffered while the stamps were full, and just now at the latest.
+		serial_stats_stamp stamp;
+		uint32_t length = left;
+		int64_t usec = now;
+		if (serial_stats_oldest_stamp(&port->stats, &stamp)) {
+			const uint32_t pending = stamp.end - port->rx.tail;
+			if (pending > 0 && pending < length)
+				length = pending;
+			usec = stamp.usec;
+		}
+
+		godot_pool_byte_array bytes;
+		api->godot_pool_byte_array_new(&bytes);
+		api->godot_pool_byte_array_resize(&bytes, length);
+		godot_pool_byte_array_write_access *write = api->godot_pool_byte_array_write(&bytes);
+		_take(port, api->godot_pool_byte_array_write_access_ptr(write), length);
+		api->godot_pool_byte_array_write_access_destroy(write);
+		left -= length;
+
+		godot_dictionary chunk;
+		godot_variant value;
+		api->godot_dictionary_new(&chunk);
+		api->godot_variant_new_pool_byte_array(&value, &bytes);
+		_set_stat(&chunk, "bytes", &value);
+		api->godot_variant_destroy(&value);
+		api->godot_pool_byte_array_destroy(&bytes);
+		_set_count(&chunk, "time_usec", (uint64_t) usec);
+		_set_count(&chunk, "age_usec", (uint64_t) (now > usec ? now - usec : 0));
+
+		api->godot_variant_new_dictionary(&value, &chunk);
+		api->godot_array_append(&chunks, &value);
+		api->godot_variant_destroy(&value);
+		api->godot_dictionary_destroy(&chunk);
+	}
+
+	api->godot_variant_new_array(r_ret, &chunks);
+	api->godot_array_destroy(&chunks);
+}
+
+GDCALLINGCONV godot_variant serial_port_read_with_timestamps(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	if (p_num_args > 0 && api->godot_variant_get_type(p_args[0]) != GODOT_VARIANT_TYPE_INT) {
+		api->godot_variant_new_nil(&ret);
+		return ret;
+	}
+
+	_read_chunks(port, _rx_reserved(port) ? 0 : p_num_args > 0 ? api->godot_variant_as_int(p_args[0]) : -1, &ret);
+	return ret;
+}
+
+// Length of the first pending frame ending with p_delimiter, delimiter included, or -1 while it is incomplete
+static int64_t _find_frame(serial_port * port, const uint8_t *p_delimiter, uint32_t p_length) {
+	ring_buffer *rx = &port->rx;
+	const uint32_t available = ring_buffer_available(rx);
+	uint32_t from = 0;
+
+	if (port->scan_tail == rx->tail && port->scan_delimiter_length == p_length && memcmp(port->scan_delimiter, p_delimiter, p_length) == 0)
+		from = port->scan_end;
+
+	// Every match ends with the last delimiter byte: scan for that one, then compare what precedes it
+	int64_t end;
+	while ((end = ring_buffer_find(rx, p_delimiter[p_length - 1], from)) >= 0) {
+		from = end + 1;
+		if (end + 1 < p_length)
+			continue;
+		uint32_t matched = 1;
+		while (matched < p_length && ring_buffer_at(rx, end - matched) == p_delimiter[p_length - 1 - matched])
+			matched++;
+		if (matched == p_length)
+			return end + 1;
+	}
+
+	port->scan_tail = rx->tail;
+	port->scan_end = from > available ? from : available;
+	memcpy(port->scan_delimiter, p_delimiter, p_length);
+	port->scan_delimiter_length = p_length;
+	return -1;
+}
+
+// Consumes p_consumed bytes, returning the first p_length of them as a String
+static void _consume_string(serial_port * port, uint32_t p_length, uint32_t p_consumed, bool p_strip_cr, godot_variant *r_ret) {
+	// Parse in place unless the frame wraps around the end of storage
+	const uint8_t *data;
+	char *str = NULL;
+	if (ring_buffer_read_region(&port->rx, &data) < p_length) {
+		str = api->godot_alloc(p_length);
+		ring_buffer_peek(&port->rx, (uint8_t *) str, p_length);
+		data = (const uint8_t *) str;
+	}
+
+	if (p_strip_cr && p_length > 0 && data[p_length - 1] == '\r')
+		p_length--;
+
+	godot_string string;
+	api->godot_string_new(&string);
+	api->godot_string_parse_utf8_with_len(&string, (const char *) data, p_length);
+	api->godot_variant_new_string(r_ret, &string);
+	api->godot_string_destroy(&string);
+
+	if (str != NULL)
+		api->godot_free(str);
+	_consume(port, p_consumed);
+}
+
+// Takes the next complete frame out of rx, without its delimiter. A frame
+// longer than the whole buffer could never complete, so a full buffer
+// without a delimiter is returned as is rather than stalling reception.
+static bool _read_frame(serial_port * port, const uint8_t *p_delimiter, uint32_t p_length, bool p_strip_cr, godot_variant *r_ret) {
+	int64_t frame = _find_frame(port, p_delimiter, p_length);
+	if (frame < 0 && port->is_open && !port->threaded && port->pump(port) > 0)
+		frame = _find_frame(port, p_delimiter, p_length);
+
+	if (frame >= 0) {
+		_consume_string(port, frame - p_length, frame, p_strip_cr, r_ret);
+		return true;
+	}
+
+	const uint32_t available = ring_buffer_available(&port->rx);
+	if (available > 0 && available == ring_buffer_capacity(&port->rx)) {
+		_consume_string(port, available, available, false, r_ret);
+		return true;
+	}
+	return false;
+}
+
+GDCALLINGCONV godot_variant serial_port_read_line(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	// LF or CRLF terminated
+	if (_rx_reserved(port) || !_read_frame(port, (const uint8_t *) "\n", 1, true, &ret))
+		api->godot_variant_new_nil(&ret);
+	return ret;
+}
+
+// Reads a String (as UTF-8) or PoolByteArray delimiter into r_delimiter, returning its length,
+// or -1 if it is of another type or does not fit
+static int64_t _get_delimiter(const godot_variant *p_value, uint8_t *r_delimiter) {
+	int64_t length = -1;
+	switch (api->godot_variant_get_type(p_value)) {
+	case GODOT_VARIANT_TYPE_STRING: {
+		godot_string str = api->godot_variant_as_string(p_value);
+		godot_char_string cstr = api->godot_string_utf8(&str);
+		length = api->godot_char_string_length(&cstr);
+		if (length <= SERIAL_PORT_MAX_DELIMITER)
+			memcpy(r_delimiter, api->godot_char_string_get_data(&cstr), length);
+		api->godot_char_string_destroy(&cstr);
+		api->godot_string_destroy(&str);
+		break;
+	}
+	case GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY: {
+		godot_pool_byte_array bytes = api->godot_variant_as_pool_byte_array(p_value);
+		length = api->godot_pool_byte_array_size(&bytes);
+		if (length > 0 && length <= SERIAL_PORT_MAX_DELIMITER) {
+			godot_pool_byte_array_read_access *read = api->godot_pool_byte_array_read(&bytes);
+			memcpy(r_delimiter, api->godot_pool_byte_array_read_access_ptr(read), length);
+			api->godot_pool_byte_array_read_access_destroy(read);
+		}
+		api->godot_pool_byte_array_destroy(&bytes);
+		break;
+	}
+	default:
+		break;
+	}
+	return length > SERIAL_PORT_MAX_DELIMITER ? -1 : length;
+}
+
+GDCALLINGCONV godot_variant serial_port_read_until(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+	uint8_t delimiter[SERIAL_PORT_MAX_DELIMITER];
+	int64_t length = 0;
+
+	// The delimiter is a byte value, a String (as UTF-8) or a PoolByteArray
+	if (p_num_args > 0) {
+		if (api->godot_variant_get_type(p_args[0]) == GODOT_VARIANT_TYPE_INT) {
+			const int64_t val = api->godot_variant_as_int(p_args[0]);
+			if (val >= 0 && val <= 0xff) {
+				delimiter[0] = (uint8_t) val;
+				length = 1;
+			}
+		} else {
+			length = _get_delimiter(p_args[0], delimiter);
+		}
+	}
+
+	if (length <= 0 || length > SERIAL_PORT_MAX_DELIMITER || _rx_reserved(port) || !_read_frame(port, delimiter, length, false, &ret))
+		api->godot_variant_new_nil(&ret);
+	return ret;
+}
+
+// Locates the next packet among the pending bytes: r_length encoded bytes after a
+// header of r_offset, r_consumed bytes in all. Returns false while it is incomplete.
+static bool _find_packet(serial_port * port, uint32_t *r_offset, uint32_t *r_length, uint32_t *r_consumed) {
+	ring_buffer *rx = &port->rx;
+
+	if (port->framing == SERIAL_FRAMING_LENGTH) {
+		for (;;) {
+			const uint32_t available = ring_buffer_available(rx);
+			if (available < port->length_size)
+				return false;
+
+			uint32_t length = 0;
+			for (uint32_t i = 0; i < port->length_size; i++)
+				length |= (uint32_t) ring_buffer_at(rx, i) << (8 * i);
+
+			if (length <= ring_buffer_capacity(rx) - port->length_size) {
+				if (available - port->length_size < length)
+					return false;
+				*r_offset = port->length_size;
+				*r_length = length;
+				*r_consumed = port->length_size + length;
+				return true;
+			}
+			// Could never fit in the buffer: not a real header, so slide forward to resynchronise
+			_consume(port, 1);
+		}
+	}
+
+	const uint8_t delimiter = port->framing == SERIAL_FRAMING_COBS ? SERIAL_FRAMING_COBS_DELIMITER : SERIAL_FRAMING_SLIP_END;
+	const int64_t end = _find_frame(port, &delimiter, 1);
+	if (end < 0) {
+		// A full buffer without a delimiter can only be noise
+		const uint32_t available = ring_buffer_available(rx);
+		if (available == ring_buffer_capacity(rx))
+			_consume(port, available);
+		return false;
+	}
+	*r_offset = 0;
+	*r_length = end - 1;
+	*r_consumed = end;
+	return true;
+}
+
+// Takes the next well-formed packet out of rx as a PoolByteArray, dropping malformed ones on the way
+static bool _read_packet(serial_port * port, godot_variant *r_ret) {
+	uint32_t offset, length, consumed;
+	bool found = _find_packet(port, &offset, &length, &consumed);
+	if (!found && port->is_open && !port->threaded && port->pump(port) > 0)
+		found = _find_packet(port, &offset, &length, &consumed);
+
+	for (; found; found = _find_packet(port, &offset, &length, &consumed)) {
+		// Back-to-back SLIP END bytes delimit nothing
+		if (length == 0 && port->framing != SERIAL_FRAMING_LENGTH) {
+			_consume(port, consumed);
+			continue;
+		}
+
+		godot_pool_byte_array bytes;
+		api->godot_pool_byte_array_new(&bytes);
+		api->godot_pool_byte_array_resize(&bytes, length);
+
+		// Copy the frame out once, then decode it in place
+		godot_pool_byte_array_write_access *write = api->godot_pool_byte_array_write(&bytes);
+		uint8_t *data = api->godot_pool_byte_array_write_access_ptr(write);
+		_consume(port, offset);
+		_take(port, data, length);
+		_consume(port, consumed - offset - length);
+		uint32_t decoded;
+		const bool valid = serial_framing_decode(port->framing, data, length, &decoded) && serial_checksum_verify(port->checksum, data, decoded);
+		api->godot_pool_byte_array_write_access_destroy(write);
+
+		if (valid) {
+			decoded -= serial_checksum_size(port->checksum);
+			if (decoded != length)
+				api->godot_pool_byte_array_resize(&bytes, decoded);
+			api->godot_variant_new_pool_byte_array(r_ret, &bytes);
+		} else {
+			port->rejected_frames++;
+		}
+		api->godot_pool_byte_array_destroy(&bytes);
+		if (valid)
+			return true;
+	}
+	return false;
+}
+
+GDCALLINGCONV godot_variant serial_port_read_packet(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	if (port->framing == SERIAL_FRAMING_NONE || _rx_reserved(port) || !_read_packet(port, &ret))
+		api->godot_variant_new_nil(&ret);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_port_get_rejected_frames(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	api->godot_variant_new_int(&ret, port->rejected_frames);
+	return ret;
+}
+
+// Compiles p_format unless it is the one the previous call used
+static const serial_struct_format *_get_unpack_format(serial_port * port, const godot_string *p_format) {
+	if (port->unpack_compiled && api->godot_string_operator_equal(&port->unpack_source, p_format))
+		return &port->unpack_format;
+
+	godot_char_string format = api->godot_string_ascii(p_format);
+	const bool valid = serial_struct_compile(api->godot_char_string_get_data(&format), &port->unpack_format);
+	api->godot_char_string_destroy(&format);
+
+	port->unpack_compiled = valid;
+	if (!valid) {
+		fprintf(stderr, "Serial: invalid unpack format\n");
+		return NULL;
+	}
+	api->godot_string_destroy(&port->unpack_source);
+	api->godot_string_new_copy(&port->unpack_source, p_format);
+	return &port->unpack_format;
+}
+
+// Decodes p_num_records records into the flattest container able to hold them
+static void _unpack_records(const serial_struct_format *p_format, const uint8_t *p_data, uint32_t p_num_records, godot_variant *r_ret) {
+	const uint32_t num_values = p_num_records * p_format->num_fields;
+
+	if (p_format->output == SERIAL_STRUCT_OUTPUT_INTS) {
+		godot_pool_int_array values;
+		api->godot_pool_int_array_new(&values);
+		api->godot_pool_int_array_resize(&values, num_values);
+		godot_pool_int_array_write_access *write = api->godot_pool_int_array_write(&values);
+		serial_struct_decode_ints(p_format, p_data, p_num_records, api->godot_pool_int_array_write_access_ptr(write));
+		api->godot_pool_int_array_write_access_destroy(write);
+		api->godot_variant_new_pool_int_array(r_ret, &values);
+		api->godot_pool_int_array_destroy(&values);
+	} else if (p_format->output == SERIAL_STRUCT_OUTPUT_REALS) {
+		godot_pool_real_array values;
+		api->godot_pool_real_array_new(&values);
+		api->godot_pool_real_array_resize(&values, num_values);
+		godot_pool_real_array_write_access *write = api->godot_pool_real_array_write(&values);
+		serial_struct_decode_reals(p_format, p_data, p_num_records, api->godot_pool_real_array_write_access_ptr(write));
+		api->godot_pool_real_array_write_access_destroy(write);
+		api->godot_variant_new_pool_real_array(r_ret, &values);
+		api->godot_pool_real_array_destroy(&values);
+	} else {
+		godot_array records;
+		api->godot_array_new(&records);
+		api->godot_array_resize(&records, p_num_records);
+		for (uint32_t r = 0; r < p_num_records; r++, p_data += p_format->record_size) {
+			godot_array record;
+			api->godot_array_new(&record);
+			api->godot_array_resize(&record, p_format->num_fields);
+			for (uint32_t f = 0; f < p_format->num_fields; f++) {
+				const serial_struct_field *field = &p_format->fields[f];
+				godot_variant value;
+				if (serial_struct_is_real(field))
+					api->godot_variant_new_real(&value, serial_struct_get_real(p_format, field, p_data));
+				else
+					api->godot_variant_new_int(&value, serial_struct_get_int(p_format, field, p_data));
+				api->godot_array_set(&record, f, &value);
+				api->godot_variant_destroy(&value);
+			}
+
+			godot_variant item;
+			api->godot_variant_new_array(&item, &record);
+			api->godot_array_set(&records, r, &item);
+			api->godot_variant_destroy(&item);
+			api->godot_array_destroy(&record);
+		}
+		api->godot_variant_new_array(r_ret, &records);
+		api->godot_array_destroy(&records);
+	}
+}
+
+GDCALLINGCONV godot_variant serial_port_unpack(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	if (p_num_args < 1 || api->godot_variant_get_type(p_args[0]) != GODOT_VARIANT_TYPE_STRING
+			|| (p_num_args > 1 && api->godot_variant_get_type(p_args[1]) != GODOT_VARIANT_TYPE_INT)) {
+		api->godot_variant_new_nil(&ret);
+		return ret;
+	}
+
+	godot_string source = api->godot_variant_as_string(p_args[0]);
+	const serial_struct_format *format = _get_unpack_format(port, &source);
+	api->godot_string_destroy(&source);
+	if (format == NULL) {
+		api->godot_variant_new_nil(&ret);
+		return ret;
+	}
+
+	// Whole records only, at most the requested count; the remainder waits for the rest of its bytes
+	const int64_t max_records = p_num_args > 1 ? api->godot_variant_as_int(p_args[1]) : -1;
+	const uint64_t wanted = max_records < 0 ? UINT32_MAX : (uint64_t) max_records * format->record_size;
+	uint32_t num_records = _rx_reserved(port) ? 0 : _available_for_read(port, wanted > UINT32_MAX ? UINT32_MAX : (uint32_t) wanted) / format->record_size;
+	if (max_records >= 0 && num_records > max_records)
+		num_records = (uint32_t) max_records;
+	const uint32_t length = num_records * format->record_size;
+
+	// Decode in place unless the records wrap around the end of storage
+	const uint8_t *data;
+	uint8_t *copy = NULL;
+	if (ring_buffer_read_region(&port->rx, &data) < length) {
+		copy = api->godot_alloc(length);
+		ring_buffer_peek(&port->rx, copy, length);
+		data = copy;
+	}
+
+	_unpack_records(format, data, num_records, &ret);
+	_consume(port, length);
+
+	if (copy != NULL)
+		api->godot_free(copy);
+
+	return ret;
+}
+
+bool serial_port_transact(serial_port *p_port, int p_num_args, godot_variant **p_args, serial_port_write_func p_write) {
+	if (p_num_args < 3 || !p_port->is_open || !p_port->threaded) {
+		if (p_port->is_open && !p_port->threaded)
+			fprintf(stderr, "transact() needs a port opened with \"threaded\"\n");
+		return false;
+	}
+	if (serial_atomic_load_u32(&p_port->transaction_state) != SERIAL_TRANSACTION_IDLE)
+		return false;
+
+	// The response is either a length or ends with a terminator, like read_until() takes it
+	uint32_t terminator_length = 0;
+	uint32_t length = 0;
+	if (api->godot_variant_get_type(p_args[1]) == GODOT_VARIANT_TYPE_INT) {
+		const int64_t val = api->godot_variant_as_int(p_args[1]);
+		if (val <= 0 || val > ring_buffer_capacity(&p_port->rx))
+			return false;
+		length = (uint32_t) val;
+	} else {
+		const int64_t val = _get_delimiter(p_args[1], p_port->transaction_terminator);
+		if (val <= 0)
+			return false;
+		terminator_length = (uint32_t) val;
+	}
+
+	if (api->godot_variant_get_type(p_args[2]) != GODOT_VARIANT_TYPE_INT || api->godot_variant_as_int(p_args[2]) <= 0)
+		return false;
+	const int64_t timeout_ms = api->godot_variant_as_int(p_args[2]);
+
+	// Whatever came before the request cannot be part of its response
+	_consume(p_port, ring_buffer_available(&p_port->rx));
+
+	p_port->transaction_terminator_length = terminator_length;
+	p_port->transaction_length = length;
+	p_port->transaction_scanned = 0;
+	p_port->transaction_deadline = serial_time_usec() + timeout_ms * 1000;
+	serial_atomic_store_u32(&p_port->transaction_state, SERIAL_TRANSACTION_WAITING);
+
+	// A request that cannot be queued is never answered; it ends at the deadline like one that is not
+	serial_port_write_args(p_port, 1, p_args, p_write);
+	return true;
+}
+
+static bool _get_modbus_field(const godot_dictionary *p_request, const char *p_key, int64_t p_default, int64_t p_max, int64_t *r_value) {
+	godot_variant value;
+	if (!_get_option(p_request, p_key, &value)) {
+		*r_value = p_default;
+		return p_default >= 0;
+	}
+	bool valid = api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_INT;
+	*r_value = valid ? api->godot_variant_as_int(&value) : -1;
+	api->godot_variant_destroy(&value);
+	return valid && *r_value >= 0 && *r_value <= p_max;
+}
+
+// Encodes one Dictionary of modbus_poll(): "slave", "function" (default 3, read holding registers),
+// "address" (default 0), then "count" for reads or "values" for writes
+static bool _get_modbus_request(const godot_variant *p_value, serial_modbus_request *r_request) {
+	if (api->godot_variant_get_type(p_value) != GODOT_VARIANT_TYPE_DICTIONARY)
+		return false;
+
+	godot_dictionary request = api->godot_variant_as_dictionary(p_value);
+	int64_t slave, function, address, count = 0;
+	bool valid = _get_modbus_field(&request, "slave", -1, 255, &slave)
+			&& _get_modbus_field(&request, "function", SERIAL_MODBUS_READ_HOLDING_REGISTERS, 255, &function)
+			&& _get_modbus_field(&request, "address", 0, 0xffff, &address);
+
+	uint16_t values[SERIAL_MODBUS_MAX_WRITE_BITS];
+	godot_variant value;
+	if (valid && _get_option(&request, "values", &value)) {
+		godot_array array = api->godot_variant_as_array(&value);
+		count = api->godot_array_size(&array);
+		valid = count <= SERIAL_MODBUS_MAX_WRITE_BITS;
+		for (int64_t i = 0; i < count && valid; i++) {
+			godot_variant item = api->godot_array_get(&array, i);
+			if (api->godot_variant_get_type(&item) == GODOT_VARIANT_TYPE_INT)
+				values[i] = (uint16_t) api->godot_variant_as_int(&item);
+			else if (api->godot_variant_get_type(&item) == GODOT_VARIANT_TYPE_BOOL)
+				values[i] = api->godot_variant_as_bool(&item);
+			else
+				valid = false;
+			api->godot_variant_destroy(&item);
+		}
+		api->godot_array_destroy(&array);
+		api->godot_variant_destroy(&value);
+	} else if (valid) {
+		valid = _get_modbus_field(&request, "count", 1, SERIAL_MODBUS_MAX_READ_BITS, &count);
+	}
+
+	api->godot_dictionary_destroy(&request);
+	return valid && serial_modbus_encode(r_request, (uint8_t) slave, (uint8_t) function, (uint16_t) address, (uint16_t) count, values);
+}
+
+bool serial_port_modbus_poll(serial_port *p_port, int p_num_args, godot_variant **p_args) {
+	if (p_num_args < 2 || !p_port->is_open || !p_port->threaded) {
+		if (p_port->is_open && !p_port->threaded)
+			fprintf(stderr, "modbus_poll() needs a port opened with \"threaded\"\n");
+		return false;
+	}
+	if (serial_atomic_load_u32(&p_port->transaction_state) != SERIAL_TRANSACTION_IDLE)
+		return false;
+	if (api->godot_variant_get_type(p_args[0]) != GODOT_VARIANT_TYPE_ARRAY)
+		return false;
+	if (api->godot_variant_get_type(p_args[1]) != GODOT_VARIANT_TYPE_INT || api->godot_variant_as_int(p_args[1]) <= 0)
+		return false;
+	const int64_t timeout_ms = api->godot_variant_as_int(p_args[1]);
+
+	godot_array list = api->godot_variant_as_array(p_args[0]);
+	const uint32_t num_requests = api->godot_array_size(&list);
+	serial_modbus_request *requests = num_requests > 0 ? api->godot_alloc(num_requests * sizeof(serial_modbus_request)) : NULL;
+	bool valid = requests != NULL;
+	// Every response stays in rx until the results are reported
+	uint64_t response_space = 0;
+	for (uint32_t i = 0; i < num_requests && valid; i++) {
+		godot_variant request = api->godot_array_get(&list, i);
+		valid = _get_modbus_request(&request, &requests[i]);
+		if (valid)
+			response_space += requests[i].response_length;
+		api->godot_variant_destroy(&request);
+	}
+	api->godot_array_destroy(&list);
+
+	if (valid && response_space > ring_buffer_capacity(&p_port->rx)) {
+		fprintf(stderr, "modbus_poll() needs a \"buffer_size\" of at least %u bytes for these requests\n", (uint32_t) response_space);
+		valid = false;
+	}
+	if (!valid) {
+		if (requests != NULL)
+			api->godot_free(requests);
+		return false;
+	}
+
+	// Whatever came before the first request cannot be part of its response
+	_consume(p_port, ring_buffer_available(&p_port->rx));
+
+	// Even the first request is the I/O thread's to send, after the silence every frame needs
+	// in front of it, so tx has a single producer from here on
+	p_port->modbus_requests = requests;
+	p_port->modbus_num_requests = num_requests;
+	p_port->modbus_current = 0;
+	p_port->modbus_sending = true;
+	p_port->modbus_silence_usec = serial_modbus_silence_usec(p_port->baudrate, p_port->config);
+	p_port->modbus_timeout_usec = timeout_ms * 1000;
+	p_port->modbus_seen = 0;
+	p_port->modbus_last_rx = 0;
+	p_port->transaction_deadline = serial_time_usec() + p_port->modbus_silence_usec;
+	serial_atomic_store_u32(&p_port->transaction_state, SERIAL_TRANSACTION_WAITING);
+	return true;
+}
+
+int64_t serial_port_transaction_deadline(serial_port *p_port) {
+	if (serial_atomic_load_u32(&p_port->transaction_state) != SERIAL_TRANSACTION_WAITING)
+		return -1;
+
+	// A response that went quiet for the silent interval is over
+	if (p_port->modbus_requests != NULL && !p_port->modbus_sending && p_port->modbus_seen > 0) {
+		const int64_t gap_end = p_port->modbus_last_rx + p_port->modbus_silence_usec;
+		if (gap_end < p_port->transaction_deadline)
+			return gap_end;
+	}
+	return p_port->transaction_deadline;
+}
+
+// Sends the next request once the silence before it is over, and ends the response to the one
+// sent last when it went quiet or timed out
+static bool _expire_modbus(serial_port *p_port) {
+	if (_check_modbus(p_port))
+		return true;
+
+	const int64_t now = serial_time_usec();
+	if (now < serial_port_transaction_deadline(p_port))
+		return false;
+
+	if (p_port->modbus_sending) {
+		serial_modbus_request *request = &p_port->modbus_requests[p_port->modbus_current];
+		// Whatever came during the silence cannot be part of the response
+		request->response_offset = ring_buffer_available(&p_port->rx);
+		p_port->modbus_sending = false;
+		p_port->modbus_seen = 0;
+		p_port->transaction_deadline = now + p_port->modbus_timeout_usec;
+		// A request that cannot be queued is never answered; it times out like one that is not
+		_enqueue(p_port, request->frame, request->frame_length);
+		return false;
+	}
+	return _next_modbus_request(p_port, p_port->modbus_seen);
+}
+
+void serial_port_expire_transaction(serial_port *p_port) {
+	if (serial_atomic_load_u32(&p_port->transaction_state) != SERIAL_TRANSACTION_WAITING)
+		return;
+	if (p_port->modbus_requests != NULL) {
+		if (_expire_modbus(p_port))
+			_end_transaction(p_port);
+		return;
+	}
+	if (serial_time_usec() < p_port->transaction_deadline)
+		return;
+
+	if (!_check_transaction(p_port))
+		p_port->transaction_length = 0;
+	_end_transaction(p_port);
+}
+
+// record(path) writes every byte received or sent from now on to a new capture file at path,
+// in place of the one being written if any, until record() or record("") stops it. Recording
+// goes on across close() and open(). Returns whether the file could be created.
+GDCALLINGCONV godot_variant serial_port_record(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+	bool result = true;
+
+	godot_string path;
+	if (p_num_args > 0 && api->godot_variant_get_type(p_args[0]) == GODOT_VARIANT_TYPE_STRING)
+		path = api->godot_variant_as_string(p_args[0]);
+	else
+		api->godot_string_new(&path);
+
+	if (api->godot_string_length(&path) > 0) {
+		godot_char_string path_utf8 = api->godot_string_utf8(&path);
+		serial_log_writer log;
+		result = serial_log_create(&log, api->godot_char_string_get_data(&path_utf8));
+		if (result)
+			_replace_log(port, &log);
+		api->godot_char_string_destroy(&path_utf8);
+	} else {
+		_replace_log(port, NULL);
+	}
+	api->godot_string_destroy(&path);
+
+	api->godot_variant_new_bool(&ret, result);
+	return ret;
+}
+
+// Takes the responses of a finished modbus_poll() out of rx: an Array with, for each request, a
+// PoolIntArray of what it read or what the slave confirmed it wrote, or else an int: the
+// exception code, SERIAL_MODBUS_NO_RESPONSE or SERIAL_MODBUS_BAD_RESPONSE
+static void _read_modbus_results(serial_port * port, godot_variant *r_ret) {
+	godot_array results;
+	api->godot_array_new(&results);
+
+	uint32_t end = 0;
+	uint8_t response[SERIAL_MODBUS_MAX_FRAME];
+	uint16_t values[SERIAL_MODBUS_MAX_READ_BITS];
+	for (uint32_t i = 0; i < port->modbus_num_requests; i++) {
+		const serial_modbus_request *request = &port->modbus_requests[i];
+		int status = SERIAL_MODBUS_BAD_RESPONSE;
+		uint32_t num_values = 0;
+		if (request->received <= SERIAL_MODBUS_MAX_FRAME) {
+			for (uint32_t j = 0; j < request->received; j++)
+				response[j] = ring_buffer_at(&port->rx, request->response_offset + j);
+			status = serial_modbus_decode(request, response, request->received, values, &num_values);
+		}
+		if (request->response_offset + request->received > end)
+			end = request->response_offset + request->received;
+
+		godot_variant value;
+		if (status == SERIAL_MODBUS_OK) {
+			godot_pool_int_array ints;
+			api->godot_pool_int_array_new(&ints);
+			api->godot_pool_int_array_resize(&ints, num_values);
+			godot_pool_int_array_write_access *write = api->godot_pool_int_array_write(&ints);
+			godot_int *dst = api->godot_pool_int_array_write_access_ptr(write);
+			for (uint32_t j = 0; j < num_values; j++)
+				dst[j] = values[j];
+			api->godot_pool_int_array_write_access_destroy(write);
+			api->godot_variant_new_pool_int_array(&value, &ints);
+			api->godot_pool_int_array_destroy(&ints);
+		} else {
+			api->godot_variant_new_int(&value, status);
+		}
+		api->godot_array_append(&results, &value);
+		api->godot_variant_destroy(&value);
+	}
+	_consume(port, end);
+
+	api->godot_variant_new_array(r_ret, &results);
+	api->godot_array_destroy(&results);
+}
+
+GDCALLINGCONV godot_variant serial_port_dispatch_notifications(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_port * port = (serial_port *) p_user_data;
+
+	// Data buffered from now on schedules another dispatch
+	serial_atomic_exchange_u32(&port->notify_pending, 0);
+
+	// A transaction is answered first, and owns rx for as long as it is waiting, even one
+	// started again right from transaction_completed
+	if (serial_atomic_load_u32(&port->transaction_state) == SERIAL_TRANSACTION_DONE && port->modbus_requests != NULL) {
+		godot_variant results;
+		_read_modbus_results(port, &results);
+		_free_modbus_requests(port);
+		serial_atomic_store_u32(&port->transaction_state, SERIAL_TRANSACTION_IDLE);
+		_call_named(port, _emit_signal, "modbus_completed", 1, &results);
+		api->godot_variant_destroy(&results);
+	} else if (serial_atomic_load_u32(&port->transaction_state) == SERIAL_TRANSACTION_DONE) {
+		godot_variant response;
+		_read_bytes(port, port->transaction_length, &response);
+		serial_atomic_store_u32(&port->transaction_state, SERIAL_TRANSACTION_IDLE);
+		_call_named(port, _emit_signal, "transaction_completed", 1, &response);
+		api->godot_variant_destroy(&response);
+	}
+
+	if (serial_atomic_load_u32(&port->transaction_state) == SERIAL_TRANSACTION_WAITING) {
+		// Nothing to do until the I/O thread ends it
+	} else if (port->notify == SERIAL_PORT_NOTIFY_DATA) {
+		if (ring_buffer_available(&port->rx) > 0) {
+			godot_variant bytes;
+			_read_bytes(port, -1, &bytes);
+			_call_named(port, _emit_signal, "data_received", 1, &bytes);
+			api->godot_variant_destroy(&bytes);
+		}
+	} else if (port->notify == SERIAL_PORT_NOTIFY_CHUNKS) {
+		if (ring_buffer_available(&port->rx) > 0) {
+			godot_variant chunks;
+			_read_chunks(port, -1, &chunks);
+			_call_named(port, _emit_signal, "chunks_received", 1, &chunks);
+			api->godot_variant_destroy(&chunks);
+		}
+	} else if (port->notify == SERIAL_PORT_NOTIFY_LINE) {
+		godot_variant line;
+		while (_read_frame(port, (const uint8_t *) "\n", 1, true, &line)) {
+			_call_named(port, _emit_signal, "line_received", 1, &line);
+			api->godot_variant_destroy(&line);
+		}
+	} else if (port->notify == SERIAL_PORT_NOTIFY_PACKET) {
+		godot_variant packet;
+		while (_read_packet(port, &packet)) {
+			_call_named(port, _emit_signal, "packet_received", 1, &packet);
+			api->godot_variant_destroy(&packet);
+		}
+	}
+
+	api->godot_variant_new_nil(&ret);
+	return ret;
+}
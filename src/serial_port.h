@@ -0,0 +1,358 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <gdnative_api_struct.gen.h>
+#include "serial_interface.h"
+#include "ring_buffer.h"
+#include "serial_framing.h"
+#include "serial_crc.h"
+#include "serial_struct.h"
+#include "serial_enum.h"
+#include "serial_stats.h"
+#include "serial_log.h"
+#include "serial_modbus.h"
+
+#define SERIAL_PORT_DEFAULT_BUFFER_SIZE 4096
+#define SERIAL_PORT_MAX_BUFFER_SIZE (16 * 1024 * 1024)
+#define SERIAL_PORT_MAX_DELIMITER 16
+#define SERIAL_PORT_DEFAULT_BREAK_MS 250
+#define SERIAL_PORT_FLUSH_MARGIN_MS 100
+
+typedef struct serial_port serial_port;
+struct serial_hub;
+
+typedef enum {
+	SERIAL_PORT_NOTIFY_NONE,
+	SERIAL_PORT_NOTIFY_DATA, // data_received(bytes) with everything buffered
+	SERIAL_PORT_NOTIFY_LINE, // line_received(line) once per complete line
+	SERIAL_PORT_NOTIFY_PACKET, // packet_received(packet) once per decoded packet
+	SERIAL_PORT_NOTIFY_CHUNKS, // chunks_received(chunks) with everything buffered, as read_with_timestamps() returns it
+} serial_port_notify;
+
+typedef enum {
+	SERIAL_TRANSACTION_IDLE,
+	SERIAL_TRANSACTION_WAITING, // the I/O thread watches rx for the response
+	SERIAL_TRANSACTION_DONE, // answered or timed out, transaction_completed is on its way
+} serial_transaction_state;
+
+typedef enum {
+	SERIAL_FLOW_NONE,
+	SERIAL_FLOW_RTS_CTS,  // hardware handshake: the device drops CTS to pause us, we drop RTS to pause it
+	SERIAL_FLOW_DTR_DSR,  // the same on DSR and DTR
+	SERIAL_FLOW_XON_XOFF, // XOFF (0x13) and XON (0x11) sent in band
+} serial_flow_control;
+
+// The modem control lines as a mask: the inputs first, then the outputs set_rts() and set_dtr() drive
+typedef enum {
+	SERIAL_MODEM_CTS = 0x01,
+	SERIAL_MODEM_DSR = 0x02,
+	SERIAL_MODEM_DCD = 0x04,
+	SERIAL_MODEM_RI = 0x08,
+	SERIAL_MODEM_RTS = 0x10,
+	SERIAL_MODEM_DTR = 0x20,
+} serial_modem_line;
+
+#define SERIAL_MODEM_UNKNOWN 0xFFFFFFFFu
+#define SERIAL_MODEM_INPUTS (SERIAL_MODEM_CTS | SERIAL_MODEM_DSR | SERIAL_MODEM_DCD | SERIAL_MODEM_RI)
+
+// Optional Dictionary accepted as the last argument of open():
+//   "threaded": bool - drain the port from a dedicated I/O thread (default false)
+//   "buffer_size": int - receive buffer size in bytes, rounded up to a power of two
+//                        (default SERIAL_PORT_DEFAULT_BUFFER_SIZE, at most SERIAL_PORT_MAX_BUFFER_SIZE)
+//   "write_buffer_size": int - transmit queue size of a threaded port, rounded the same way
+//   "notify": String - "data", "line", "packet" or "chunks" to have received data delivered through
+//                      signals instead of polling; implies "threaded" (default "", no signals)
+//   "framing": String - "length", "cobs" or "slip" for read_packet() and write_packet() (default "")
+//   "length_size": int - bytes in the header of "length" framing: 1, 2 or 4 (default 2)
+//   "checksum": String - "crc16_ccitt", "crc32" or "modbus" appended to every packet written
+//                        and verified on every packet read; needs "framing" (default "")
+//   "hub": SerialHub - have the hub's I/O loop service the port and report it from poll();
+//                      implies "threaded" (default null)
+//   "reconnect": bool - when the device is unplugged, reopen it with the same settings as soon as
+//                       it is back, recognised by its serial number, or by its path if it has none
+//                       (default false)
+//   "flow_control": String - "rts_cts", "dtr_dsr" or "xon_xoff" to let the device hold writes back
+//                          and be held back while rx is full, instead of bytes being dropped.
+//                          Implies "threaded", so writes queue rather than wait (default "", none)
+//   "modem_events": bool - emit modem_lines_changed(lines) as soon as CTS, DSR, DCD or RI change,
+//                          with lines as get_modem_lines() returns them; implies "threaded" (default false)
+typedef struct {
+	bool threaded;
+	uint32_t buffer_size;
+	uint32_t write_buffer_size;
+	serial_port_notify notify;
+	serial_framing framing;
+	uint32_t length_size;
+	serial_checksum checksum;
+	struct serial_hub *hub;
+	bool reconnect;
+	serial_flow_control flow_control;
+	bool modem_events;
+} serial_port_options;
+
+// Everything open() takes after the port name: a baud rate (default 19200), a config given as
+// a godot_serial_config value or as a String like "8N1" (default SERIAL_8N1), and the options
+// above; or a SerialConfig holding all three.
+typedef struct {
+	int baudrate;
+	godot_serial_config config;
+	serial_port_options options;
+	const godot_variant *options_arg; // for the options only a backend understands, NULL if none
+} serial_port_settings;
+
+// Moves whatever the OS has pending into rx without blocking.
+// Returns the number of bytes buffered, or -1 on error or full buffer.
+typedef int (*serial_port_pump_func)(serial_port *p_port);
+
+// Wakes up the I/O thread of the port
+typedef void (*serial_port_wake_func)(serial_port *p_port);
+
+// Sends p_length bytes, returning whether all of them were accepted
+typedef bool (*serial_port_write_func)(serial_port *p_port, const uint8_t *p_data, uint32_t p_length);
+
+// State shared by every backend. Backends embed it as the first member of
+// their own data_struct so the common methods below can be used directly
+// in their godot_serial_interface table.
+struct serial_port {
+	bool is_open;
+	godot_serial_config config;
+	godot_string port;
+	int timeout;
+
+	// What open() was given, to open the device again after it was unplugged
+	int baudrate;
+	serial_port_options options;
+	// The device the port was opened on, and whether it is currently unplugged
+	serial_port_info device;
+	bool lost;
+
+	// When set, a backend thread is the only producer of rx and pump is never called
+	bool threaded;
+	ring_buffer rx;
+	serial_port_pump_func pump;
+
+	// Bytes received while rx was full and therefore lost, by us or by the driver
+	volatile uint64_t overflow;
+	// An I/O thread finding rx full may stop reading instead, leaving the bytes to the driver. Set
+	// while it waits for room: the consumer clears it once it made some and wakes the thread
+	// through resume_rx.
+	volatile uint32_t rx_paused;
+	serial_port_wake_func resume_rx;
+	// RTS and DTR as set_rts() and set_dtr() last left them, put back on every reconnect
+	volatile uint32_t modem_outputs;
+	// What modem_lines_changed last announced, only touched by the thread watching the lines;
+	// SERIAL_MODEM_UNKNOWN until it first looked
+	uint32_t modem_lines;
+	// Traffic and timing since open(), for get_stats()
+	serial_stats stats;
+
+	// Transmit queue, drained by the I/O thread. Set while a wake-up is already on its way to it.
+	ring_buffer tx;
+	volatile uint32_t tx_wake_pending;
+
+	// Object the signals are emitted from
+	godot_object *instance;
+
+	// SerialHub whose I/O loop services the port, kept alive through hub_ref while the port is open.
+	// Set while the port is queued for, or reported by, the hub's poll().
+	struct serial_hub *hub;
+	godot_variant hub_ref;
+	volatile uint32_t hub_ready;
+
+	// Which signal announces received data; set while a dispatch is already on its way to the main thread
+	serial_port_notify notify;
+	volatile uint32_t notify_pending;
+
+	// The exchange started by transact(). The main thread sets it up, then only the I/O thread
+	// touches it while it is waiting: it ends it on the response, or at transaction_deadline,
+	// and leaves it for the main thread to report. The response starts at rx.tail, which no read
+	// moves until then, and is transaction_length bytes long, or ends with transaction_terminator;
+	// once done, transaction_length is what was received, or 0 if the deadline came first.
+	volatile uint32_t transaction_state;
+	uint8_t transaction_terminator[SERIAL_PORT_MAX_DELIMITER];
+	uint32_t transaction_terminator_length;
+	uint32_t transaction_length;
+	uint32_t transaction_scanned;
+	int64_t transaction_deadline;
+
+	// The Modbus RTU requests of modbus_poll(), run by the I/O thread as one transaction that
+	// ends once the last has been answered. Each goes out once the line has been silent for
+	// modbus_silence_usec; its response ends at its expected length, after the same silence or
+	// at transaction_deadline. While modbus_sending, transaction_deadline is when the silence
+	// before modbus_current is over. Set by the main thread until the results are reported,
+	// and in the meantime only the I/O thread queues anything for tx.
+	serial_modbus_request *modbus_requests;
+	uint32_t modbus_num_requests;
+	uint32_t modbus_current;
+	bool modbus_sending;
+	int64_t modbus_silence_usec;
+	int64_t modbus_timeout_usec;
+	uint32_t modbus_seen; // response bytes of modbus_current seen so far
+	int64_t modbus_last_rx; // when the last of them arrived
+
+	// The break send_break() asked a threaded port for: its duration while it is on its way, set by
+	// the main thread, cleared by the I/O thread as it reports break_completed. Nothing more is
+	// queued for tx in the meantime, so the break starts once what was queued before it is out.
+	volatile uint32_t break_ms;
+
+	// Capture file started by record(), written by whichever thread moves the bytes. Whoever
+	// holds log_busy owns log; the producers only try for it, so they never wait.
+	serial_log_writer log;
+	volatile uint32_t recording;
+	volatile uint32_t log_busy;
+
+	// Remembers how far the last delimiter search got, so a frame arriving in
+	// pieces is scanned once overall: while rx.tail is still scan_tail, no
+	// scan_delimiter ends within the first scan_end pending bytes.
+	uint8_t scan_delimiter[SERIAL_PORT_MAX_DELIMITER];
+	uint32_t scan_delimiter_length;
+	uint32_t scan_tail;
+	uint32_t scan_end;
+
+	// How read_packet() and write_packet() cut the stream into packets
+	serial_framing framing;
+	uint32_t length_size;
+
+	// Trails the payload of every packet; frames that fail it or do not decode are counted and dropped
+	serial_checksum checksum;
+	uint64_t rejected_frames;
+
+	// Last format handed to unpack(), compiled once and reused while scripts keep passing the same string
+	godot_string unpack_source;
+	bool unpack_compiled;
+	serial_struct_format unpack_format;
+};
+
+void serial_port_init(serial_port *p_port, godot_object *p_instance, serial_port_pump_func p_pump);
+void serial_port_destroy(serial_port *p_port);
+
+bool serial_port_parse_options(const godot_variant *p_options, serial_port_options *r_options);
+// Looks up an option only a backend understands in the Dictionary given to open()
+bool serial_port_get_option(const godot_variant *p_options, const char *p_key, godot_variant *r_value);
+// Checks that p_value is a format every backend can set up, as a godot_serial_config or a String like "8N1"
+bool serial_port_parse_config(const godot_variant *p_value, godot_serial_config *r_config);
+// Reads what open() takes after the port name, from p_args on. r_settings->options_arg points
+// into p_args or into the SerialConfig given, so it lasts as long as the call.
+bool serial_port_parse_settings(int p_num_args, godot_variant **p_args, serial_port_settings *r_settings);
+// Sizes and empties the buffers for a freshly opened port, before any I/O thread starts, then joins its hub if any
+bool serial_port_prepare(serial_port *p_port, const serial_port_options *p_options);
+void serial_port_count_overflow(serial_port *p_port, uint64_t p_bytes);
+// For the I/O thread, finding rx full: sets rx_paused, or clears it again right away if the
+// consumer made room meanwhile, since that came with no wake-up. Reading resumes once it is clear.
+void serial_port_pause_rx(serial_port *p_port);
+
+// For the thread watching the modem lines of a port opened with "modem_events": emits
+// modem_lines_changed with p_lines, a serial_modem_line mask, if an input changed since it last looked
+void serial_port_report_modem_lines(serial_port *p_port, uint32_t p_lines);
+// The Dictionary get_modem_lines() returns and modem_lines_changed carries: "cts", "dsr", "dcd",
+// "ri", "rts" and "dtr" as bools, or empty for SERIAL_MODEM_UNKNOWN
+void serial_port_modem_lines_to_variant(uint32_t p_lines, godot_variant *r_ret);
+// Reads the level given to set_rts() or set_dtr() for p_line, and what modem_outputs becomes with it.
+// Refused while the port is closed or its flow control drives that line.
+bool serial_port_parse_modem_output(serial_port *p_port, serial_modem_line p_line, int p_num_args, godot_variant **p_args, uint32_t *r_outputs);
+// Reads the duration given to send_break(), from 1 to 10000 ms and SERIAL_PORT_DEFAULT_BREAK_MS if none
+bool serial_port_parse_break(serial_port *p_port, int p_num_args, godot_variant **p_args, int *r_duration_ms);
+// How long flush(timeout_ms) may wait for the p_queued bytes still to go out. Without a timeout_ms
+// that is the port's timeout, or when it has none as long as they take at its baud rate, plus
+// SERIAL_PORT_FLUSH_MARGIN_MS: flow control can hold them back for good.
+int serial_port_parse_flush(serial_port *p_port, int p_num_args, godot_variant **p_args, uint32_t p_queued);
+
+// For the main thread of a threaded port: hands the break to the I/O thread, which the caller then
+// wakes up. Refused while the one before has not completed.
+bool serial_port_request_break(serial_port *p_port, int p_duration_ms);
+// For the I/O thread: reports the requested break as over, or as failed to start
+void serial_port_complete_break(serial_port *p_port, bool p_success);
+
+// Appends p_data to tx in full or not at all, so a packet is never cut in half
+bool serial_port_enqueue(serial_port *p_port, const uint8_t *p_data, uint32_t p_length);
+// For the main thread: what is still queued in tx, and how much more fits. Neither counts while a
+// Modbus poll is running, since the I/O thread fills tx with its requests in the meantime, and
+// nothing fits while a break is on its way.
+uint32_t serial_port_tx_pending(serial_port *p_port);
+uint32_t serial_port_tx_free_space(serial_port *p_port);
+// Whether the caller is the one that has to wake up the I/O thread for data it just queued
+bool serial_port_needs_wake(serial_port *p_port);
+// Called by the I/O thread once woken up, before it looks at tx again
+void serial_port_clear_wake(serial_port *p_port);
+
+// Emits p_signal on the main thread; safe to call from the I/O thread
+void serial_port_emit_deferred(serial_port *p_port, const char *p_signal, int p_num_args, const godot_variant *p_args);
+// Calls p_method on the port's object from the main thread; safe to call from any thread
+void serial_port_call_deferred(serial_port *p_port, const char *p_method);
+// Called by whoever buffered new data in rx; schedules at most one dispatch at a time
+void serial_port_notify_received(serial_port *p_port);
+
+// Starts transact(request, terminator_or_length, timeout_ms) on a threaded port, sending the request
+// through p_write. Returns false without sending anything if the arguments are wrong, the port has
+// no I/O thread or another transaction has not been reported yet. Until transaction_completed has
+// been emitted, the read methods below return what they would for an empty rx.
+bool serial_port_transact(serial_port *p_port, int p_num_args, godot_variant **p_args, serial_port_write_func p_write);
+// Starts modbus_poll(requests, timeout_ms) on a threaded port. The I/O thread sends every request,
+// the first one too, once transaction_deadline has passed, so the caller only has to have it wake
+// up then. Returns false without sending anything in the same cases as serial_port_transact(), or
+// if a request is invalid; reads are held off the same way until modbus_completed.
+bool serial_port_modbus_poll(serial_port *p_port, int p_num_args, godot_variant **p_args);
+// For the I/O thread: when the transaction waiting for its response times out, or -1 if there is none.
+// A modbus_poll() moves it as its requests go out and their responses come in.
+int64_t serial_port_transaction_deadline(serial_port *p_port);
+// For the I/O thread, once the deadline has come: ends the transaction if it is still waiting, or
+// moves a modbus_poll() on to its next request
+void serial_port_expire_transaction(serial_port *p_port);
+
+// Appends bytes just buffered in rx, or just handed to the OS, to the capture file if there is
+// one; safe to call from the I/O thread
+void serial_port_log_traffic(serial_port *p_port, bool p_sent, const uint8_t *p_data, uint32_t p_length);
+
+// Builds the Dictionary returned by get_stats(); p_line_errors is NULL when the driver does not count them
+void serial_port_get_stats(serial_port *p_port, const serial_line_errors *p_line_errors, godot_variant *r_ret);
+
+// Hands each write() argument to p_write without copying it: bools as text, Strings as UTF-8
+// and PoolByteArrays through their read lock. Returns the number of arguments that failed.
+int serial_port_write_args(serial_port *p_port, int p_num_args, godot_variant **p_args, serial_port_write_func p_write);
+// Encodes a PoolByteArray or String argument with the port's framing and hands the
+// whole frame to p_write at once
+bool serial_port_write_packet(serial_port *p_port, int p_num_args, godot_variant **p_args, serial_port_write_func p_write);
+
+// The read methods take nothing while a transaction or Modbus poll owns rx, see serial_port_transact(),
+// and available_for_read() reports 0 then, so a loop reading while it is positive ends
+GDCALLINGCONV godot_variant serial_port_available_for_read(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_peek(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_read(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_read_string(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_read_bytes(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_read_all(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_read_with_timestamps(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_read_line(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_read_until(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_read_packet(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_get_rejected_frames(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_unpack(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_record(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_dispatch_notifications(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_port_get_overflow_count(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+#endif // SERIAL_PORT_H
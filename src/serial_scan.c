@@ -0,0 +1,89 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_scan.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SERIAL_SCAN_AVX2
+#define SERIAL_SCAN_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SERIAL_SCAN_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef SERIAL_SCAN_SSE2
+
+static inline uint32_t _first_set_bit(uint32_t p_mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, p_mask);
+	return index;
+#else
+	return __builtin_ctz(p_mask);
+#endif
+}
+
+const uint8_t *serial_scan_byte(const uint8_t *p_data, uint32_t p_length, uint8_t p_byte) {
+	const uint8_t *end = p_data + p_length;
+
+#ifdef SERIAL_SCAN_AVX2
+	const __m256i needle32 = _mm256_set1_epi8((char) p_byte);
+	while (end - p_data >= 32) {
+		const __m256i chunk = _mm256_loadu_si256((const __m256i *) p_data);
+		const uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32));
+		if (mask != 0)
+			return p_data + _first_set_bit(mask);
+		p_data += 32;
+	}
+#endif
+
+	const __m128i needle16 = _mm_set1_epi8((char) p_byte);
+	while (end - p_data >= 16) {
+		const __m128i chunk = _mm_loadu_si128((const __m128i *) p_data);
+		const uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16));
+		if (mask != 0)
+			return p_data + _first_set_bit(mask);
+		p_data += 16;
+	}
+
+	for (; p_data < end; p_data++) {
+		if (*p_data == p_byte)
+			return p_data;
+	}
+	return NULL;
+}
+
+#else
+
+const uint8_t *serial_scan_byte(const uint8_t *p_data, uint32_t p_length, uint8_t p_byte) {
+	return memchr(p_data, p_byte, p_length);
+}
+
+#endif
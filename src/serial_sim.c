@@ -0,0 +1,205 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "godot_serial.h"
+#include "serial_sim.h"
+#include "serial_atomic.h"
+#include <stdio.h>
+
+// The script made room in rx for bytes the thread was holding back
+static void _resume_rx(serial_port *p_port) {
+	serial_event_signal(&((serial_sim *) p_port)->wake);
+}
+
+void serial_sim_init(serial_sim *p_sim, godot_object *p_instance, const char *p_name, serial_port_pump_func p_pump, serial_thread_func p_main, serial_sim_deliver_func p_deliver) {
+	serial_port_init(&p_sim->base, p_instance, p_pump);
+	p_sim->base.resume_rx = _resume_rx;
+	p_sim->name = p_name;
+	p_sim->main = p_main;
+	p_sim->deliver = p_deliver;
+	p_sim->stop_requested = 0;
+}
+
+bool serial_sim_start_thread(serial_sim *p_sim) {
+	p_sim->stop_requested = 0;
+	if (!serial_event_init(&p_sim->wake)) {
+		fprintf(stderr, "Error creating %s event\n", p_sim->name);
+		return false;
+	}
+	if (!serial_thread_start(&p_sim->thread, p_sim->main, p_sim)) {
+		fprintf(stderr, "Error starting %s thread\n", p_sim->name);
+		serial_event_destroy(&p_sim->wake);
+		return false;
+	}
+	p_sim->base.threaded = true;
+	return true;
+}
+
+void serial_sim_stop_thread(serial_sim *p_sim) {
+	if (!p_sim->base.threaded)
+		return;
+
+	serial_atomic_store_u32(&p_sim->stop_requested, 1);
+	serial_event_signal(&p_sim->wake);
+	serial_thread_join(&p_sim->thread);
+	serial_event_destroy(&p_sim->wake);
+	// Nothing is left to wake up once there is room, nor to report a break
+	p_sim->base.rx_paused = 0;
+	p_sim->base.break_ms = 0;
+	p_sim->base.threaded = false;
+}
+
+bool serial_sim_stopping(serial_sim *p_sim) {
+	return serial_atomic_load_u32(&p_sim->stop_requested) != 0;
+}
+
+void serial_sim_wake(serial_sim *p_sim) {
+	if (p_sim->base.threaded)
+		serial_event_signal(&p_sim->wake);
+}
+
+bool serial_sim_wait_tx_empty(serial_sim *p_sim, int p_timeout_ms) {
+	for (int waited = 0; serial_port_tx_pending(&p_sim->base) > 0; waited++) {
+		if (waited >= p_timeout_ms)
+			return false;
+		serial_sleep_usec(1000);
+	}
+	return true;
+}
+
+// Queues for the thread when there is one, delivers the bytes right away otherwise
+static bool _send(serial_port *p_port, const uint8_t *data, uint32_t length) {
+	if (p_port->threaded)
+		return serial_port_enqueue(p_port, data, length);
+
+	((serial_sim *) p_port)->deliver((serial_sim *) p_port, data, length);
+	serial_stats_write(&p_port->stats, length);
+	serial_port_log_traffic(p_port, true, data, length);
+	return true;
+}
+
+// Wakes the thread once for everything a call queued
+static void _flush_queued(serial_sim *p_sim) {
+	if (p_sim->base.threaded && serial_port_tx_pending(&p_sim->base) > 0 && serial_port_needs_wake(&p_sim->base))
+		serial_event_signal(&p_sim->wake);
+}
+
+GDCALLINGCONV godot_variant serial_sim_available_for_write(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_sim * sim = (serial_sim *) p_user_data;
+
+	if (sim->base.threaded)
+		api->godot_variant_new_int(&ret, serial_port_tx_free_space(&sim->base));
+	else
+		api->godot_variant_new_int(&ret, ring_buffer_capacity(&sim->base.tx));
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_sim_write(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_sim * sim = (serial_sim *) p_user_data;
+
+	int num_errors = serial_port_write_args(&sim->base, p_num_args, p_args, _send);
+	_flush_queued(sim);
+
+	api->godot_variant_new_int(&ret, num_errors);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_sim_write_packet(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_sim * sim = (serial_sim *) p_user_data;
+
+	bool success = serial_port_write_packet(&sim->base, p_num_args, p_args, _send);
+	_flush_queued(sim);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_sim_transact(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_sim * sim = (serial_sim *) p_user_data;
+
+	bool success = serial_port_transact(&sim->base, p_num_args, p_args, _send);
+	_flush_queued(sim);
+	// The thread has a new deadline to wake up for, even if the request could not be queued
+	if (success)
+		serial_event_signal(&sim->wake);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_sim_modbus_poll(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_sim * sim = (serial_sim *) p_user_data;
+
+	// The thread has a deadline to wake up for, when it sends the first request
+	bool success = serial_port_modbus_poll(&sim->base, p_num_args, p_args);
+	if (success)
+		serial_event_signal(&sim->wake);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_sim_set_timeout(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	serial_sim * sim = (serial_sim *) p_user_data;
+	bool success = false;
+
+	if (p_num_args > 0 && api->godot_variant_get_type(p_args[0]) == GODOT_VARIANT_TYPE_INT) {
+		sim->base.timeout = api->godot_variant_as_int(p_args[0]);
+		success = true;
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_sim_list_ports(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	godot_array ports;
+
+	api->godot_array_new(&ports);
+	api->godot_variant_new_array(&ret, &ports);
+	api->godot_array_destroy(&ports);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_sim_check_connection(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	api->godot_variant_new_nil(&ret);
+	return ret;
+}
+
+GDCALLINGCONV godot_variant serial_sim_get_latency_settings(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	godot_dictionary settings;
+	api->godot_dictionary_new(&settings);
+	api->godot_variant_new_dictionary(&ret, &settings);
+	api->godot_dictionary_destroy(&settings);
+	return ret;
+}
@@ -0,0 +1,79 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_SIM_H
+#define SERIAL_SIM_H
+
+#include <gdnative_api_struct.gen.h>
+#include "serial_port.h"
+#include "serial_thread.h"
+
+typedef struct serial_sim serial_sim;
+
+// Hands bytes written to a port without an I/O thread to whatever stands behind it, at once
+typedef void (*serial_sim_deliver_func)(serial_sim *p_sim, const uint8_t *p_data, uint32_t p_length);
+
+// State shared by the backends that simulate what is on the other end of the port rather than
+// talk to a device, VirtualSerial and SerialReplay. A thread of their own stands in for the I/O
+// thread of a real port; without it, writes are delivered on the spot. Backends embed it as the
+// first member of their port data.
+struct serial_sim {
+	serial_port base;
+	const char *name; // for error messages
+	serial_thread_func main;
+	serial_sim_deliver_func deliver;
+
+	serial_thread thread;
+	serial_event wake;
+	volatile uint32_t stop_requested;
+};
+
+// p_main runs on the thread with the serial_sim as its argument, until stop_requested is set
+void serial_sim_init(serial_sim *p_sim, godot_object *p_instance, const char *p_name, serial_port_pump_func p_pump, serial_thread_func p_main, serial_sim_deliver_func p_deliver);
+
+// Starts the thread, after which the port is threaded; stopping it makes the port polled again
+bool serial_sim_start_thread(serial_sim *p_sim);
+void serial_sim_stop_thread(serial_sim *p_sim);
+// Whether the thread has been asked to return
+bool serial_sim_stopping(serial_sim *p_sim);
+// Wakes up the thread, if any
+void serial_sim_wake(serial_sim *p_sim);
+// Gives the thread up to p_timeout_ms to take everything queued, returning whether it did
+bool serial_sim_wait_tx_empty(serial_sim *p_sim, int p_timeout_ms);
+
+// Methods that work the same for every simulated backend
+GDCALLINGCONV godot_variant serial_sim_available_for_write(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_sim_write(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_sim_write_packet(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_sim_transact(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_sim_modbus_poll(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+GDCALLINGCONV godot_variant serial_sim_set_timeout(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+// Nothing to find: simulated ports exist once opened
+GDCALLINGCONV godot_variant serial_sim_list_ports(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+// Nothing is ever unplugged
+GDCALLINGCONV godot_variant serial_sim_check_connection(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+// No driver settings to report
+GDCALLINGCONV godot_variant serial_sim_get_latency_settings(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args);
+
+#endif // SERIAL_SIM_H
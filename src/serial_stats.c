@@ -0,0 +1,105 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_stats.h"
+#include "serial_atomic.h"
+#include "serial_thread.h"
+#include <string.h>
+
+void serial_stats_reset(serial_stats *p_stats) {
+	memset(p_stats, 0, sizeof(serial_stats));
+}
+
+// Only the single writer of p_max ever raises it
+static inline void _raise(volatile uint32_t *p_max, uint32_t p_value) {
+	if (p_value > serial_atomic_load_u32(p_max))
+		serial_atomic_store_u32(p_max, p_value);
+}
+
+void serial_stats_read(serial_stats *p_stats, ring_buffer *p_rx, int64_t p_bytes) {
+	serial_atomic_add_u64(&p_stats->reads, 1);
+	if (p_bytes <= 0)
+		return;
+
+	serial_atomic_add_u64(&p_stats->bytes_in, p_bytes);
+	_raise(&p_stats->max_rx_pending, ring_buffer_pending(p_rx));
+
+	const int64_t now = serial_time_usec();
+	const uint32_t head = p_stats->stamp_head;
+	if (head - serial_atomic_load_u32(&p_stats->stamp_tail) < SERIAL_STATS_MAX_STAMPS) {
+		serial_stats_stamp *stamp = &p_stats->stamps[head & (SERIAL_STATS_MAX_STAMPS - 1)];
+		stamp->end = p_rx->head;
+		stamp->usec = p_stats->unstamped_usec != 0 ? p_stats->unstamped_usec : now;
+		p_stats->unstamped_usec = 0;
+		serial_atomic_store_u32(&p_stats->stamp_head, head + 1);
+	} else if (p_stats->unstamped_usec == 0) {
+		p_stats->unstamped_usec = now;
+	}
+}
+
+void serial_stats_consumed(serial_stats *p_stats, ring_buffer *p_rx) {
+	const uint32_t head = serial_atomic_load_u32(&p_stats->stamp_head);
+	uint32_t tail = p_stats->stamp_tail;
+	if (tail == head)
+		return;
+
+	// Each chunk read in full counts once, with the time it spent in rx
+	int64_t now = -1;
+	const uint32_t consumed = p_rx->tail;
+	for (; tail != head; tail++) {
+		const serial_stats_stamp *stamp = &p_stats->stamps[tail & (SERIAL_STATS_MAX_STAMPS - 1)];
+		if ((int32_t) (stamp->end - consumed) > 0)
+			break;
+		if (now < 0)
+			now = serial_time_usec();
+
+		int64_t waited = now - stamp->usec;
+		int bucket = 0;
+		while (waited > 0 && bucket < SERIAL_STATS_LATENCY_BUCKETS - 1) {
+			waited >>= 1;
+			bucket++;
+		}
+		serial_atomic_add_u64(&p_stats->read_latency[bucket], 1);
+	}
+	serial_atomic_store_u32(&p_stats->stamp_tail, tail);
+}
+
+bool serial_stats_oldest_stamp(serial_stats *p_stats, serial_stats_stamp *r_stamp) {
+	const uint32_t tail = p_stats->stamp_tail;
+	if (tail == serial_atomic_load_u32(&p_stats->stamp_head))
+		return false;
+
+	*r_stamp = p_stats->stamps[tail & (SERIAL_STATS_MAX_STAMPS - 1)];
+	return true;
+}
+
+void serial_stats_write(serial_stats *p_stats, int64_t p_bytes) {
+	serial_atomic_add_u64(&p_stats->writes, 1);
+	if (p_bytes > 0)
+		serial_atomic_add_u64(&p_stats->bytes_out, p_bytes);
+}
+
+void serial_stats_queued(serial_stats *p_stats, ring_buffer *p_tx) {
+	_raise(&p_stats->max_tx_pending, ring_buffer_pending(p_tx));
+}
@@ -0,0 +1,90 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_STATS_H
+#define SERIAL_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ring_buffer.h"
+
+// Read latency buckets: bucket i counts reads of data that waited in rx for less than 2^i us
+// (at least 2^(i-1) us), and the last one everything slower
+#define SERIAL_STATS_LATENCY_BUCKETS 24
+// Chunks of received data whose arrival time is kept at once; must be a power of two
+#define SERIAL_STATS_MAX_STAMPS 256
+
+typedef struct {
+	uint32_t end; // rx head once the chunk was buffered
+	int64_t usec; // serial_time_usec() when its first byte was buffered
+} serial_stats_stamp;
+
+// What a port has been through since it was opened. Every counter has a single writer:
+// whoever produces into rx, whoever talks to the OS or whoever consumes rx. Updates are
+// relaxed atomics, so get_stats() can read them from the main thread at any time.
+typedef struct {
+	volatile uint64_t bytes_in;
+	volatile uint64_t bytes_out;
+	// Read and write calls made to the device, system calls for a real port
+	volatile uint64_t reads;
+	volatile uint64_t writes;
+	// Most bytes ever waiting in rx for the script, and in tx for the I/O thread
+	volatile uint32_t max_rx_pending;
+	volatile uint32_t max_tx_pending;
+
+	volatile uint64_t read_latency[SERIAL_STATS_LATENCY_BUCKETS];
+
+	// When the chunks still in rx arrived: pushed by the producer of rx, popped by its consumer.
+	// Chunks buffered while this is full are merged into the next one pushed, which keeps the
+	// time of the oldest of them in unstamped_usec (0 when there is none), private to the producer.
+	serial_stats_stamp stamps[SERIAL_STATS_MAX_STAMPS];
+	volatile uint32_t stamp_head;
+	volatile uint32_t stamp_tail;
+	int64_t unstamped_usec;
+} serial_stats;
+
+// Errors reported by the UART, counted since the port was opened
+typedef struct {
+	uint64_t frame_errors;
+	uint64_t parity_errors;
+	uint64_t overruns;
+	uint64_t breaks;
+} serial_line_errors;
+
+// Only safe while nothing else uses the port, and together with clearing rx
+void serial_stats_reset(serial_stats *p_stats);
+
+// Producer of rx, after a read that buffered p_bytes into p_rx (none if zero or negative)
+void serial_stats_read(serial_stats *p_stats, ring_buffer *p_rx, int64_t p_bytes);
+// Consumer of rx, after taking bytes out of p_rx
+void serial_stats_consumed(serial_stats *p_stats, ring_buffer *p_rx);
+// Consumer of rx: the oldest chunk still (partly) in rx, false when the bytes left have no stamp yet
+bool serial_stats_oldest_stamp(serial_stats *p_stats, serial_stats_stamp *r_stamp);
+
+// Whoever hands bytes to the device, after a write that sent p_bytes of them (none if zero or negative)
+void serial_stats_write(serial_stats *p_stats, int64_t p_bytes);
+// Producer of tx, after queueing bytes in p_tx
+void serial_stats_queued(serial_stats *p_stats, ring_buffer *p_tx);
+
+#endif // SERIAL_STATS_H
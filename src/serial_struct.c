@@ -0,0 +1,196 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_struct.h"
+#include <string.h>
+
+static const uint8_t _type_size[] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+
+static bool _native_big_endian(void) {
+	const uint16_t probe = 1;
+	return *(const uint8_t *) &probe == 0;
+}
+
+bool serial_struct_compile(const char *p_format, serial_struct_format *r_format) {
+	r_format->big_endian = false;
+	r_format->record_size = 0;
+	r_format->num_fields = 0;
+	r_format->uniform = true;
+
+	const char *c = p_format;
+	switch (*c) {
+	case '<': r_format->big_endian = false; c++; break;
+	case '>':
+	case '!': r_format->big_endian = true; c++; break;
+	case '=': r_format->big_endian = _native_big_endian(); c++; break;
+	default: break;
+	}
+
+	bool ints = true;
+	bool reals = true;
+	for (; *c != '\0'; c++) {
+		if (*c == ' ')
+			continue;
+
+		uint32_t count = 1;
+		if (*c >= '0' && *c <= '9') {
+			count = 0;
+			while (*c >= '0' && *c <= '9' && count <= SERIAL_STRUCT_MAX_FIELDS * 8)
+				count = count * 10 + (*c++ - '0');
+			if (*c == '\0')
+				return false;
+		}
+
+		if (*c == 'x') {
+			r_format->record_size += count;
+			r_format->uniform = false;
+			continue;
+		}
+
+		serial_struct_type type;
+		switch (*c) {
+		case 'b': type = SERIAL_STRUCT_INT8; break;
+		case 'B': type = SERIAL_STRUCT_UINT8; break;
+		case 'h': type = SERIAL_STRUCT_INT16; break;
+		case 'H': type = SERIAL_STRUCT_UINT16; break;
+		case 'i': type = SERIAL_STRUCT_INT32; break;
+		case 'I': type = SERIAL_STRUCT_UINT32; break;
+		case 'q': type = SERIAL_STRUCT_INT64; break;
+		case 'Q': type = SERIAL_STRUCT_UINT64; break;
+		case 'f': type = SERIAL_STRUCT_FLOAT32; break;
+		case 'd': type = SERIAL_STRUCT_FLOAT64; break;
+		default: return false;
+		}
+
+		if (count > SERIAL_STRUCT_MAX_FIELDS - r_format->num_fields)
+			return false;
+		for (uint32_t i = 0; i < count; i++) {
+			serial_struct_field *field = &r_format->fields[r_format->num_fields++];
+			field->type = type;
+			field->offset = r_format->record_size;
+			r_format->record_size += _type_size[type];
+			if (field->type != r_format->fields[0].type)
+				r_format->uniform = false;
+		}
+
+		// PoolIntArray holds 32-bit signed ints, PoolRealArray 32-bit floats
+		if (type > SERIAL_STRUCT_INT32)
+			ints = false;
+		if (type != SERIAL_STRUCT_FLOAT32)
+			reals = false;
+	}
+
+	if (r_format->num_fields == 0)
+		return false;
+	r_format->output = ints ? SERIAL_STRUCT_OUTPUT_INTS : reals ? SERIAL_STRUCT_OUTPUT_REALS : SERIAL_STRUCT_OUTPUT_ARRAYS;
+	return true;
+}
+
+static inline uint64_t _load(const uint8_t *p_data, uint32_t p_size, bool p_big_endian) {
+	uint64_t value = 0;
+	if (p_big_endian) {
+		for (uint32_t i = 0; i < p_size; i++)
+			value = value << 8 | p_data[i];
+	} else {
+		for (uint32_t i = p_size; i > 0; i--)
+			value = value << 8 | p_data[i - 1];
+	}
+	return value;
+}
+
+bool serial_struct_is_real(const serial_struct_field *p_field) {
+	return p_field->type == SERIAL_STRUCT_FLOAT32 || p_field->type == SERIAL_STRUCT_FLOAT64;
+}
+
+int64_t serial_struct_get_int(const serial_struct_format *p_format, const serial_struct_field *p_field, const uint8_t *p_record) {
+	const uint64_t raw = _load(p_record + p_field->offset, _type_size[p_field->type], p_format->big_endian);
+	switch (p_field->type) {
+	case SERIAL_STRUCT_INT8: return (int8_t) raw;
+	case SERIAL_STRUCT_INT16: return (int16_t) raw;
+	case SERIAL_STRUCT_INT32: return (int32_t) raw;
+	case SERIAL_STRUCT_FLOAT32:
+	case SERIAL_STRUCT_FLOAT64: return (int64_t) serial_struct_get_real(p_format, p_field, p_record);
+	default: return (int64_t) raw;
+	}
+}
+
+double serial_struct_get_real(const serial_struct_format *p_format, const serial_struct_field *p_field, const uint8_t *p_record) {
+	const uint64_t raw = _load(p_record + p_field->offset, _type_size[p_field->type], p_format->big_endian);
+	if (p_field->type == SERIAL_STRUCT_FLOAT32) {
+		const uint32_t bits = (uint32_t) raw;
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+	if (p_field->type == SERIAL_STRUCT_FLOAT64) {
+		double value;
+		memcpy(&value, &raw, sizeof(value));
+		return value;
+	}
+	return (double) serial_struct_get_int(p_format, p_field, p_record);
+}
+
+// Straight loops over a whole batch of one little-endian type, simple enough for the compiler to vectorise
+#define DECODE_UNIFORM_LE(m_type, m_out) \
+	for (uint32_t i = 0; i < p_count; i++) { \
+		m_type value; \
+		memcpy(&value, p_data + i * sizeof(m_type), sizeof(m_type)); \
+		m_out[i] = value; \
+	}
+
+static bool _decode_uniform_ints(const serial_struct_format *p_format, const uint8_t *p_data, uint32_t p_count, int32_t *r_values) {
+	if (!p_format->uniform || p_format->big_endian || _native_big_endian())
+		return false;
+
+	switch (p_format->fields[0].type) {
+	case SERIAL_STRUCT_INT8: DECODE_UNIFORM_LE(int8_t, r_values); return true;
+	case SERIAL_STRUCT_UINT8: DECODE_UNIFORM_LE(uint8_t, r_values); return true;
+	case SERIAL_STRUCT_INT16: DECODE_UNIFORM_LE(int16_t, r_values); return true;
+	case SERIAL_STRUCT_UINT16: DECODE_UNIFORM_LE(uint16_t, r_values); return true;
+	case SERIAL_STRUCT_INT32: DECODE_UNIFORM_LE(int32_t, r_values); return true;
+	default: return false;
+	}
+}
+
+void serial_struct_decode_ints(const serial_struct_format *p_format, const uint8_t *p_data, uint32_t p_num_records, int32_t *r_values) {
+	if (_decode_uniform_ints(p_format, p_data, p_num_records * p_format->num_fields, r_values))
+		return;
+
+	for (uint32_t r = 0; r < p_num_records; r++, p_data += p_format->record_size) {
+		for (uint32_t f = 0; f < p_format->num_fields; f++)
+			*r_values++ = (int32_t) serial_struct_get_int(p_format, &p_format->fields[f], p_data);
+	}
+}
+
+void serial_struct_decode_reals(const serial_struct_format *p_format, const uint8_t *p_data, uint32_t p_num_records, float *r_values) {
+	if (p_format->uniform && !p_format->big_endian && !_native_big_endian() && p_format->fields[0].type == SERIAL_STRUCT_FLOAT32) {
+		memcpy(r_values, p_data, (size_t) p_num_records * p_format->record_size);
+		return;
+	}
+
+	for (uint32_t r = 0; r < p_num_records; r++, p_data += p_format->record_size) {
+		for (uint32_t f = 0; f < p_format->num_fields; f++)
+			*r_values++ = (float) serial_struct_get_real(p_format, &p_format->fields[f], p_data);
+	}
+}
@@ -0,0 +1,81 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_STRUCT_H
+#define SERIAL_STRUCT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SERIAL_STRUCT_MAX_FIELDS 64
+
+typedef enum {
+	SERIAL_STRUCT_INT8,    // b
+	SERIAL_STRUCT_UINT8,   // B
+	SERIAL_STRUCT_INT16,   // h
+	SERIAL_STRUCT_UINT16,  // H
+	SERIAL_STRUCT_INT32,   // i
+	SERIAL_STRUCT_UINT32,  // I
+	SERIAL_STRUCT_INT64,   // q
+	SERIAL_STRUCT_UINT64,  // Q
+	SERIAL_STRUCT_FLOAT32, // f
+	SERIAL_STRUCT_FLOAT64, // d
+} serial_struct_type;
+
+// How decoded records are best handed to script
+typedef enum {
+	SERIAL_STRUCT_OUTPUT_INTS,   // every field fits a PoolIntArray
+	SERIAL_STRUCT_OUTPUT_REALS,  // every field is a float32, fits a PoolRealArray
+	SERIAL_STRUCT_OUTPUT_ARRAYS, // mixed or wide fields: one Array per record
+} serial_struct_output;
+
+typedef struct {
+	serial_struct_type type;
+	uint32_t offset; // within the record
+} serial_struct_field;
+
+// A compiled layout such as "<hhhf": an optional byte order ('<' little, '>' or '!' big,
+// '=' native), then field codes, each optionally preceded by a repeat count, with 'x' as a
+// pad byte. Spaces are ignored.
+typedef struct {
+	bool big_endian;
+	bool uniform; // every field has the same type and there is no padding
+	uint32_t record_size;
+	uint32_t num_fields;
+	serial_struct_output output;
+	serial_struct_field fields[SERIAL_STRUCT_MAX_FIELDS];
+} serial_struct_format;
+
+bool serial_struct_compile(const char *p_format, serial_struct_format *r_format);
+
+// Decode p_num_records records, field after field, into a flat array
+void serial_struct_decode_ints(const serial_struct_format *p_format, const uint8_t *p_data, uint32_t p_num_records, int32_t *r_values);
+void serial_struct_decode_reals(const serial_struct_format *p_format, const uint8_t *p_data, uint32_t p_num_records, float *r_values);
+
+// Single field access, for records that do not fit the flat arrays
+bool serial_struct_is_real(const serial_struct_field *p_field);
+int64_t serial_struct_get_int(const serial_struct_format *p_format, const serial_struct_field *p_field, const uint8_t *p_record);
+double serial_struct_get_real(const serial_struct_format *p_format, const serial_struct_field *p_field, const uint8_t *p_record);
+
+#endif // SERIAL_STRUCT_H
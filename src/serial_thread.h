@@ -0,0 +1,195 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_THREAD_H
+#define SERIAL_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Just enough threading for code shared by every platform, such as the virtual
+// device: a thread, an auto-reset event to wake it with, and a monotonic clock.
+// Platform backends keep using their native primitives directly.
+
+typedef void (*serial_thread_func)(void *p_data);
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+typedef struct {
+	HANDLE handle;
+	serial_thread_func func;
+	void *data;
+} serial_thread;
+
+typedef struct {
+	HANDLE handle;
+} serial_event;
+
+static inline DWORD WINAPI _serial_thread_main(LPVOID p_thread) {
+	serial_thread *thread = (serial_thread *) p_thread;
+	thread->func(thread->data);
+	return 0;
+}
+
+static inline bool serial_thread_start(serial_thread *p_thread, serial_thread_func p_func, void *p_data) {
+	p_thread->func = p_func;
+	p_thread->data = p_data;
+	p_thread->handle = CreateThread(NULL, 0, _serial_thread_main, p_thread, 0, NULL);
+	return p_thread->handle != NULL;
+}
+
+static inline void serial_thread_join(serial_thread *p_thread) {
+	WaitForSingleObject(p_thread->handle, INFINITE);
+	CloseHandle(p_thread->handle);
+	p_thread->handle = NULL;
+}
+
+static inline bool serial_event_init(serial_event *p_event) {
+	p_event->handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+	return p_event->handle != NULL;
+}
+
+static inline void serial_event_destroy(serial_event *p_event) {
+	CloseHandle(p_event->handle);
+}
+
+static inline void serial_event_signal(serial_event *p_event) {
+	SetEvent(p_event->handle);
+}
+
+// Waits for the event, or p_timeout_usec (forever if negative), rounded up to whole milliseconds
+static inline void serial_event_wait(serial_event *p_event, int64_t p_timeout_usec) {
+	WaitForSingleObject(p_event->handle, p_timeout_usec < 0 ? INFINITE : (DWORD) ((p_timeout_usec + 999) / 1000));
+}
+
+static inline int64_t serial_time_usec(void) {
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER now;
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (int64_t) (now.QuadPart / frequency.QuadPart) * 1000000 + (int64_t) (now.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+static inline void serial_sleep_usec(int64_t p_usec) {
+	Sleep((DWORD) ((p_usec + 999) / 1000));
+}
+
+#else
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef struct {
+	pthread_t handle;
+	serial_thread_func func;
+	void *data;
+} serial_thread;
+
+typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool signaled;
+} serial_event;
+
+static inline void * _serial_thread_main(void *p_thread) {
+	serial_thread *thread = (serial_thread *) p_thread;
+	thread->func(thread->data);
+	return NULL;
+}
+
+static inline bool serial_thread_start(serial_thread *p_thread, serial_thread_func p_func, void *p_data) {
+	p_thread->func = p_func;
+	p_thread->data = p_data;
+	return pthread_create(&p_thread->handle, NULL, _serial_thread_main, p_thread) == 0;
+}
+
+static inline void serial_thread_join(serial_thread *p_thread) {
+	pthread_join(p_thread->handle, NULL);
+}
+
+static inline bool serial_event_init(serial_event *p_event) {
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	const bool ok = pthread_cond_init(&p_event->cond, &attr) == 0;
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&p_event->mutex, NULL);
+	p_event->signaled = false;
+	return ok;
+}
+
+static inline void serial_event_destroy(serial_event *p_event) {
+	pthread_cond_destroy(&p_event->cond);
+	pthread_mutex_destroy(&p_event->mutex);
+}
+
+static inline void serial_event_signal(serial_event *p_event) {
+	pthread_mutex_lock(&p_event->mutex);
+	p_event->signaled = true;
+	pthread_cond_signal(&p_event->cond);
+	pthread_mutex_unlock(&p_event->mutex);
+}
+
+// Waits for the event, or p_timeout_usec (forever if negative)
+static inline void serial_event_wait(serial_event *p_event, int64_t p_timeout_usec) {
+	struct timespec deadline;
+	if (p_timeout_usec >= 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += p_timeout_usec / 1000000;
+		deadline.tv_nsec += (p_timeout_usec % 1000000) * 1000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&p_event->mutex);
+	while (!p_event->signaled) {
+		if (p_timeout_usec < 0)
+			pthread_cond_wait(&p_event->cond, &p_event->mutex);
+		else if (pthread_cond_timedwait(&p_event->cond, &p_event->mutex, &deadline) != 0)
+			break;
+	}
+	p_event->signaled = false;
+	pthread_mutex_unlock(&p_event->mutex);
+}
+
+static inline int64_t serial_time_usec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static inline void serial_sleep_usec(int64_t p_usec) {
+	struct timespec duration = { (time_t) (p_usec / 1000000), (long) (p_usec % 1000000) * 1000 };
+	while (nanosleep(&duration, &duration) != 0 && errno == EINTR);
+}
+
+#endif
+
+#endif // SERIAL_THREAD_H
@@ -0,0 +1,104 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "serial_utf8.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SERIAL_UTF8_SSE2
+#endif
+
+// Bytes in the sequence started by p_lead, or 0 if it cannot start one
+static inline uint32_t _sequence_length(uint8_t p_lead) {
+	if (p_lead < 0x80)
+		return 1;
+	if (p_lead >= 0xc2 && p_lead <= 0xdf)
+		return 2;
+	if ((p_lead & 0xf0) == 0xe0)
+		return 3;
+	if (p_lead >= 0xf0 && p_lead <= 0xf4)
+		return 4;
+	return 0;
+}
+
+uint32_t serial_utf8_complete_length(const uint8_t *p_data, uint32_t p_length) {
+	if (p_length == 0)
+		return 0;
+
+	// Back up over continuation bytes to the lead byte of the last sequence
+	uint32_t lead = p_length - 1;
+	while (lead > 0 && p_length - lead < 4 && (p_data[lead] & 0xc0) == 0x80)
+		lead--;
+
+	const uint32_t needed = _sequence_length(p_data[lead]);
+	if (needed != 0 && p_length - lead < needed)
+		return lead;
+	return p_length;
+}
+
+uint32_t serial_utf8_valid_length(const uint8_t *p_data, uint32_t p_length) {
+	uint32_t i = 0;
+
+	while (i < p_length) {
+#ifdef SERIAL_UTF8_SSE2
+		if (p_length - i >= 16) {
+			const __m128i chunk = _mm_loadu_si128((const __m128i *) (p_data + i));
+			if (_mm_movemask_epi8(chunk) == 0) {
+				i += 16;
+				continue;
+			}
+		}
+#endif
+		const uint8_t lead = p_data[i];
+		if (lead < 0x80) {
+			i++;
+			continue;
+		}
+
+		const uint32_t needed = _sequence_length(lead);
+		if (needed == 0 || p_length - i < needed)
+			return i;
+
+		// Second byte ranges that rule out overlong forms, surrogates and code points past U+10FFFF
+		const uint8_t second = p_data[i + 1];
+		uint8_t low = 0x80, high = 0xbf;
+		if (lead == 0xe0)
+			low = 0xa0;
+		else if (lead == 0xed)
+			high = 0x9f;
+		else if (lead == 0xf0)
+			low = 0x90;
+		else if (lead == 0xf4)
+			high = 0x8f;
+		if (second < low || second > high)
+			return i;
+
+		for (uint32_t n = 2; n < needed; n++) {
+			if ((p_data[i + n] & 0xc0) != 0x80)
+				return i;
+		}
+		i += needed;
+	}
+	return i;
+}
@@ -0,0 +1,39 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SERIAL_UTF8_H
+#define SERIAL_UTF8_H
+
+#include <stdint.h>
+
+// Length of p_data up to the end of its last complete code point, leaving out
+// a multibyte sequence cut short by the end of the buffer. Looks at no more
+// than the last four bytes; anything malformed is left to the validator.
+uint32_t serial_utf8_complete_length(const uint8_t *p_data, uint32_t p_length);
+
+// Length of the longest well-formed UTF-8 prefix of p_data. ASCII runs are
+// skipped 16 bytes at a time with SSE2 when the build targets it.
+uint32_t serial_utf8_valid_length(const uint8_t *p_data, uint32_t p_length);
+
+#endif // SERIAL_UTF8_H
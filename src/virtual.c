@@ -0,0 +1,742 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "godot_serial.h"
+#include "serial_interface.h"
+#include "serial_port.h"
+#include "serial_hub.h"
+#include "serial_sim.h"
+#include "serial_atomic.h"
+#include "serial_thread.h"
+#include <string.h>
+#include <stdio.h>
+
+// VirtualSerial: a simulated device behind the same methods as Serial, so framing, buffering
+// and threading can be measured and tested without hardware. Bytes travel at the speed the
+// baud rate and config allow in both directions; on top of that, options given to open():
+//   "latency_ms": float - time the device takes to start answering (default 0)
+//   "chunk_size": int - bytes handed over at once, like the packets of a USB adapter (default 1)
+//   "responses": Dictionary - String or PoolByteArray requests mapped to what the device answers
+//                             once it has received them (default none)
+//   "echo": bool - send back everything received (default true unless "responses" is given)
+//   "error_rate": float - chance for each byte sent back to arrive with one bit flipped (default 0)
+//   "seed": int - starting point of the pseudo-random errors, for runs that repeat exactly (default 1)
+// With "flow_control", the device holds back what it sends while rx is full instead of overrunning
+// it, and holds back what the host sends while it has no room to answer.
+// The modem lines are wired back like a null modem cable: CTS follows RTS, DSR and DCD follow DTR.
+// Without an I/O thread, the device moves along whenever the port is read from.
+
+#define VIRTUAL_MAX_SEGMENTS 256
+#define VIRTUAL_MAX_RESPONSES 32
+#define VIRTUAL_MAX_REQUEST 256
+// How far ahead of the clock the device thread takes queued bytes, like the FIFO of a real UART
+#define VIRTUAL_TX_AHEAD_NSEC 1000000
+
+// Bytes the device sent back in one go: byte i is on the host side at
+// start_nsec + (i + 1) * byte_nsec, rounded up to the end of its chunk
+typedef struct {
+	int64_t start_nsec;
+	uint32_t length;
+	uint32_t delivered;
+} virtual_segment;
+
+typedef struct {
+	uint8_t *request;
+	uint32_t request_length;
+	uint8_t *response;
+	uint32_t response_length;
+} virtual_response;
+
+typedef struct {
+	serial_sim sim;
+
+	// How the device behaves, from open()
+	int64_t byte_nsec;
+	int64_t latency_nsec;
+	uint32_t chunk_size;
+	uint32_t error_threshold; // out of 2^32
+	uint32_t random;
+	bool parity;              // a flipped bit is caught as a parity error, as a UART would
+	bool echo;
+	virtual_response responses[VIRTUAL_MAX_RESPONSES];
+	int num_responses;
+
+	// The device itself. Only touched by the device thread when threaded, by the caller otherwise.
+	uint8_t request[VIRTUAL_MAX_REQUEST]; // received since the last scripted response
+	uint32_t request_length;
+	int64_t tx_line_nsec; // when the host is done sending what it sent so far
+	int64_t rx_line_nsec; // when the device is done sending what it sent so far
+	ring_buffer wire;     // sent by the device, yet to arrive in rx
+	virtual_segment segments[VIRTUAL_MAX_SEGMENTS];
+	uint32_t first_segment;
+	uint32_t num_segments;
+	bool sent;            // bytes went out since the queue was last empty
+	int64_t break_end_nsec; // when the break of send_break() on the line is over, 0 while none is on
+	volatile uint64_t parity_errors;
+} data_struct;
+
+static int64_t _now_nsec(void) {
+	return serial_time_usec() * 1000;
+}
+
+// xorshift32: cheap, and the same errors every run for the same seed
+static uint32_t _random(data_struct * user_data) {
+	uint32_t x = user_data->random;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return user_data->random = x;
+}
+
+// The device puts p_length bytes on the line back to the host, as soon as it is free after p_ready_nsec
+static void _device_send(data_struct * user_data, const uint8_t *p_data, uint32_t p_length, int64_t p_ready_nsec) {
+	// The device has no more room than the port it talks to
+	const uint32_t free_space = ring_buffer_free_space(&user_data->wire);
+	if (p_length > free_space) {
+		serial_port_count_overflow(&user_data->sim.base, p_length - free_space);
+		p_length = free_space;
+	}
+	if (p_length == 0)
+		return;
+
+	for (uint32_t written = 0; written < p_length;) {
+		uint8_t *dst;
+		uint32_t length = ring_buffer_write_region(&user_data->wire, &dst);
+		if (length > p_length - written)
+			length = p_length - written;
+		memcpy(dst, p_data + written, length);
+		if (user_data->error_threshold != 0) {
+			for (uint32_t i = 0; i < length; i++) {
+				if (_random(user_data) < user_data->error_threshold) {
+					dst[i] ^= 1 << (_random(user_data) & 7);
+					if (user_data->parity)
+						serial_atomic_add_u64(&user_data->parity_errors, 1);
+				}
+			}
+		}
+		ring_buffer_commit(&user_data->wire, length);
+		written += length;
+	}
+
+	const int64_t start = p_ready_nsec > user_data->rx_line_nsec ? p_ready_nsec : user_data->rx_line_nsec;
+	user_data->rx_line_nsec = start + p_length * user_data->byte_nsec;
+
+	if (user_data->num_segments == VIRTUAL_MAX_SEGMENTS) {
+		// Out of bookkeeping: the bytes follow the last segment back to back, arriving early rather than never
+		user_data->segments[(user_data->first_segment + user_data->num_segments - 1) % VIRTUAL_MAX_SEGMENTS].length += p_length;
+		return;
+	}
+	virtual_segment *segment = &user_data->segments[(user_data->first_segment + user_data->num_segments++) % VIRTUAL_MAX_SEGMENTS];
+	segment->start_nsec = start;
+	segment->length = p_length;
+	segment->delivered = 0;
+}
+
+// The device receives p_length bytes from the host, the first one going down the line at p_start_nsec
+static void _device_receive(data_struct * user_data, const uint8_t *p_data, uint32_t p_length, int64_t p_start_nsec) {
+	const int64_t byte_nsec = user_data->byte_nsec;
+	if (user_data->echo)
+		_device_send(user_data, p_data, p_length, p_start_nsec + byte_nsec + user_data->latency_nsec);
+
+	for (uint32_t i = 0; i < p_length && user_data->num_responses > 0; i++) {
+		// Requests are at most VIRTUAL_MAX_REQUEST bytes long, so older bytes can never match anymore
+		if (user_data->request_length == VIRTUAL_MAX_REQUEST) {
+			memmove(user_data->request, user_data->request + VIRTUAL_MAX_REQUEST / 2, VIRTUAL_MAX_REQUEST / 2);
+			user_data->request_length = VIRTUAL_MAX_REQUEST / 2;
+		}
+		user_data->request[user_data->request_length++] = p_data[i];
+
+		for (int r = 0; r < user_data->num_responses; r++) {
+			const virtual_response *response = &user_data->responses[r];
+			if (response->request_length <= user_data->request_length && response->request[response->request_length - 1] == p_data[i]
+					&& memcmp(user_data->request + user_data->request_length - response->request_length, response->request, response->request_length) == 0) {
+				const int64_t received = p_start_nsec + (int64_t) (i + 1) * byte_nsec;
+				_device_send(user_data, response->response, response->response_length, received + user_data->latency_nsec);
+				user_data->request_length = 0;
+				break;
+			}
+		}
+	}
+}
+
+// Moves whatever has reached the host by p_now_nsec from the wire into rx, returning how many bytes made it
+static uint32_t _deliver(data_struct * user_data, int64_t p_now_nsec) {
+	uint32_t buffered = 0;
+
+	while (user_data->num_segments > 0) {
+		virtual_segment *segment = &user_data->segments[user_data->first_segment];
+		uint32_t arrived = 0;
+		if (p_now_nsec > segment->start_nsec) {
+			const int64_t done = (p_now_nsec - segment->start_nsec) / user_data->byte_nsec;
+			arrived = done >= segment->length ? segment->length : (uint32_t) done / user_data->chunk_size * user_data->chunk_size;
+		}
+		if (arrived <= segment->delivered)
+			break;
+		// With flow control the device waits while rx is full rather than overrun it
+		if (user_data->sim.base.options.flow_control != SERIAL_FLOW_NONE && arrived - segment->delivered > ring_buffer_free_space(&user_data->sim.base.rx))
+			arrived = segment->delivered + ring_buffer_free_space(&user_data->sim.base.rx);
+
+		for (uint32_t count = arrived - segment->delivered; count > 0;) {
+			const uint8_t *src;
+			uint32_t length = ring_buffer_read_region(&user_data->wire, &src);
+			if (length > count)
+				length = count;
+			const uint32_t written = ring_buffer_write(&user_data->sim.base.rx, src, length);
+			serial_port_log_traffic(&user_data->sim.base, false, src, written);
+			serial_stats_read(&user_data->sim.base.stats, &user_data->sim.base.rx, written);
+			if (written < length)
+				serial_port_count_overflow(&user_data->sim.base, length - written);
+			ring_buffer_consume(&user_data->wire, length);
+			buffered += written;
+			count -= length;
+		}
+
+		segment->delivered = arrived;
+		if (arrived < segment->length)
+			break;
+		user_data->first_segment = (user_data->first_segment + 1) % VIRTUAL_MAX_SEGMENTS;
+		user_data->num_segments--;
+	}
+	return buffered;
+}
+
+// When the next byte on the wire reaches the host, or -1 if there is none
+static int64_t _next_arrival(data_struct * user_data) {
+	if (user_data->num_segments == 0)
+		return -1;
+
+	const virtual_segment *segment = &user_data->segments[user_data->first_segment];
+	uint32_t next = (segment->delivered / user_data->chunk_size + 1) * user_data->chunk_size;
+	if (next > segment->length)
+		next = segment->length;
+	return segment->start_nsec + next * user_data->byte_nsec;
+}
+
+static int _read_and_buffer(serial_port *p_port) {
+	data_struct * user_data = (data_struct *) p_port;
+
+	int64_t now = _now_nsec();
+	uint32_t buffered = _deliver(user_data, now);
+
+	// Blocking reads wait for the device just like they would for a real one
+	if (buffered == 0 && p_port->timeout > 0) {
+		const int64_t next = _next_arrival(user_data);
+		if (next >= 0 && next - now <= (int64_t) p_port->timeout * 1000000) {
+			serial_sleep_usec((next - now + 999) / 1000);
+			buffered = _deliver(user_data, _now_nsec());
+		}
+	}
+
+	if (buffered == 0 && ring_buffer_free_space(&p_port->rx) == 0)
+		return -1;
+	return buffered;
+}
+
+// Without a device thread, what the script writes reaches the device right away
+static void _deliver_written(serial_sim *p_sim, const uint8_t *p_data, uint32_t p_length) {
+	data_struct * user_data = (data_struct *) p_sim;
+
+	const int64_t now = _now_nsec();
+	if (user_data->tx_line_nsec < now)
+		user_data->tx_line_nsec = now;
+	_device_receive(user_data, p_data, p_length, user_data->tx_line_nsec);
+	user_data->tx_line_nsec += p_length * user_data->byte_nsec;
+}
+
+// The inputs the wiring gives p_outputs, along with them
+static uint32_t _modem_lines(uint32_t p_outputs) {
+	return p_outputs | (p_outputs & SERIAL_MODEM_RTS ? SERIAL_MODEM_CTS : 0) | (p_outputs & SERIAL_MODEM_DTR ? SERIAL_MODEM_DSR | SERIAL_MODEM_DCD : 0);
+}
+
+static void _device_main(void *p_data) {
+	data_struct * user_data = (data_struct *) p_data;
+	ring_buffer *tx = &user_data->sim.base.tx;
+
+	while (!serial_sim_stopping(&user_data->sim)) {
+		// Anything queued after this point comes with a new wake-up
+		serial_port_clear_wake(&user_data->sim.base);
+		const int64_t now = _now_nsec();
+
+		// A line left idle does not save up time for later
+		if (ring_buffer_available(tx) > 0 && user_data->tx_line_nsec < now)
+			user_data->tx_line_nsec = now;
+
+		// Take what the line gets through by now, plus what a UART would already hold in its FIFO
+		for (;;) {
+			int64_t room = (now + VIRTUAL_TX_AHEAD_NSEC - user_data->tx_line_nsec) / user_data->byte_nsec;
+			if (room <= 0 && user_data->tx_line_nsec <= now)
+				room = 1;
+			// With flow control the device holds the host back while it has no room to answer
+			if (user_data->sim.base.options.flow_control != SERIAL_FLOW_NONE && room > ring_buffer_free_space(&user_data->wire))
+				room = ring_buffer_free_space(&user_data->wire);
+
+			const uint8_t *src;
+			uint32_t length = ring_buffer_read_region(tx, &src);
+			if (room <= 0 || length == 0)
+				break;
+			if ((int64_t) length > room)
+				length = (uint32_t) room;
+
+			_device_receive(user_data, src, length, user_data->tx_line_nsec);
+			user_data->tx_line_nsec += length * user_data->byte_nsec;
+			serial_port_log_traffic(&user_data->sim.base, true, src, length);
+			ring_buffer_consume(tx, length);
+			serial_stats_write(&user_data->sim.base.stats, length);
+			user_data->sent = true;
+		}
+		if (user_data->sent && ring_buffer_available(tx) == 0) {
+			user_data->sent = false;
+			serial_port_emit_deferred(&user_data->sim.base, "write_completed", 0, NULL);
+		}
+
+		// A break goes on the line once what was written before it is through, and holds it that long
+		const uint32_t break_ms = serial_atomic_load_u32(&user_data->sim.base.break_ms);
+		if (break_ms != 0 && user_data->break_end_nsec == 0 && ring_buffer_available(tx) == 0 && user_data->tx_line_nsec <= now)
+			user_data->break_end_nsec = now + (int64_t) break_ms * 1000000;
+		if (user_data->break_end_nsec != 0 && user_data->break_end_nsec <= now) {
+			user_data->break_end_nsec = 0;
+			serial_port_complete_break(&user_data->sim.base, true);
+		}
+
+		if (_deliver(user_data, now) > 0)
+			serial_port_notify_received(&user_data->sim.base);
+		serial_port_expire_transaction(&user_data->sim.base);
+		if (user_data->sim.base.options.modem_events)
+			serial_port_report_modem_lines(&user_data->sim.base, _modem_lines(serial_atomic_load_u32(&user_data->sim.base.modem_outputs)));
+
+		// Bytes held back by flow control wait for the consumer to make room
+		int64_t wake_at = _next_arrival(user_data);
+		if (wake_at >= 0 && wake_at <= now && ring_buffer_free_space(&user_data->sim.base.rx) == 0 && user_data->sim.base.options.flow_control != SERIAL_FLOW_NONE) {
+			serial_port_pause_rx(&user_data->sim.base);
+			if (serial_atomic_load_u32(&user_data->sim.base.rx_paused))
+				wake_at = -1;
+		}
+
+		// Sleep until the next byte arrives, the line has room again or a transaction times out,
+		// unless a write comes first
+		const bool held = user_data->sim.base.options.flow_control != SERIAL_FLOW_NONE && ring_buffer_free_space(&user_data->wire) == 0;
+		if (ring_buffer_available(tx) > 0 && !held) {
+			// What the thread queued itself, a Modbus request, may find the line idle since long ago
+			const int64_t line_nsec = user_data->tx_line_nsec > now ? user_data->tx_line_nsec : now;
+			const int64_t room_at = line_nsec + user_data->byte_nsec - VIRTUAL_TX_AHEAD_NSEC;
+			if (wake_at < 0 || room_at < wake_at)
+				wake_at = room_at;
+		}
+		const int64_t deadline = serial_port_transaction_deadline(&user_data->sim.base);
+		if (deadline >= 0 && (wake_at < 0 || deadline * 1000 < wake_at))
+			wake_at = deadline * 1000;
+		if (serial_atomic_load_u32(&user_data->sim.base.break_ms) != 0 && (user_data->break_end_nsec != 0 || ring_buffer_available(tx) == 0)) {
+			const int64_t break_at = user_data->break_end_nsec != 0 ? user_data->break_end_nsec : user_data->tx_line_nsec;
+			if (wake_at < 0 || break_at < wake_at)
+				wake_at = break_at;
+		}
+		if (wake_at < 0) {
+			serial_event_wait(&user_data->sim.wake, -1);
+		} else {
+			const int64_t wait_nsec = wake_at - _now_nsec();
+			if (wait_nsec > 0)
+				serial_event_wait(&user_data->sim.wake, (wait_nsec + 999) / 1000);
+		}
+	}
+}
+
+static bool _start_device_thread(data_struct * user_data) {
+	// The first look, so whatever changes once the thread runs is announced
+	if (user_data->sim.base.options.modem_events)
+		serial_port_report_modem_lines(&user_data->sim.base, _modem_lines(user_data->sim.base.modem_outputs));
+	user_data->break_end_nsec = 0;
+	return serial_sim_start_thread(&user_data->sim);
+}
+
+static void _clear_responses(data_struct * user_data) {
+	for (int i = 0; i < user_data->num_responses; i++) {
+		api->godot_free(user_data->responses[i].request);
+		api->godot_free(user_data->responses[i].response);
+	}
+	user_data->num_responses = 0;
+}
+
+static void _close(data_struct * user_data) {
+	serial_sim_stop_thread(&user_data->sim);
+	_clear_responses(user_data);
+	ring_buffer_destroy(&user_data->wire);
+	user_data->num_segments = 0;
+	serial_hub_leave(&user_data->sim.base);
+}
+
+static GDCALLINGCONV void * constructor(godot_object *p_instance, void *p_method_data) {
+	data_struct *data = api->godot_alloc(sizeof(data_struct));
+	serial_sim_init(&data->sim, p_instance, "virtual device", _read_and_buffer, _device_main, _deliver_written);
+
+	data->num_responses = 0;
+	data->wire.data = NULL;
+	data->num_segments = 0;
+	data->break_end_nsec = 0;
+	data->parity_errors = 0;
+
+	return data;
+}
+
+static GDCALLINGCONV void destructor(godot_object *p_instance, void *p_method_data, void *p_user_data) {
+	data_struct *data = (data_struct *) p_user_data;
+	_close(data);
+	serial_port_destroy(&data->sim.base);
+	api->godot_free(p_user_data);
+}
+
+// Copies a String (as UTF-8) or PoolByteArray into memory of its own
+static bool _copy_bytes(const godot_variant *p_value, uint8_t **r_data, uint32_t *r_length) {
+	switch (api->godot_variant_get_type(p_value)) {
+	case GODOT_VARIANT_TYPE_STRING: {
+		godot_string str = api->godot_variant_as_string(p_value);
+		godot_char_string cstr = api->godot_string_utf8(&str);
+		*r_length = api->godot_char_string_length(&cstr);
+		*r_data = api->godot_alloc(*r_length > 0 ? *r_length : 1);
+		memcpy(*r_data, api->godot_char_string_get_data(&cstr), *r_length);
+		api->godot_char_string_destroy(&cstr);
+		api->godot_string_destroy(&str);
+		return true;
+	}
+	case GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY: {
+		godot_pool_byte_array bytes = api->godot_variant_as_pool_byte_array(p_value);
+		godot_pool_byte_array_read_access *access = api->godot_pool_byte_array_read(&bytes);
+		*r_length = api->godot_pool_byte_array_size(&bytes);
+		*r_data = api->godot_alloc(*r_length > 0 ? *r_length : 1);
+		memcpy(*r_data, api->godot_pool_byte_array_read_access_ptr(access), *r_length);
+		api->godot_pool_byte_array_read_access_destroy(access);
+		api->godot_pool_byte_array_destroy(&bytes);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+static bool _parse_responses(data_struct * user_data, const godot_variant *p_value) {
+	if (api->godot_variant_get_type(p_value) != GODOT_VARIANT_TYPE_DICTIONARY)
+		return false;
+
+	godot_dictionary responses = api->godot_variant_as_dictionary(p_value);
+	godot_array requests = api->godot_dictionary_keys(&responses);
+	const int num_requests = api->godot_array_size(&requests);
+	bool valid = num_requests <= VIRTUAL_MAX_RESPONSES;
+
+	for (int i = 0; i < num_requests && valid; i++) {
+		godot_variant request = api->godot_array_get(&requests, i);
+		godot_variant response = api->godot_dictionary_get(&responses, &request);
+		virtual_response *entry = &user_data->responses[user_data->num_responses];
+
+		if (_copy_bytes(&request, &entry->request, &entry->request_length)) {
+			if (entry->request_length > 0 && entry->request_length <= VIRTUAL_MAX_REQUEST / 2 && _copy_bytes(&response, &entry->response, &entry->response_length)) {
+				user_data->num_responses++;
+			} else {
+				api->godot_free(entry->request);
+				valid = false;
+			}
+		} else {
+			valid = false;
+		}
+		api->godot_variant_destroy(&response);
+		api->godot_variant_destroy(&request);
+	}
+
+	api->godot_array_destroy(&requests);
+	api->godot_dictionary_destroy(&responses);
+	return valid;
+}
+
+static bool _get_number(const godot_variant *p_value, double *r_number) {
+	switch (api->godot_variant_get_type(p_value)) {
+	case GODOT_VARIANT_TYPE_INT:
+		*r_number = api->godot_variant_as_int(p_value);
+		return true;
+	case GODOT_VARIANT_TYPE_REAL:
+		*r_number = api->godot_variant_as_real(p_value);
+		return true;
+	default:
+		return false;
+	}
+}
+
+// How long a byte takes on the line, and whether it carries a parity bit
+static void _set_line(data_struct * user_data, int p_baudrate, godot_serial_config p_config) {
+	// A start bit, the data bits, an optional parity bit and the stop bits
+	const int bitlength = (p_config & GODOT_SERIAL_BIT_LENGTH_MASK) >> 8;
+	const int parity = (p_config & GODOT_SERIAL_PARITY_MASK) >> 4;
+	const int stopbits = p_config & GODOT_SERIAL_STOP_BIT_MASK;
+	user_data->byte_nsec = (int64_t) (1 + bitlength + (parity != 0) + stopbits) * 1000000000 / p_baudrate;
+	if (user_data->byte_nsec < 1)
+		user_data->byte_nsec = 1;
+	user_data->parity = parity != 0;
+}
+
+// Sets the device up from the options only VirtualSerial understands
+static bool _configure(data_struct * user_data, const godot_variant *p_options, int p_baudrate, godot_serial_config p_config) {
+	_set_line(user_data, p_baudrate, p_config);
+
+	user_data->latency_nsec = 0;
+	user_data->chunk_size = 1;
+	user_data->error_threshold = 0;
+	user_data->random = 1;
+	user_data->parity_errors = 0;
+	user_data->request_length = 0;
+	user_data->tx_line_nsec = 0;
+	user_data->rx_line_nsec = 0;
+	user_data->first_segment = 0;
+	user_data->num_segments = 0;
+	user_data->sent = false;
+
+	godot_variant value;
+	double number;
+	bool valid = true;
+
+	if (serial_port_get_option(p_options, "latency_ms", &value)) {
+		if (_get_number(&value, &number) && number >= 0)
+			user_data->latency_nsec = (int64_t) (number * 1000000);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (serial_port_get_option(p_options, "chunk_size", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_INT && api->godot_variant_as_int(&value) >= 1 && api->godot_variant_as_int(&value) <= SERIAL_PORT_MAX_BUFFER_SIZE)
+			user_data->chunk_size = api->godot_variant_as_int(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (serial_port_get_option(p_options, "error_rate", &value)) {
+		if (_get_number(&value, &number) && number >= 0 && number <= 1)
+			user_data->error_threshold = number >= 1 ? UINT32_MAX : (uint32_t) (number * 4294967296.0);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	if (serial_port_get_option(p_options, "seed", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_INT)
+			user_data->random = (uint32_t) api->godot_variant_as_int(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+	// xorshift never leaves 0
+	if (user_data->random == 0)
+		user_data->random = 1;
+
+	if (serial_port_get_option(p_options, "responses", &value)) {
+		valid = _parse_responses(user_data, &value) && valid;
+		api->godot_variant_destroy(&value);
+	}
+
+	user_data->echo = user_data->num_responses == 0;
+	if (serial_port_get_option(p_options, "echo", &value)) {
+		if (api->godot_variant_get_type(&value) == GODOT_VARIANT_TYPE_BOOL)
+			user_data->echo = api->godot_variant_as_bool(&value);
+		else
+			valid = false;
+		api->godot_variant_destroy(&value);
+	}
+
+	return valid && ring_buffer_init(&user_data->wire, ring_buffer_capacity(&user_data->sim.base.rx));
+}
+
+static GDCALLINGCONV godot_variant open(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	bool success = false;
+	if (p_num_args >= 1) {
+		godot_string port_name_str = api->godot_variant_as_string(p_args[0]);
+
+		serial_port_settings settings;
+		bool valid = serial_port_parse_settings(p_num_args - 1, p_args + 1, &settings);
+
+		if (valid && api->godot_string_length(&port_name_str) > 0 && !user_data->sim.base.is_open) {
+			if (serial_port_prepare(&user_data->sim.base, &settings.options) && _configure(user_data, settings.options_arg, settings.baudrate, settings.config)
+					&& (!settings.options.threaded || _start_device_thread(user_data))) {
+				user_data->sim.base.is_open = true;
+				user_data->sim.base.config = settings.config;
+				user_data->sim.base.baudrate = settings.baudrate;
+				api->godot_string_destroy(&user_data->sim.base.port);
+				api->godot_string_new_copy(&user_data->sim.base.port, &port_name_str);
+
+				success = true;
+			} else {
+				_close(user_data);
+			}
+		}
+		api->godot_string_destroy(&port_name_str);
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant close(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	if (user_data->sim.base.is_open) {
+		// do close
+		_close(user_data);
+		user_data->sim.base.is_open = false;
+	}
+
+	api->godot_variant_new_bool(&ret, true);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant is_connected(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	api->godot_variant_new_bool(&ret, user_data->sim.base.is_open);
+	return ret;
+}
+
+// flush(timeout_ms): waits until everything written has gone down the line, as tcdrain() does,
+// but no longer than timeout_ms since flow control can hold it back for good. Returns whether it did.
+static GDCALLINGCONV godot_variant flush(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	bool drained = user_data->sim.base.is_open;
+
+	if (drained) {
+		const int timeout_ms = serial_port_parse_flush(&user_data->sim.base, p_num_args, p_args, serial_port_tx_pending(&user_data->sim.base));
+		if (user_data->sim.base.threaded) {
+			drained = serial_sim_wait_tx_empty(&user_data->sim, timeout_ms);
+		} else {
+			const int64_t left = user_data->tx_line_nsec - _now_nsec();
+			drained = left <= (int64_t) timeout_ms * 1000000;
+			if (left > 0)
+				serial_sleep_usec((drained ? left + 999 : (int64_t) timeout_ms * 1000000) / 1000);
+		}
+	}
+
+	api->godot_variant_new_bool(&ret, drained);
+	return ret;
+}
+
+// reconfigure(baudrate, config) or reconfigure(config: SerialConfig): bytes already on their way
+// are timed with the new settings from here on
+static GDCALLINGCONV godot_variant reconfigure(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	bool success = false;
+
+	serial_port_settings settings;
+	if (user_data->sim.base.is_open && serial_port_parse_settings(p_num_args, p_args, &settings)) {
+		// The device thread times every byte it moves, so it is paused meanwhile
+		const bool threaded = user_data->sim.base.threaded;
+		serial_sim_stop_thread(&user_data->sim);
+		_set_line(user_data, settings.baudrate, settings.config);
+		user_data->sim.base.baudrate = settings.baudrate;
+		user_data->sim.base.config = settings.config;
+		success = !threaded || _start_device_thread(user_data);
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static godot_variant _set_output(data_struct * user_data, serial_modem_line p_line, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	uint32_t outputs;
+
+	bool success = serial_port_parse_modem_output(&user_data->sim.base, p_line, p_num_args, p_args, &outputs);
+	if (success) {
+		serial_atomic_store_u32(&user_data->sim.base.modem_outputs, outputs);
+		// The device thread announces what the inputs do in turn
+		serial_sim_wake(&user_data->sim);
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// set_rts(level) and set_dtr(level): refused for the line the flow control of the port drives
+static GDCALLINGCONV godot_variant set_rts(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	return _set_output((data_struct *) p_user_data, SERIAL_MODEM_RTS, p_num_args, p_args);
+}
+
+static GDCALLINGCONV godot_variant set_dtr(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	return _set_output((data_struct *) p_user_data, SERIAL_MODEM_DTR, p_num_args, p_args);
+}
+
+// send_break(duration_ms = 250): the device pays breaks no attention, so this only takes as long
+// as one would: on the device thread of a threaded port, which emits break_completed, blocking
+// the caller of a polled one
+static GDCALLINGCONV godot_variant send_break(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	int duration_ms;
+
+	bool success = serial_port_parse_break(&user_data->sim.base, p_num_args, p_args, &duration_ms);
+	if (success && user_data->sim.base.threaded) {
+		success = serial_port_request_break(&user_data->sim.base, duration_ms);
+		if (success)
+			serial_sim_wake(&user_data->sim);
+	} else if (success) {
+		serial_sleep_usec((int64_t) duration_ms * 1000);
+	}
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant get_modem_lines(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	serial_port_modem_lines_to_variant(user_data->sim.base.is_open ? _modem_lines(user_data->sim.base.modem_outputs) : SERIAL_MODEM_UNKNOWN, &ret);
+	return ret;
+}
+
+// The simulated UART has nothing to report but the parity errors its bit flips cause
+static GDCALLINGCONV godot_variant get_stats(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	serial_line_errors line_errors = { 0 };
+	line_errors.parity_errors = serial_atomic_load_u64(&user_data->parity_errors);
+	serial_port_get_stats(&user_data->sim.base, &line_errors, &ret);
+	return ret;
+}
+
+godot_serial_interface godot_serial_virtual_implementation = {0x13,
+                                                              constructor, destructor,
+                                                              open, close, is_connected,
+                                                              serial_port_available_for_read, serial_sim_available_for_write,
+                                                              flush, serial_port_peek, serial_port_read, serial_port_read_string, serial_sim_write,
+                                                              serial_sim_set_timeout, serial_port_get_overflow_count,
+                                                              serial_port_read_bytes, serial_port_read_all,
+                                                              serial_port_read_line, serial_port_read_until,
+                                                              serial_port_read_packet, serial_sim_write_packet,
+                                                              serial_port_get_rejected_frames,
+                                                              serial_port_unpack, serial_sim_list_ports, get_stats,
+                                                              serial_port_read_with_timestamps, serial_sim_get_latency_settings, serial_sim_transact, serial_port_record, serial_sim_modbus_poll,
+                                                              reconfigure, set_rts, set_dtr, send_break, get_modem_lines,
+                                                              serial_port_dispatch_notifications, serial_sim_check_connection};
@@ -24,40 +24,221 @@
 
 #include "godot_serial.h"
 #include "serial_interface.h"
+#include "serial_port.h"
+#include "serial_hub.h"
+#include "serial_atomic.h"
+#include "serial_thread.h"
 #include <string.h>
 #include <windows.h>
+#include <setupapi.h>
+#include <cfgmgr32.h>
 #include <stdio.h>
+#include <stdlib.h>
 
+typedef struct data_struct data_struct;
+
+// What a packet posted to an I/O loop asks for
+enum {
+	IO_LOOP_WAKE,   // look at the transmit queue of the port, or start servicing it
+	IO_LOOP_DETACH, // let go of the port once its pending operations are back
+	IO_LOOP_EXPIRE, // the deadline of the port's transaction may have come
+	IO_LOOP_BREAK_END, // the break on the port's line has lasted long enough
+};
+
+// A thread servicing every port attached to it through a single I/O completion port:
+// either one port opened with "threaded", or all the ports of a SerialHub. Completion
+// keys are the ports; a packet with key 0 stops the loop.
 typedef struct {
-	bool is_open;
-	godot_serial_config config;
-	godot_string port;
-	int timeout;
-	
+	HANDLE hThread;
+	HANDLE hCompletionPort;
+} io_loop;
+
+struct data_struct {
+	serial_port base;
+
 	HANDLE hComm;
 
-	char read_buffer[256];
-	unsigned char read_ptr;
-	unsigned char write_ptr;
-} data_struct;
+	// I/O loop servicing the port while it is threaded: its own, or the one of its hub.
+	// The handle is then opened for overlapped I/O so reads and queued writes overlap.
+	io_loop own_loop;
+	io_loop *loop;
+	volatile uint32_t detached;
+	// Posts IO_LOOP_EXPIRE at the deadline of the port's transaction while it is threaded
+	PTP_TIMER transaction_timer;
+	// Posts IO_LOOP_BREAK_END once the break of send_break() is over, while it is threaded
+	PTP_TIMER break_timer;
+
+	// Only touched by the loop thread
+	OVERLAPPED read_ov;
+	OVERLAPPED write_ov;
+	OVERLAPPED event_ov; // WaitCommEvent() for line errors, and modem line changes with "modem_events"
+	DWORD event_mask;
+	bool reading;
+	bool writing;
+	bool waiting_event;
+	bool events_failed; // the driver cannot report line errors
+	bool dropping;  // the pending read goes to discard because rx is full
+	bool failed;    // reads stopped working, most likely because the device went away
+	bool sent;      // bytes went out since the queue was last empty
+	bool detaching;
+	bool breaking;  // the line is in the break state send_break() asked for
+	uint8_t discard[256];
+
+	// Line errors since open(), counted by the loop thread when threaded, on the game thread otherwise
+	volatile uint64_t frame_errors;
+	volatile uint64_t parity_errors;
+	volatile uint64_t overruns;
+	volatile uint64_t breaks;
+
+	// Next port opened with "reconnect", guarded by _enum_lock
+	data_struct *next_reconnecting;
+};
+
+typedef struct {
+	serial_hub base;
+	io_loop loop; // started along with the first port
+} hub_struct;
+
+static int _read_and_buffer(serial_port *p_port);
+static void _resume_rx(serial_port *p_port);
 
 static GDCALLINGCONV void * constructor(godot_object *p_instance, void *p_method_data) {
 	data_struct *data = api->godot_alloc(sizeof(data_struct));
-	data->is_open = false;
-	data->config = SERIAL_8N1;
-	api->godot_string_new(&data->port);
-	
+	serial_port_init(&data->base, p_instance, _read_and_buffer);
+	data->base.resume_rx = _resume_rx;
+
 	data->hComm = INVALID_HANDLE_VALUE;
-	
-	data->read_ptr = 0;
-	data->write_ptr = 0;
+
+	data->own_loop.hThread = NULL;
+	data->own_loop.hCompletionPort = NULL;
+	data->loop = NULL;
+	data->detached = 0;
+	data->transaction_timer = NULL;
+	data->break_timer = NULL;
+	// Looked at by close() even on a port that never had an I/O thread
+	data->reading = false;
+	data->writing = false;
+	data->waiting_event = false;
+	data->events_failed = false;
+	data->dropping = false;
+	data->failed = false;
+	data->sent = false;
+	data->detaching = false;
+	data->breaking = false;
+
+	data->frame_errors = 0;
+	data->parity_errors = 0;
+	data->overruns = 0;
+	data->breaks = 0;
+
+	data->next_reconnecting = NULL;
 
 	return data;
 }
 
+// Gives the I/O thread up to p_timeout_ms (forever if negative) to send everything queued
+static bool _wait_tx_empty(data_struct * user_data, int p_timeout_ms) {
+	for (int waited = 0; serial_port_tx_pending(&user_data->base) > 0; waited++) {
+		if (p_timeout_ms >= 0 && waited >= p_timeout_ms)
+			return false;
+		Sleep(1);
+	}
+	return true;
+}
+
+static DWORD WINAPI _loop_main(LPVOID p_data);
+
+static bool _loop_start(io_loop *p_loop) {
+	if (p_loop->hThread != NULL)
+		return true;
+
+	p_loop->hCompletionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	if (p_loop->hCompletionPort != NULL)
+		p_loop->hThread = CreateThread(NULL, 0, _loop_main, p_loop, 0, NULL);
+
+	if (p_loop->hThread == NULL) {
+		fprintf(stderr, "Error starting I/O thread: %i\n", GetLastError());
+		if (p_loop->hCompletionPort != NULL)
+			CloseHandle(p_loop->hCompletionPort);
+		p_loop->hCompletionPort = NULL;
+		return false;
+	}
+	return true;
+}
+
+static void _loop_stop(io_loop *p_loop) {
+	if (p_loop->hThread == NULL)
+		return;
+
+	PostQueuedCompletionStatus(p_loop->hCompletionPort, 0, 0, NULL);
+	WaitForSingleObject(p_loop->hThread, INFINITE);
+
+	CloseHandle(p_loop->hThread);
+	CloseHandle(p_loop->hCompletionPort);
+	p_loop->hThread = NULL;
+	p_loop->hCompletionPort = NULL;
+}
+
+static void _stop_io_thread(data_struct * user_data) {
+	if (user_data->transaction_timer != NULL) {
+		// Nothing may post for the port after the detach request
+		SetThreadpoolTimer(user_data->transaction_timer, NULL, 0, 0);
+		WaitForThreadpoolTimerCallbacks(user_data->transaction_timer, TRUE);
+		CloseThreadpoolTimer(user_data->transaction_timer);
+		user_data->transaction_timer = NULL;
+	}
+	if (user_data->break_timer != NULL) {
+		SetThreadpoolTimer(user_data->break_timer, NULL, 0, 0);
+		WaitForThreadpoolTimerCallbacks(user_data->break_timer, TRUE);
+		CloseThreadpoolTimer(user_data->break_timer);
+		user_data->break_timer = NULL;
+	}
+	if (user_data->loop != NULL) {
+		// Let queued writes go out before closing, without hanging on a stalled device
+		_wait_tx_empty(user_data, 250);
+
+		// The request is the last packet ever posted for the port. Cancelling again and
+		// again also catches an operation the loop started before it got there.
+		PostQueuedCompletionStatus(user_data->loop->hCompletionPort, IO_LOOP_DETACH, (ULONG_PTR) user_data, NULL);
+		while (!serial_atomic_load_u32(&user_data->detached)) {
+			CancelIoEx(user_data->hComm, NULL);
+			Sleep(1);
+		}
+		user_data->loop = NULL;
+	}
+	// A break cut short by close() is not reported; the line must not stay in it
+	if (user_data->breaking && user_data->hComm != INVALID_HANDLE_VALUE)
+		ClearCommBreak(user_data->hComm);
+	user_data->breaking = false;
+	user_data->base.break_ms = 0;
+	// Also covers a loop started for a port that then failed to join it
+	_loop_stop(&user_data->own_loop);
+	// Nothing is left to wake up once there is room
+	user_data->base.rx_paused = 0;
+	user_data->base.threaded = false;
+}
+
+// Lets go of the device, keeping everything needed to open it again
+static void _disconnect(data_struct * user_data) {
+	_stop_io_thread(user_data);
+	if (user_data->hComm != INVALID_HANDLE_VALUE) {
+		CloseHandle(user_data->hComm);
+		user_data->hComm = INVALID_HANDLE_VALUE;
+	}
+}
+
+static void _untrack_device(data_struct * user_data);
+
+static void _close(data_struct * user_data) {
+	_disconnect(user_data);
+	_untrack_device(user_data);
+	serial_hub_leave(&user_data->base);
+}
+
 static GDCALLINGCONV void destructor(godot_object *p_instance, void *p_method_data, void *p_user_data) {
 	data_struct *data = (data_struct *) p_user_data;
-	api->godot_string_destroy(&data->port);
+	_close(data);
+	serial_port_destroy(&data->base);
 	api->godot_free(p_user_data);
 }
 
@@ -83,7 +264,47 @@ static bool _set_timeouts(HANDLE hComm, int read_interval_to, int read_total_to_
 	return false;
 }
 
-static bool _open(data_struct * user_data, const char* port_name, int baudrate, godot_serial_config config) {
+// The line settings of the DCB, the flow control open() asked for, and RTS and DTR as p_outputs has them
+static bool _set_line(HANDLE hComm, int baudrate, godot_serial_config config, serial_flow_control flow_control, uint32_t p_outputs) {
+	DCB dcb;
+	if( !GetCommState(hComm, &dcb)) {
+		fprintf(stderr, "Error getting current DCB: %i\n", GetLastError());
+		return false;
+	}
+	
+	const int bitlength = (config & GODOT_SERIAL_BIT_LENGTH_MASK) >> 8;
+	const int parity = (config & GODOT_SERIAL_PARITY_MASK) >> 4;
+	const int stopbits = config & GODOT_SERIAL_STOP_BIT_MASK;
+	
+	dcb.BaudRate = baudrate;
+	dcb.ByteSize = bitlength;
+	dcb.fParity = parity != 0;
+	dcb.Parity = parity == 0 ? NOPARITY : parity == 3 ? ODDPARITY : EVENPARITY;
+	dcb.StopBits = stopbits == 2 ? TWOSTOPBITS : ONESTOPBIT;
+
+	// The driver holds our writes back on CTS, DSR or XOFF, and the device back on RTS, DTR or
+	// XOFF once its own buffer fills up. Otherwise RTS and DTR stay where set_rts() and set_dtr() put them.
+	dcb.fOutxCtsFlow = flow_control == SERIAL_FLOW_RTS_CTS;
+	dcb.fRtsControl = flow_control == SERIAL_FLOW_RTS_CTS ? RTS_CONTROL_HANDSHAKE : (p_outputs & SERIAL_MODEM_RTS) ? RTS_CONTROL_ENABLE : RTS_CONTROL_DISABLE;
+	dcb.fOutxDsrFlow = flow_control == SERIAL_FLOW_DTR_DSR;
+	dcb.fDtrControl = flow_control == SERIAL_FLOW_DTR_DSR ? DTR_CONTROL_HANDSHAKE : (p_outputs & SERIAL_MODEM_DTR) ? DTR_CONTROL_ENABLE : DTR_CONTROL_DISABLE;
+	dcb.fDsrSensitivity = FALSE;
+	dcb.fOutX = flow_control == SERIAL_FLOW_XON_XOFF;
+	dcb.fInX = flow_control == SERIAL_FLOW_XON_XOFF;
+	dcb.fTXContinueOnXoff = TRUE;
+	dcb.XonChar = 0x11;
+	dcb.XoffChar = 0x13;
+	dcb.XonLim = 2048;
+	dcb.XoffLim = 512;
+
+	if( SetCommState(hComm, &dcb) == 0 ) {
+		fprintf(stderr, "Error setting DCB (control bits): %03X: %i\n", config, GetLastError());
+		return false;
+	}
+	return true;
+}
+
+static bool _open(data_struct * user_data, const char* port_name, int baudrate, godot_serial_config config, serial_flow_control flow_control, uint32_t outputs, bool overlapped) {
 	HANDLE hComm;
 	hComm = CreateFile(
 	                  port_name,
@@ -91,7 +312,7 @@ static bool _open(data_struct * user_data, const char* port_name, int baudrate,
 	                  0, // No sharing
 	                  NULL,
 	                  OPEN_EXISTING,
-	                  0, // No overlapped : synchronous reading
+	                  overlapped ? FILE_FLAG_OVERLAPPED : 0, // synchronous reading unless the I/O thread does it
 	                  NULL //It must be NULL for COM.
 	);
 
@@ -101,31 +322,510 @@ static bool _open(data_struct * user_data, const char* port_name, int baudrate,
 	}
 	user_data->hComm = hComm;
 
-	DCB dcb;
-	if( !GetCommState(hComm, &dcb)) {
-		fprintf(stderr, "Error getting current DCB: %i\n", GetLastError());
+	if (!_set_line(hComm, baudrate, config, flow_control, outputs)) {
+		_disconnect(user_data);
 		return false;
 	}
+
+	if (overlapped) {
+		// Complete a read as soon as at least one byte is there, waking up every 100 ms otherwise
+		_set_timeouts(hComm, MAXDWORD, MAXDWORD, 100);
+	} else {
+		_set_timeouts(hComm, 1, 0, 50);
+	}
 	
-	const int bitlength = (config & GODOT_SERIAL_BIT_LENGTH_MASK) >> 8;
-	const int parity = (config & GODOT_SERIAL_PARITY_MASK) >> 4;
-	const int stopbits = config & GODOT_SERIAL_STOP_BIT_MASK;
-	
-	dcb.BaudRate = baudrate;// CBR_19200;
-	dcb.ByteSize = bitlength;
-	dcb.Parity = parity == 0 ? NOPARITY : parity == 1 ? ODDPARITY : EVENPARITY;
-	dcb.StopBits = stopbits == 1 ? ONESTOPBIT : stopbits == 2 ? TWOSTOPBITS : ONE5STOPBITS;
+	return true;
+}
 
-	if( SetCommState(hComm, &dcb) == 0 ) {
-		fprintf(stderr, "Error setting DCB (control bits): %03X: %i\n", config, GetLastError());
+// Clears the error state of the port, counting what it reports. Returns false if the driver cannot tell.
+static bool _clear_errors(data_struct * user_data) {
+	DWORD errors = 0;
+	if (!ClearCommError(user_data->hComm, &errors, NULL))
 		return false;
+	if (errors & CE_FRAME)
+		serial_atomic_add_u64(&user_data->frame_errors, 1);
+	if (errors & CE_RXPARITY)
+		serial_atomic_add_u64(&user_data->parity_errors, 1);
+	if (errors & (CE_OVERRUN | CE_RXOVER))
+		serial_atomic_add_u64(&user_data->overruns, 1);
+	if (errors & CE_BREAK)
+		serial_atomic_add_u64(&user_data->breaks, 1);
+	return true;
+}
+
+static uint32_t _modem_lines(data_struct * user_data, DWORD p_status) {
+	// The driver does not tell where RTS and DTR are, so they are reported as last set
+	return (p_status & MS_CTS_ON ? SERIAL_MODEM_CTS : 0) | (p_status & MS_DSR_ON ? SERIAL_MODEM_DSR : 0) |
+	       (p_status & MS_RLSD_ON ? SERIAL_MODEM_DCD : 0) | (p_status & MS_RING_ON ? SERIAL_MODEM_RI : 0) |
+	       serial_atomic_load_u32(&user_data->base.modem_outputs);
+}
+
+// Announces what the modem lines changed to, for a port opened with "modem_events"
+static void _report_modem_lines(data_struct * user_data) {
+	DWORD status;
+	if (GetCommModemStatus(user_data->hComm, &status))
+		serial_port_report_modem_lines(&user_data->base, _modem_lines(user_data, status));
+}
+
+// Waits for the driver to report a line error, a break or, with "modem_events", a modem line change
+static void _start_wait_event(data_struct * user_data) {
+	memset(&user_data->event_ov, 0, sizeof(user_data->event_ov));
+	if (WaitCommEvent(user_data->hComm, &user_data->event_mask, &user_data->event_ov) || GetLastError() == ERROR_IO_PENDING)
+		user_data->waiting_event = true;
+	else
+		user_data->events_failed = true;
+}
+
+// Starts an overlapped read straight into the free space of rx, or into discard
+// when the consumer fell behind and there is none. With flow control it waits for
+// room instead, leaving the rest to the driver.
+static void _start_read(data_struct * user_data) {
+	uint8_t *dst;
+	DWORD length = ring_buffer_write_region(&user_data->base.rx, &dst);
+	if (length == 0 && user_data->base.options.flow_control != SERIAL_FLOW_NONE) {
+		serial_port_pause_rx(&user_data->base);
+		if (serial_atomic_load_u32(&user_data->base.rx_paused))
+			return;
+		length = ring_buffer_write_region(&user_data->base.rx, &dst);
+	}
+	user_data->dropping = length == 0;
+	if (user_data->dropping) {
+		dst = user_data->discard;
+		length = sizeof(user_data->discard);
 	}
 
-	_set_timeouts(hComm, 1, 0, 50);
-	
+	// Completes through the completion port even when it finishes right away
+	memset(&user_data->read_ov, 0, sizeof(user_data->read_ov));
+	if (ReadFile(user_data->hComm, dst, length, NULL, &user_data->read_ov) || GetLastError() == ERROR_IO_PENDING) {
+		user_data->reading = true;
+	} else {
+		fprintf(stderr, "Error reading from port: %i\n", GetLastError());
+		user_data->failed = true;
+	}
+}
+
+// Starts an overlapped write of the first contiguous region of tx, so everything
+// queued since the last write goes out in one call
+static void _start_write(data_struct * user_data) {
+	const uint8_t *src;
+	DWORD length = ring_buffer_read_region(&user_data->base.tx, &src);
+	if (length == 0)
+		return;
+
+	memset(&user_data->write_ov, 0, sizeof(user_data->write_ov));
+	if (WriteFile(user_data->hComm, src, length, NULL, &user_data->write_ov) || GetLastError() == ERROR_IO_PENDING) {
+		user_data->writing = true;
+	} else {
+		fprintf(stderr, "Error writing to port: %i\n", GetLastError());
+		ring_buffer_consume(&user_data->base.tx, ring_buffer_available(&user_data->base.tx));
+	}
+}
+
+// Keeps a read and, while anything is queued, a write pending for the port. Once it is
+// being detached nothing new starts, and it is let go when the last operation is back.
+// Starts the break send_break() asked for once everything queued before it has been sent, and has
+// the break timer end it
+static void _service_break(data_struct * user_data) {
+	const uint32_t duration_ms = serial_atomic_load_u32(&user_data->base.break_ms);
+	if (duration_ms == 0 || user_data->breaking || user_data->writing || ring_buffer_available(&user_data->base.tx) > 0)
+		return;
+
+	if (!SetCommBreak(user_data->hComm)) {
+		fprintf(stderr, "Error sending break: %i\n", GetLastError());
+		serial_port_complete_break(&user_data->base, false);
+		return;
+	}
+	user_data->breaking = true;
+	// Negative due times are relative, in 100 ns units
+	ULARGE_INTEGER due;
+	due.QuadPart = (ULONGLONG) -((LONGLONG) duration_ms * 10000);
+	FILETIME due_time;
+	due_time.dwLowDateTime = due.LowPart;
+	due_time.dwHighDateTime = due.HighPart;
+	SetThreadpoolTimer(user_data->break_timer, &due_time, 0, 0);
+}
+
+static void _service(data_struct * user_data) {
+	if (user_data->detaching) {
+		if (!user_data->reading && !user_data->writing && !user_data->waiting_event)
+			serial_atomic_store_u32(&user_data->detached, 1);
+		return;
+	}
+
+	if (!user_data->reading && !user_data->failed && !serial_atomic_load_u32(&user_data->base.rx_paused))
+		_start_read(user_data);
+	if (!user_data->waiting_event && !user_data->events_failed)
+		_start_wait_event(user_data);
+	if (!user_data->writing) {
+		// Anything queued after this point comes with a new wake-up
+		serial_port_clear_wake(&user_data->base);
+		_start_write(user_data);
+		if (!user_data->writing && user_data->sent) {
+			user_data->sent = false;
+			serial_port_emit_deferred(&user_data->base, "write_completed", 0, NULL);
+		}
+	}
+	_service_break(user_data);
+}
+
+// The consumer made room in rx for the read _start_read() held back
+static void _resume_rx(serial_port *p_port) {
+	data_struct * user_data = (data_struct *) p_port;
+	PostQueuedCompletionStatus(user_data->loop->hCompletionPort, IO_LOOP_WAKE, (ULONG_PTR) user_data, NULL);
+}
+
+static VOID CALLBACK _break_timer_callback(PTP_CALLBACK_INSTANCE p_instance, PVOID p_context, PTP_TIMER p_timer) {
+	data_struct * user_data = (data_struct *) p_context;
+	PostQueuedCompletionStatus(user_data->loop->hCompletionPort, IO_LOOP_BREAK_END, (ULONG_PTR) user_data, NULL);
+}
+
+static VOID CALLBACK _transaction_timer_callback(PTP_CALLBACK_INSTANCE p_instance, PVOID p_context, PTP_TIMER p_timer) {
+	data_struct * user_data = (data_struct *) p_context;
+	PostQueuedCompletionStatus(user_data->loop->hCompletionPort, IO_LOOP_EXPIRE, (ULONG_PTR) user_data, NULL);
+}
+
+// Has the timer go off at the deadline of the waiting transaction, if any. Called again by the
+// I/O thread every time it does, so one that went off early, or for an earlier transaction, is
+// set again for what is left.
+static void _arm_transaction_timer(data_struct * user_data) {
+	const int64_t deadline = serial_port_transaction_deadline(&user_data->base);
+	if (deadline < 0)
+		return;
+
+	// Negative due times are relative, in 100 ns units
+	int64_t remaining = deadline - serial_time_usec();
+	ULARGE_INTEGER due;
+	due.QuadPart = (ULONGLONG) -(remaining > 0 ? remaining * 10 : 1);
+	FILETIME due_time;
+	due_time.dwLowDateTime = due.LowPart;
+	due_time.dwHighDateTime = due.HighPart;
+	SetThreadpoolTimer(user_data->transaction_timer, &due_time, 0, 0);
+}
+
+static DWORD WINAPI _loop_main(LPVOID p_data) {
+	io_loop *loop = (io_loop *) p_data;
+
+	for (;;) {
+		DWORD dwDone = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED *ov = NULL;
+		const BOOL ok = GetQueuedCompletionStatus(loop->hCompletionPort, &dwDone, &key, &ov, INFINITE);
+		const DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+		if (ov == NULL && (!ok || key == 0)) {
+			if (!ok)
+				fprintf(stderr, "Error waiting for port events: %i\n", error);
+			break;
+		}
+
+		data_struct * user_data = (data_struct *) key;
+		if (ov == &user_data->read_ov) {
+			user_data->reading = false;
+			if (!ok) {
+				if (error != ERROR_OPERATION_ABORTED) {
+					fprintf(stderr, "Error reading from port: %i\n", error);
+					user_data->failed = true;
+				}
+			} else if (user_data->dropping) {
+				serial_port_count_overflow(&user_data->base, dwDone);
+			} else if (dwDone > 0) {
+				// The read went to the start of the free space, which nothing else moves
+				uint8_t *dst;
+				ring_buffer_write_region(&user_data->base.rx, &dst);
+				serial_port_log_traffic(&user_data->base, false, dst, dwDone);
+				ring_buffer_commit(&user_data->base.rx, dwDone);
+				serial_port_notify_received(&user_data->base);
+				// What came in may have moved the deadline of a Modbus poll
+				_arm_transaction_timer(user_data);
+			}
+			serial_stats_read(&user_data->base.stats, &user_data->base.rx, ok && !user_data->dropping ? dwDone : 0);
+		} else if (ov == &user_data->write_ov) {
+			user_data->writing = false;
+			serial_stats_write(&user_data->base.stats, ok ? dwDone : 0);
+			if (ok) {
+				const uint8_t *src;
+				ring_buffer_read_region(&user_data->base.tx, &src);
+				serial_port_log_traffic(&user_data->base, true, src, dwDone);
+				ring_buffer_consume(&user_data->base.tx, dwDone);
+				user_data->sent = true;
+			} else {
+				if (error != ERROR_OPERATION_ABORTED)
+					fprintf(stderr, "Error writing to port: %i\n", error);
+				ring_buffer_consume(&user_data->base.tx, ring_buffer_available(&user_data->base.tx));
+			}
+		} else if (ov == &user_data->event_ov) {
+			user_data->waiting_event = false;
+			if (ok) {
+				if (user_data->event_mask & (EV_ERR | EV_BREAK))
+					_clear_errors(user_data);
+				if (user_data->event_mask & (EV_CTS | EV_DSR | EV_RLSD | EV_RING))
+					_report_modem_lines(user_data);
+			} else if (error != ERROR_OPERATION_ABORTED) {
+				user_data->events_failed = true;
+			}
+		} else if (dwDone == IO_LOOP_DETACH) {
+			user_data->detaching = true;
+		} else if (dwDone == IO_LOOP_EXPIRE) {
+			serial_port_expire_transaction(&user_data->base);
+			_arm_transaction_timer(user_data);
+		} else if (dwDone == IO_LOOP_BREAK_END) {
+			ClearCommBreak(user_data->hComm);
+			user_data->breaking = false;
+			serial_port_complete_break(&user_data->base, true);
+		} else if (dwDone == IO_LOOP_WAKE) {
+			// A Modbus poll may have started, with a deadline to wake up for
+			_arm_transaction_timer(user_data);
+		}
+		_service(user_data);
+	}
+	return 0;
+}
+
+// Hands the port over to its hub's I/O loop, or to a loop of its own
+static bool _start_io_thread(data_struct * user_data) {
+	io_loop *loop = user_data->base.hub != NULL ? &((hub_struct *) user_data->base.hub)->loop : &user_data->own_loop;
+	if (!_loop_start(loop))
+		return false;
+
+	if (CreateIoCompletionPort(user_data->hComm, loop->hCompletionPort, (ULONG_PTR) user_data, 0) == NULL) {
+		fprintf(stderr, "Error watching port: %i\n", GetLastError());
+		return false;
+	}
+	user_data->transaction_timer = CreateThreadpoolTimer(_transaction_timer_callback, user_data, NULL);
+	if (user_data->transaction_timer == NULL) {
+		fprintf(stderr, "Error creating transaction timer: %i\n", GetLastError());
+		return false;
+	}
+	user_data->break_timer = CreateThreadpoolTimer(_break_timer_callback, user_data, NULL);
+	if (user_data->break_timer == NULL) {
+		fprintf(stderr, "Error creating break timer: %i\n", GetLastError());
+		return false;
+	}
+
+	user_data->reading = false;
+	user_data->writing = false;
+	user_data->waiting_event = false;
+	user_data->events_failed = false;
+	user_data->failed = false;
+	user_data->sent = false;
+	user_data->detaching = false;
+	user_data->breaking = false;
+	user_data->detached = 0;
+	user_data->loop = loop;
+	user_data->base.threaded = true;
+
+	// Events raised from here on are waited for alongside the reads, so no change after this first look goes unseen
+	SetCommMask(user_data->hComm, EV_ERR | EV_BREAK | (user_data->base.options.modem_events ? EV_CTS | EV_DSR | EV_RLSD | EV_RING : 0));
+	if (user_data->base.options.modem_events)
+		_report_modem_lines(user_data);
+
+	// The loop starts the first read
+	PostQueuedCompletionStatus(loop->hCompletionPort, IO_LOOP_WAKE, (ULONG_PTR) user_data, NULL);
 	return true;
 }
 
+// Port enumeration: a cache of the COM port interfaces SetupAPI knows about, built on
+// first use and rebuilt whenever the configuration manager reports one arriving or
+// leaving, so neither list_ports() nor reconnecting ports query it between hotplug events.
+static SRWLOCK _enum_lock = SRWLOCK_INIT;
+static serial_port_list _enum_ports;
+static bool _enum_started = false;
+static HCMNOTIFICATION _hotplug_notification = NULL;
+static data_struct *_reconnecting = NULL;
+
+// GUID_DEVINTERFACE_COMPORT, spelled out to spare including initguid.h
+static const GUID _comport_interface = { 0x86e0d1e0, 0x8089, 0x11d0, { 0x9c, 0xe4, 0x08, 0x00, 0x3e, 0x30, 0x1f, 0x73 } };
+
+// Instance ids look like USB\VID_0403&PID_6001\A50285BI, or FTDIBUS\VID_0403+PID_6001+A50285BIA\0000
+// for ports behind a vendor driver. The last part of a USB id is only a serial number when the
+// device reports one; Windows makes one up otherwise, and those always contain an '&'.
+static void _parse_instance_id(const char *p_id, serial_port_info *r_info) {
+	const char *vid = strstr(p_id, "VID_");
+	const char *pid = strstr(p_id, "PID_");
+	if (vid != NULL && pid != NULL) {
+		r_info->vid = strtol(vid + 4, NULL, 16);
+		r_info->pid = strtol(pid + 4, NULL, 16);
+	}
+
+	const char *serial = strrchr(p_id, '\\');
+	if (strncmp(p_id, "USB\\", 4) == 0 && serial != NULL && strchr(serial, '&') == NULL)
+		snprintf(r_info->serial_number, sizeof(r_info->serial_number), "%s", serial + 1);
+}
+
+// Rebuilds the cache from scratch; called with _enum_lock held
+static void _enum_scan(void) {
+	serial_enum_clear(&_enum_ports);
+
+	HDEVINFO devices = SetupDiGetClassDevsA(&_comport_interface, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+	if (devices == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Error listing ports: %i\n", GetLastError());
+		return;
+	}
+
+	SP_DEVINFO_DATA device;
+	device.cbSize = sizeof(device);
+	for (DWORD i = 0; SetupDiEnumDeviceInfo(devices, i, &device); i++) {
+		serial_port_info info;
+		memset(&info, 0, sizeof(info));
+		info.vid = -1;
+		info.pid = -1;
+
+		HKEY key = SetupDiOpenDevRegKey(devices, &device, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
+		if (key == INVALID_HANDLE_VALUE)
+			continue;
+		DWORD size = sizeof(info.path) - 1;
+		LONG status = RegQueryValueExA(key, "PortName", NULL, NULL, (BYTE *) info.path, &size);
+		RegCloseKey(key);
+		if (status != ERROR_SUCCESS)
+			continue;
+
+		SetupDiGetDeviceRegistryPropertyA(devices, &device, SPDRP_SERVICE, NULL, (BYTE *) info.driver, sizeof(info.driver) - 1, NULL);
+
+		char id[256];
+		if (SetupDiGetDeviceInstanceIdA(devices, &device, id, sizeof(id), NULL))
+			_parse_instance_id(id, &info);
+
+		serial_enum_add(&_enum_ports, &info);
+	}
+	SetupDiDestroyDeviceInfoList(devices);
+}
+
+static DWORD CALLBACK _hotplug_callback(HCMNOTIFICATION p_notification, PVOID p_context, CM_NOTIFY_ACTION p_action, PCM_NOTIFY_EVENT_DATA p_event, DWORD p_event_size) {
+	if (p_action != CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL && p_action != CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL)
+		return ERROR_SUCCESS;
+
+	AcquireSRWLockExclusive(&_enum_lock);
+	_enum_scan();
+	// Each reconnecting port sorts itself out on the main thread
+	for (data_struct *port = _reconnecting; port != NULL; port = port->next_reconnecting)
+		serial_port_call_deferred(&port->base, "_check_connection");
+	ReleaseSRWLockExclusive(&_enum_lock);
+	return ERROR_SUCCESS;
+}
+
+// Builds the cache and starts tracking hotplug events; called with _enum_lock held
+static void _enum_start(void) {
+	if (_enum_started)
+		return;
+	_enum_started = true;
+
+	// Register first, so no device slips in between the scan and the first notification
+	CM_NOTIFY_FILTER filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.cbSize = sizeof(filter);
+	filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+	filter.u.DeviceInterface.ClassGuid = _comport_interface;
+	CONFIGRET status = CM_Register_Notification(&filter, NULL, _hotplug_callback, &_hotplug_notification);
+	if (status != CR_SUCCESS) {
+		fprintf(stderr, "Error tracking hotplug events, the port list will not change: %i\n", status);
+		_hotplug_notification = NULL;
+	}
+
+	_enum_scan();
+}
+
+void godot_serial_terminate(void) {
+	// Waits for a callback in progress, which takes _enum_lock itself
+	if (_hotplug_notification != NULL) {
+		CM_Unregister_Notification(_hotplug_notification);
+		_hotplug_notification = NULL;
+	}
+	_enum_started = false;
+}
+
+// Remembers which device the port was opened on, so it can be found again after being unplugged
+static void _track_device(data_struct * user_data, const char *p_path) {
+	AcquireSRWLockExclusive(&_enum_lock);
+	_enum_start();
+
+	// \\.\COM10 names the same port as COM10
+	if (strncmp(p_path, "\\\\.\\", 4) == 0)
+		p_path += 4;
+
+	const serial_port_info *info = serial_enum_find(&_enum_ports, p_path);
+	if (info != NULL) {
+		user_data->base.device = *info;
+	} else {
+		memset(&user_data->base.device, 0, sizeof(user_data->base.device));
+		snprintf(user_data->base.device.path, sizeof(user_data->base.device.path), "%s", p_path);
+		user_data->base.device.vid = -1;
+		user_data->base.device.pid = -1;
+	}
+
+	user_data->next_reconnecting = _reconnecting;
+	_reconnecting = user_data;
+	ReleaseSRWLockExclusive(&_enum_lock);
+}
+
+static void _untrack_device(data_struct * user_data) {
+	AcquireSRWLockExclusive(&_enum_lock);
+	for (data_struct **port = &_reconnecting; *port != NULL; port = &(*port)->next_reconnecting) {
+		if (*port == user_data) {
+			*port = user_data->next_reconnecting;
+			break;
+		}
+	}
+	user_data->next_reconnecting = NULL;
+	ReleaseSRWLockExclusive(&_enum_lock);
+}
+
+static bool _reconnect(data_struct * user_data) {
+	// The long form is the only one that reaches COM10 and up
+	char port_name[sizeof(user_data->base.device.path) + 4];
+	snprintf(port_name, sizeof(port_name), "\\\\.\\%s", user_data->base.device.path);
+	if (!_open(user_data, port_name, user_data->base.baudrate, user_data->base.config, user_data->base.options.flow_control, user_data->base.modem_outputs, user_data->base.options.threaded))
+		return false;
+
+	// Whatever was queued for the old connection went nowhere
+	ring_buffer_clear(&user_data->base.tx);
+	user_data->base.tx_wake_pending = 0;
+	if (user_data->base.options.threaded && !_start_io_thread(user_data)) {
+		_disconnect(user_data);
+		return false;
+	}
+	return true;
+}
+
+static GDCALLINGCONV godot_variant list_ports(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	godot_array ports;
+
+	AcquireSRWLockExclusive(&_enum_lock);
+	_enum_start();
+	serial_enum_to_array(&_enum_ports, &ports);
+	ReleaseSRWLockExclusive(&_enum_lock);
+
+	api->godot_variant_new_array(&ret, &ports);
+	api->godot_array_destroy(&ports);
+	return ret;
+}
+
+static GDCALLINGCONV godot_variant check_connection(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	if (user_data->base.is_open && user_data->base.options.reconnect) {
+		AcquireSRWLockExclusive(&_enum_lock);
+		const serial_port_info *info = serial_enum_find_device(&_enum_ports, &user_data->base.device);
+		serial_port_info found;
+		if (info != NULL)
+			found = *info;
+		ReleaseSRWLockExclusive(&_enum_lock);
+
+		// Gone, or already back under another name after a quick replug
+		if (!user_data->base.lost && (info == NULL || strcmp(found.path, user_data->base.device.path) != 0)) {
+			_disconnect(user_data);
+			user_data->base.lost = true;
+		}
+		if (user_data->base.lost && info != NULL) {
+			user_data->base.device = found;
+			user_data->base.lost = !_reconnect(user_data);
+		}
+	}
+
+	api->godot_variant_new_nil(&ret);
+	return ret;
+}
+
 static GDCALLINGCONV godot_variant open(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
 	godot_variant ret;
 	data_struct * user_data = (data_struct *) p_user_data;
@@ -135,50 +835,29 @@ static GDCALLINGCONV godot_variant open(godot_object *p_instance, void *p_method
 		godot_string port_name_str = api->godot_variant_as_string(p_args[0]);
 		godot_char_string port_name_ascii_str = api->godot_string_ascii(&port_name_str);
 		
-		int baudrate = CBR_19200;
-		if (p_num_args >= 2){
-			if (api->godot_variant_get_type(p_args[1]) == GODOT_VARIANT_TYPE_INT) {
-				baudrate = api->godot_variant_as_int(p_args[1]);
-			} else {
-				baudrate = 0;
-			}
-		}
-		
-		godot_serial_config port_config = SERIAL_8N1;
-		if (p_num_args >= 3) {
-			if (api->godot_variant_get_type(p_args[2]) == GODOT_VARIANT_TYPE_INT) {
-				port_config = api->godot_variant_as_int(p_args[2]);
-			} else if (api->godot_variant_get_type(p_args[2]) == GODOT_VARIANT_TYPE_STRING) {
-				godot_string port_config_str = api->godot_variant_as_string(p_args[2]);
-				godot_char_string port_config_ascii_str = api->godot_string_ascii(&port_config_str);
-				if (api->godot_char_string_length(&port_config_ascii_str) != 3) {
-					port_config = 0;
+		serial_port_settings settings;
+		bool valid = serial_port_parse_settings(p_num_args - 1, p_args + 1, &settings);
+
+		if (valid && api->godot_char_string_length(&port_name_ascii_str) > 0 && !user_data->base.is_open) {
+			const char *port_name_ascii_str_buffer = api->godot_char_string_get_data(&port_name_ascii_str);
+			user_data->frame_errors = 0;
+			user_data->parity_errors = 0;
+			user_data->overruns = 0;
+			user_data->breaks = 0;
+			if (_open(user_data, port_name_ascii_str_buffer, settings.baudrate, settings.config, settings.options.flow_control, SERIAL_MODEM_RTS | SERIAL_MODEM_DTR, settings.options.threaded)) {
+				if (serial_port_prepare(&user_data->base, &settings.options) && (!settings.options.threaded || _start_io_thread(user_data))) {
+					user_data->base.is_open = true;
+					user_data->base.config = settings.config;
+					user_data->base.baudrate = settings.baudrate;
+					if (settings.options.reconnect)
+						_track_device(user_data, port_name_ascii_str_buffer);
+					api->godot_string_destroy(&user_data->base.port);
+					api->godot_string_new_copy(&user_data->base.port, &port_name_str);
+					
+					success = true;
 				} else {
-					const char *ascii_data = api->godot_char_string_get_data(&port_config_ascii_str);
-					port_config  =  (ascii_data[2] - '0')         & 0x000f;
-					port_config |= ((ascii_data[0] - '0') << 16) && 0x0f00;
-					if (ascii_data[1] == 'O' || ascii_data[1] == 'o')
-						port_config |= 0x030;
-					else if (ascii_data[1] == 'E' || ascii_data[1] == 'e')
-						port_config |= 0x020;
-					else if (ascii_data[1] != 'N' && ascii_data[1] != 'n') // last valid option
-						port_config = 0;
+					_close(user_data);
 				}
-				api->godot_char_string_destroy(&port_config_ascii_str);
-				api->godot_string_destroy(&port_config_str);
-			} else {
-				port_config = 0;
-			}
-		}
-		
-		if (baudrate != 0 && port_config != 0 && api->godot_char_string_length(&port_name_ascii_str) > 0 && !user_data->is_open) {
-			const char *port_name_ascii_str_buffer = api->godot_char_string_get_data(&port_name_ascii_str);
-			if (_open(user_data, port_name_ascii_str_buffer, baudrate, port_config)) {
-				user_data->is_open = true;
-				user_data->config = SERIAL_8N1;
-				api->godot_string_new_copy(&user_data->port, &port_name_str);
-				
-				success = true;
 			}
 		}
 		api->godot_char_string_destroy(&port_name_ascii_str);
@@ -193,10 +872,10 @@ static GDCALLINGCONV godot_variant close(godot_object *p_instance, void *p_metho
 	godot_variant ret;
 	data_struct * user_data = (data_struct *) p_user_data;
 	
-	if (user_data->is_open) {
+	if (user_data->base.is_open) {
 		// do close
-		CloseHandle(user_data->hComm);
-		user_data->is_open = false;
+		_close(user_data);
+		user_data->base.is_open = false;
 	}
 	
 	api->godot_variant_new_bool(&ret, true);
@@ -207,235 +886,239 @@ static GDCALLINGCONV godot_variant is_connected(godot_object *p_instance, void *
 	godot_variant ret;
 	data_struct * user_data = (data_struct *) p_user_data;
 	
-	api->godot_variant_new_bool(&ret, user_data->is_open);
-	return ret;
-}
-
-static int _available_for_read(const data_struct * user_data) {
-	int val;
-	if (user_data->write_ptr >= user_data->read_ptr)
-		val = user_data->write_ptr - user_data->read_ptr;
-	else
-		val = 256 - user_data->read_ptr + user_data->write_ptr;
-	return val;
-}
-
-static GDCALLINGCONV godot_variant available_for_read(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
-	godot_variant ret;
-	data_struct * user_data = (data_struct *) p_user_data;
-
-	int val = _available_for_read(user_data);
-	
-	api->godot_variant_new_int(&ret, val);
+	api->godot_variant_new_bool(&ret, user_data->base.is_open && !user_data->base.lost);
 	return ret;
 }
 
 static GDCALLINGCONV godot_variant available_for_write(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
 	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
 	
-	api->godot_variant_new_int(&ret, 256);
+	// Without the I/O thread writes go straight to the port
+	if (user_data->base.threaded)
+		api->godot_variant_new_int(&ret, serial_port_tx_free_space(&user_data->base));
+	else
+		api->godot_variant_new_int(&ret, ring_buffer_capacity(&user_data->base.tx));
 	return ret;
 }
 
 
+// flush(timeout_ms): waits for everything written to go out, but no longer than timeout_ms since
+// flow control can hold it back for good. Returns whether it did.
 static GDCALLINGCONV godot_variant flush(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
 	godot_variant ret;
 	data_struct * user_data = (data_struct *) p_user_data;
+	bool drained = false;
 	
-	FlushFileBuffers(user_data->hComm);
+	if (user_data->base.is_open) {
+		// A write completes once the driver has sent it, so only the queue is left to wait for
+		const int timeout_ms = serial_port_parse_flush(&user_data->base, p_num_args, p_args, serial_port_tx_pending(&user_data->base));
+		drained = !user_data->base.threaded || _wait_tx_empty(user_data, timeout_ms);
+		if (drained)
+			FlushFileBuffers(user_data->hComm);
+	}
 
-	api->godot_variant_new_nil(&ret);
+	api->godot_variant_new_bool(&ret, drained);
 	return ret;
 }
 
-static int _read_and_buffer(data_struct * user_data) {
-	int val;
-	DWORD dwRead1 = 0;
-	DWORD dwRead2 = 0;
+// Synchronous read straight into the free space of rx, in at most two chunks
+// when that space wraps around. Returns the bytes buffered, or -1 on error.
+static int _read_and_buffer(serial_port *p_port) {
+	data_struct * user_data = (data_struct *) p_port;
+	int total = 0;
 
-	if (256 - _available_for_read(user_data) <= 0) { // buffer is full
-		return -1;
-	}
-	if (user_data->write_ptr >= user_data->read_ptr) {
-		int first_try_length = 256 - user_data->write_ptr;
-		if (FALSE == ReadFile(user_data->hComm, &user_data->read_buffer[user_data->write_ptr], first_try_length, &dwRead1, NULL)) {
-			return -1;
-		} else {
-			user_data->write_ptr += dwRead1;
-			if (dwRead1 < first_try_length)
-				return dwRead1;
-			int second_try_length = user_data->read_ptr;
-			if (FALSE == ReadFile(user_data->hComm, &user_data->read_buffer[0], second_try_length, &dwRead2, NULL)) {
-				return dwRead1;
-			} else {
-				user_data->write_ptr += dwRead2;
-				return dwRead1+dwRead2;
-			}
-		}
-	} else {
-		int single_try_length = user_data->read_ptr - user_data->write_ptr;
-		if (FALSE == ReadFile(user_data->hComm, &user_data->read_buffer[user_data->write_ptr], single_try_length, &dwRead1, NULL)) {
-			return -1;
-		} else {
-			user_data->write_ptr += dwRead1;
-			return dwRead1;
+	for (int chunk = 0; chunk < 2; chunk++) {
+		uint8_t *dst;
+		DWORD length = ring_buffer_write_region(&p_port->rx, &dst);
+		if (length == 0)
+			return total > 0 ? total : -1; // buffer is full
+
+		DWORD dwRead = 0;
+		if (FALSE == ReadFile(user_data->hComm, dst, length, &dwRead, NULL)) {
+			serial_stats_read(&p_port->stats, &p_port->rx, 0);
+			// A line error stops reads until it is cleared
+			_clear_errors(user_data);
+			return total > 0 ? total : -1;
 		}
+		serial_port_log_traffic(p_port, false, dst, dwRead);
+		ring_buffer_commit(&p_port->rx, dwRead);
+		serial_stats_read(&p_port->stats, &p_port->rx, dwRead);
+		total += dwRead;
+		if (dwRead < length)
+			break;
 	}
+	return total;
+}
+
+static bool _write_all(serial_port *p_port, const uint8_t *data, uint32_t length) {
+	data_struct * user_data = (data_struct *) p_port;
+
+	DWORD dwBytesWritten = 0;
+	BOOL bErrorFlag = FALSE;
+	bErrorFlag = WriteFile( 
+	                       user_data->hComm,  // open port
+	                       data,              // start of data to write
+	                       length,            // number of bytes to write
+	                       &dwBytesWritten,   // number of bytes that were written
+	                       NULL);             // no overlapped structure
+	serial_stats_write(&p_port->stats, bErrorFlag != FALSE ? dwBytesWritten : 0);
+	if (bErrorFlag != FALSE)
+		serial_port_log_traffic(p_port, true, data, dwBytesWritten);
+
+	return bErrorFlag != FALSE && dwBytesWritten == length;
+}
+
+// Queues for the I/O thread when there is one, writes straight to the port otherwise
+static bool _send(serial_port *p_port, const uint8_t *data, uint32_t length) {
+	if (p_port->threaded)
+		return serial_port_enqueue(p_port, data, length);
+	return _write_all(p_port, data, length);
+}
+
+// Wakes the I/O thread once for everything a call queued
+static void _flush_queued(data_struct * user_data) {
+	if (user_data->base.threaded && serial_port_tx_pending(&user_data->base) > 0 && serial_port_needs_wake(&user_data->base))
+		PostQueuedCompletionStatus(user_data->loop->hCompletionPort, IO_LOOP_WAKE, (ULONG_PTR) user_data, NULL);
 }
 
-static GDCALLINGCONV godot_variant peek(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+static GDCALLINGCONV godot_variant write(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
 	godot_variant ret;
-	int val;
 	data_struct * user_data = (data_struct *) p_user_data;
-	if (_available_for_read(user_data) < 1) {
-		_read_and_buffer(user_data);
-	}
 
-	if (_available_for_read(user_data) > 0)
-		val = user_data->read_buffer[user_data->read_ptr];
-	else
-		val = -1;
-	
-	api->godot_variant_new_int(&ret, val);
+	int num_errors = serial_port_write_args(&user_data->base, p_num_args, p_args, _send);
+	_flush_queued(user_data);
+
+	api->godot_variant_new_int(&ret, num_errors);
 	return ret;
 }
 
-static GDCALLINGCONV godot_variant read(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+static GDCALLINGCONV godot_variant write_packet(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
 	godot_variant ret;
-	int val;
 	data_struct * user_data = (data_struct *) p_user_data;
 
-	if (_available_for_read(user_data) < 1)
-		_read_and_buffer(user_data);
+	bool success = serial_port_write_packet(&user_data->base, p_num_args, p_args, _send);
+	_flush_queued(user_data);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// The I/O thread sees the response arrive, and a threadpool timer wakes it up at the deadline
+static GDCALLINGCONV godot_variant transact(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
 
-	if (_available_for_read(user_data) > 0) {
-		val = user_data->read_buffer[user_data->read_ptr];
-		user_data->read_ptr++;
-	} else
-		val = -1;
+	bool success = serial_port_transact(&user_data->base, p_num_args, p_args, _send);
+	if (success)
+		_arm_transaction_timer(user_data);
+	_flush_queued(user_data);
 
-	api->godot_variant_new_int(&ret, val);
+	api->godot_variant_new_bool(&ret, success);
 	return ret;
 }
 
-static GDCALLINGCONV godot_variant read_string(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+static GDCALLINGCONV godot_variant modbus_poll(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
 	godot_variant ret;
-	godot_string string;
 	data_struct * user_data = (data_struct *) p_user_data;
-	
-	char str[256];
-	if (_available_for_read(user_data) < 1)
-		_read_and_buffer(user_data);
-	int max_length = _available_for_read(user_data);
-	if (max_length == 0) {
 
-		api->godot_variant_new_nil(&ret);
-		return ret;
-	}
-	
-	if (user_data->write_ptr > user_data->read_ptr) {
-		memcpy(str, user_data->read_buffer + user_data->read_ptr, max_length);
-	} else {
-		memcpy(str, user_data->read_buffer + user_data->read_ptr, 256-user_data->read_ptr);
-		if (user_data->write_ptr > 0)
-			memcpy(str + 256-user_data->read_ptr, user_data->read_buffer, user_data->write_ptr);
-	}
-	
-	api->godot_string_new(&string);
-	godot_bool successful_parsing = GODOT_FALSE;
-	
-	while (max_length > 0 && successful_parsing == GODOT_FALSE) {
-		successful_parsing = ! api->godot_string_parse_utf8_with_len(&string, str, max_length);
-		if (successful_parsing == GODOT_FALSE)
-			max_length--;
+	// The I/O thread sends even the first request, once the line has been silent long enough. It
+	// changes the poll's state from the start, so it arms the timer for it itself.
+	bool success = serial_port_modbus_poll(&user_data->base, p_num_args, p_args);
+	if (success)
+		PostQueuedCompletionStatus(user_data->loop->hCompletionPort, IO_LOOP_WAKE, (ULONG_PTR) user_data, NULL);
+
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// reconfigure(baudrate, config) or reconfigure(config: SerialConfig): the line changes on the
+// handle already open, pending overlapped reads and all
+static GDCALLINGCONV godot_variant reconfigure(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+	bool success = false;
+
+	serial_port_settings settings;
+	if (user_data->base.is_open && serial_port_parse_settings(p_num_args, p_args, &settings)) {
+		// A lost device gets them once it is back
+		success = user_data->base.lost || _set_line(user_data->hComm, settings.baudrate, settings.config, user_data->base.options.flow_control, user_data->base.modem_outputs);
+		if (success) {
+			user_data->base.baudrate = settings.baudrate;
+			user_data->base.config = settings.config;
+		}
 	}
 
-	if (max_length <= 0) {
-		api->godot_variant_new_nil(&ret);
-	} else {
-		api->godot_variant_new_string(&ret, &string);
-		user_data->read_ptr += max_length;
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+static godot_variant _set_output(data_struct * user_data, serial_modem_line p_line, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	uint32_t outputs;
+
+	bool success = serial_port_parse_modem_output(&user_data->base, p_line, p_num_args, p_args, &outputs);
+	// Applied once the device is back
+	if (success && !user_data->base.lost) {
+		const bool level = (outputs & p_line) != 0;
+		success = EscapeCommFunction(user_data->hComm, p_line == SERIAL_MODEM_RTS ? (level ? SETRTS : CLRRTS) : (level ? SETDTR : CLRDTR)) != 0;
+		if (!success)
+			fprintf(stderr, "Error setting %s: %i\n", p_line == SERIAL_MODEM_RTS ? "RTS" : "DTR", GetLastError());
 	}
-	
-	api->godot_string_destroy(&string);
+	if (success)
+		serial_atomic_store_u32(&user_data->base.modem_outputs, outputs);
 
+	api->godot_variant_new_bool(&ret, success);
 	return ret;
 }
 
-static GDCALLINGCONV godot_variant write(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+// set_rts(level) and set_dtr(level): refused for the line the flow control of the port drives
+static GDCALLINGCONV godot_variant set_rts(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	return _set_output((data_struct *) p_user_data, SERIAL_MODEM_RTS, p_num_args, p_args);
+}
+
+static GDCALLINGCONV godot_variant set_dtr(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	return _set_output((data_struct *) p_user_data, SERIAL_MODEM_DTR, p_num_args, p_args);
+}
+
+// send_break(duration_ms = 250): suspends transmission in the break state that long. A threaded
+// port returns at once: its I/O thread starts the break once everything written before is out, and
+// emits break_completed(success) when it is over; writes are refused until then. A polled port
+// has no thread to hand it to, so it returns once the break is over, blocking for duration_ms.
+static GDCALLINGCONV godot_variant send_break(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
 	godot_variant ret;
 	data_struct * user_data = (data_struct *) p_user_data;
+	int duration_ms;
 
-	char data_to_write[256];
-	int ptr;
-	int num_errors = 0;
-
-	for (int n_arg = 0; n_arg < p_num_args; n_arg++) {
-		ptr = 0;
-		bool valid_arg = true;
-		switch (api->godot_variant_get_type(p_args[n_arg])) {
-		case GODOT_VARIANT_TYPE_BOOL: {
-			godot_bool val = api->godot_variant_as_bool(p_args[n_arg]);
-			if (val == GODOT_FALSE) {
-				memcpy(data_to_write, "false", 5);
-				ptr = 5;
-			} else {
-				memcpy(data_to_write, "true", 4);
-				ptr = 4;
-			}
-			break;
-		}
-/*		case GODOT_VARIANT_TYPE_INT:*/
-/*		case GODOT_VARIANT_TYPE_REAL:*/
-/*			break;*/
-		case GODOT_VARIANT_TYPE_STRING: {
-			godot_string str = api->godot_variant_as_string(p_args[n_arg]);
-			godot_char_string cstr = api->godot_string_utf8(&str);
-			int length = api->godot_char_string_length(&cstr);
-			const char * val = api->godot_char_string_get_data(&cstr);
-			memcpy(data_to_write, val, length);
-			ptr = length;
-			api->godot_char_string_destroy(&cstr);
-			api->godot_string_destroy(&str);
-			break;
-		}
-		default:
-			valid_arg = false;
-		}
-		
-		if (!valid_arg) {
-			num_errors++;
-			continue;
-		}
-		
-		DWORD dwBytesWritten = 0;
-		BOOL bErrorFlag = FALSE;
-		bErrorFlag = WriteFile( 
-		                       user_data->hComm,  // open file handle
-		                       data_to_write, // start of data to write
-		                       ptr,               // number of bytes to write
-		                       &dwBytesWritten,   // number of bytes that were written
-		                       NULL);             // no overlapped structure
-
-		if (FALSE == bErrorFlag)
-		{
-		    num_errors++;
-		}
-		else
-		{
-		    if (dwBytesWritten != ptr)
-		    {
-		        num_errors++;
-		    }
-		    else
-		    {
-		        // success
-		    }
+	bool success = serial_port_parse_break(&user_data->base, p_num_args, p_args, &duration_ms) && !user_data->base.lost;
+	if (success && user_data->base.threaded) {
+		success = serial_port_request_break(&user_data->base, duration_ms);
+		if (success)
+			PostQueuedCompletionStatus(user_data->loop->hCompletionPort, IO_LOOP_WAKE, (ULONG_PTR) user_data, NULL);
+	} else if (success) {
+		success = SetCommBreak(user_data->hComm) != 0;
+		if (success) {
+			Sleep(duration_ms);
+			ClearCommBreak(user_data->hComm);
+		} else {
+			fprintf(stderr, "Error sending break: %i\n", GetLastError());
 		}
-
 	}
 
-	api->godot_variant_new_int(&ret, num_errors);
+	api->godot_variant_new_bool(&ret, success);
+	return ret;
+}
+
+// CTS, DSR, DCD and RI as the driver sees them right now, empty while the port is not connected
+static GDCALLINGCONV godot_variant get_modem_lines(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	DWORD status;
+	if (user_data->hComm != INVALID_HANDLE_VALUE && GetCommModemStatus(user_data->hComm, &status))
+		serial_port_modem_lines_to_variant(_modem_lines(user_data, status), &ret);
+	else
+		serial_port_modem_lines_to_variant(SERIAL_MODEM_UNKNOWN, &ret);
 	return ret;
 }
 
@@ -445,17 +1128,74 @@ static GDCALLINGCONV godot_variant set_timeout(godot_object *p_instance, void *p
 	bool success = false;
 	
 	if (p_num_args > 0 && api->godot_variant_get_type(p_args[0]) == GODOT_VARIANT_TYPE_INT) {
-		user_data->timeout = api->godot_variant_as_int(p_args[0]);
-		success = _set_timeouts(user_data->hComm, -1, -1, user_data->timeout);
+		user_data->base.timeout = api->godot_variant_as_int(p_args[0]);
+		// The I/O thread relies on its own timeouts; only blocking reads honour this one
+		success = user_data->base.threaded || _set_timeouts(user_data->hComm, -1, -1, user_data->base.timeout);
 	}
 	
 	api->godot_variant_new_bool(&ret, success);
 	return ret;
 }
 
-godot_serial_interface godot_serial_implementation = {0x02,
+static GDCALLINGCONV godot_variant get_stats(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	data_struct * user_data = (data_struct *) p_user_data;
+
+	// The I/O thread hears of errors as they happen, otherwise they are collected now
+	bool counted = user_data->base.threaded;
+	if (!counted && user_data->hComm != INVALID_HANDLE_VALUE)
+		counted = _clear_errors(user_data);
+
+	serial_line_errors line_errors;
+	line_errors.frame_errors = serial_atomic_load_u64(&user_data->frame_errors);
+	line_errors.parity_errors = serial_atomic_load_u64(&user_data->parity_errors);
+	line_errors.overruns = serial_atomic_load_u64(&user_data->overruns);
+	line_errors.breaks = serial_atomic_load_u64(&user_data->breaks);
+	serial_port_get_stats(&user_data->base, counted ? &line_errors : NULL, &ret);
+	return ret;
+}
+
+// USB adapters keep their latency timer in the registry, where only their own tools reach it,
+// so there is nothing to report
+static GDCALLINGCONV godot_variant get_latency_settings(godot_object *p_instance, void *p_method_data, void *p_user_data, int p_num_args, godot_variant **p_args) {
+	godot_variant ret;
+	godot_dictionary settings;
+	api->godot_dictionary_new(&settings);
+	api->godot_variant_new_dictionary(&ret, &settings);
+	api->godot_dictionary_destroy(&settings);
+	return ret;
+}
+
+godot_serial_interface godot_serial_implementation = {0x13,
                                                       constructor, destructor,
                                                       open, close, is_connected,
-                                                      available_for_read, available_for_write,
-                                                      flush, peek, read, read_string, write,
-                                                      set_timeout};
+                                                      serial_port_available_for_read, available_for_write,
+                                                      flush, serial_port_peek, serial_port_read, serial_port_read_string, write,
+                                                      set_timeout, serial_port_get_overflow_count,
+                                                      serial_port_read_bytes, serial_port_read_all,
+                                                      serial_port_read_line, serial_port_read_until,
+                                                      serial_port_read_packet, write_packet,
+                                                      serial_port_get_rejected_frames,
+                                                      serial_port_unpack, list_ports, get_stats,
+                                                      serial_port_read_with_timestamps, get_latency_settings, transact, serial_port_record, modbus_poll,
+                                                      reconfigure, set_rts, set_dtr, send_break, get_modem_lines,
+                                                      serial_port_dispatch_notifications, check_connection};
+
+static GDCALLINGCONV void * hub_constructor(godot_object *p_instance, void *p_method_data) {
+	hub_struct *hub = api->godot_alloc(sizeof(hub_struct));
+	serial_hub_init(&hub->base, p_instance);
+	hub->loop.hThread = NULL;
+	hub->loop.hCompletionPort = NULL;
+	return hub;
+}
+
+static GDCALLINGCONV void hub_destructor(godot_object *p_instance, void *p_method_data, void *p_user_data) {
+	hub_struct *hub = (hub_struct *) p_user_data;
+	// Open ports keep their hub alive, so the loop has none left to service
+	_loop_stop(&hub->loop);
+	serial_hub_destroy(&hub->base);
+	api->godot_free(p_user_data);
+}
+
+godot_serial_hub_interface godot_serial_hub_implementation = {hub_constructor, hub_destructor,
+                                                              serial_hub_poll};
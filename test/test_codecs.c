@@ -0,0 +1,302 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+// Known answers and round trips for the codecs that need no engine: packet framing, checksums and
+// Modbus RTU frames.
+//
+// Build from the repository root and run; it prints each failed check and exits non-zero if any failed:
+//   cc -O2 -Isrc -Igodot_headers -o test_codecs test/test_codecs.c src/serial_framing.c src/serial_crc.c src/serial_modbus.c
+//   ./test_codecs
+
+#include "serial_crc.h"
+#include "serial_framing.h"
+#include "serial_modbus.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int _failures = 0;
+
+#define CHECK(m_condition)                                                          \
+	do {                                                                            \
+		if (!(m_condition)) {                                                       \
+			fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #m_condition); \
+			_failures++;                                                            \
+		}                                                                           \
+	} while (0)
+
+// xorshift32, so every run checks the same inputs
+static uint32_t _random_state = 1;
+
+static uint32_t _random(void) {
+	uint32_t x = _random_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return _random_state = x;
+}
+
+static bool _encodes_to(serial_framing p_framing, uint32_t p_length_size, const uint8_t *p_data, uint32_t p_length, const uint8_t *p_expected, uint32_t p_expected_length) {
+	uint8_t encoded[1024];
+	const uint32_t length = serial_framing_encode(p_framing, p_length_size, p_data, p_length, encoded);
+	return length == p_expected_length && length <= serial_framing_max_encoded(p_framing, p_length, p_length_size) && memcmp(encoded, p_expected, length) == 0;
+}
+
+static void _test_length(void) {
+	const uint8_t payload[] = { 0x11, 0x22, 0x33 };
+	const uint8_t one[] = { 0x03, 0x11, 0x22, 0x33 };
+	const uint8_t two[] = { 0x03, 0x00, 0x11, 0x22, 0x33 };
+	const uint8_t four[] = { 0x03, 0x00, 0x00, 0x00, 0x11, 0x22, 0x33 };
+	CHECK(_encodes_to(SERIAL_FRAMING_LENGTH, 1, payload, 3, one, sizeof(one)));
+	CHECK(_encodes_to(SERIAL_FRAMING_LENGTH, 2, payload, 3, two, sizeof(two)));
+	CHECK(_encodes_to(SERIAL_FRAMING_LENGTH, 4, payload, 3, four, sizeof(four)));
+}
+
+// The examples of the COBS paper, as Wikipedia lists them
+static void _test_cobs(void) {
+	static const uint8_t zero[] = { 0x00 };
+	static const uint8_t zero_encoded[] = { 0x01, 0x01, 0x00 };
+	static const uint8_t zeros[] = { 0x00, 0x00 };
+	static const uint8_t zeros_encoded[] = { 0x01, 0x01, 0x01, 0x00 };
+	static const uint8_t middle[] = { 0x11, 0x22, 0x00, 0x33 };
+	static const uint8_t middle_encoded[] = { 0x03, 0x11, 0x22, 0x02, 0x33, 0x00 };
+	static const uint8_t none[] = { 0x11, 0x22, 0x33, 0x44 };
+	static const uint8_t none_encoded[] = { 0x05, 0x11, 0x22, 0x33, 0x44, 0x00 };
+	static const uint8_t trailing[] = { 0x11, 0x00, 0x00, 0x00 };
+	static const uint8_t trailing_encoded[] = { 0x02, 0x11, 0x01, 0x01, 0x01, 0x00 };
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, NULL, 0, zero_encoded + 1, 2));
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, zero, sizeof(zero), zero_encoded, sizeof(zero_encoded)));
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, zeros, sizeof(zeros), zeros_encoded, sizeof(zeros_encoded)));
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, middle, sizeof(middle), middle_encoded, sizeof(middle_encoded)));
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, none, sizeof(none), none_encoded, sizeof(none_encoded)));
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, trailing, sizeof(trailing), trailing_encoded, sizeof(trailing_encoded)));
+
+	// Blocks of 254 bytes, which carry no implicit zero
+	uint8_t data[256], expected[260];
+	for (int i = 0; i < 255; i++)
+		data[i] = (uint8_t) (i + 1);
+	expected[0] = 0xff;
+	memcpy(expected + 1, data, 254);
+	expected[255] = 0x00;
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, data, 254, expected, 256));
+	expected[255] = 0x02;
+	expected[256] = 0xff;
+	expected[257] = 0x00;
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, data, 255, expected, 258));
+	data[0] = 0x00;
+	for (int i = 1; i < 255; i++)
+		data[i] = (uint8_t) i;
+	expected[0] = 0x01;
+	expected[1] = 0xff;
+	memcpy(expected + 2, data + 1, 254);
+	expected[256] = 0x00;
+	CHECK(_encodes_to(SERIAL_FRAMING_COBS, 0, data, 255, expected, 257));
+
+	// Malformed: a zero code, and a block running past the end
+	uint8_t zero_code[] = { 0x02, 0x11, 0x00, 0x22 };
+	uint8_t overrun[] = { 0x05, 0x11, 0x22 };
+	uint32_t length;
+	CHECK(!serial_framing_decode(SERIAL_FRAMING_COBS, zero_code, sizeof(zero_code), &length));
+	CHECK(!serial_framing_decode(SERIAL_FRAMING_COBS, overrun, sizeof(overrun), &length));
+}
+
+static void _test_slip(void) {
+	static const uint8_t data[] = { 0x01, 0xc0, 0x02, 0xdb, 0x03 };
+	static const uint8_t data_encoded[] = { 0xc0, 0x01, 0xdb, 0xdc, 0x02, 0xdb, 0xdd, 0x03, 0xc0 };
+	CHECK(_encodes_to(SERIAL_FRAMING_SLIP, 0, data, sizeof(data), data_encoded, sizeof(data_encoded)));
+
+	// Malformed: an escape at the end, and one followed by anything else
+	uint8_t dangling[] = { 0x01, 0xdb };
+	uint8_t unknown[] = { 0x01, 0xdb, 0x02 };
+	uint32_t length;
+	CHECK(!serial_framing_decode(SERIAL_FRAMING_SLIP, dangling, sizeof(dangling), &length));
+	CHECK(!serial_framing_decode(SERIAL_FRAMING_SLIP, unknown, sizeof(unknown), &length));
+}
+
+// Random payloads, heavy on the bytes each framing has to escape, come back unchanged and
+// never hold a delimiter inside the frame
+static void _test_round_trips(serial_framing p_framing, uint8_t p_delimiter, uint8_t p_escape) {
+	static uint8_t data[2048], encoded[4200];
+	for (int run = 0; run < 2000; run++) {
+		const uint32_t length = _random() % (run < 1000 ? 64 : sizeof(data));
+		for (uint32_t i = 0; i < length; i++) {
+			const uint32_t pick = _random() % 8;
+			data[i] = pick == 0 ? p_delimiter : pick == 1 ? p_escape : (uint8_t) _random();
+		}
+
+		const uint32_t encoded_length = serial_framing_encode(p_framing, 0, data, length, encoded);
+		CHECK(encoded_length <= serial_framing_max_encoded(p_framing, length, 0));
+		CHECK(encoded[encoded_length - 1] == p_delimiter);
+		// SLIP also opens the frame with its delimiter
+		const uint32_t start = p_framing == SERIAL_FRAMING_SLIP ? 1 : 0;
+		CHECK(memchr(encoded + start, p_delimiter, encoded_length - 1 - start) == NULL);
+
+		uint32_t decoded_length = 0;
+		CHECK(serial_framing_decode(p_framing, encoded + start, encoded_length - 1 - start, &decoded_length));
+		CHECK(decoded_length == length && memcmp(encoded + start, data, length) == 0);
+		if (_failures > 0)
+			return;
+	}
+}
+
+// Bit at a time, for lengths and alignments the table-driven code handles differently
+static uint32_t _reference_crc32(const uint8_t *p_data, uint32_t p_length) {
+	uint32_t crc = 0xffffffff;
+	for (uint32_t i = 0; i < p_length; i++) {
+		crc ^= p_data[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+// The catalogue check values, over "123456789"
+static void _test_crc(void) {
+	static const uint8_t check[] = "123456789";
+	CHECK(serial_crc32(check, 9) == 0xcbf43926);
+	CHECK(serial_crc16_ccitt(check, 9) == 0x29b1);
+	CHECK(serial_crc16_modbus(check, 9) == 0x4b37);
+	CHECK(serial_crc32(check, 0) == 0);
+	CHECK(serial_crc16_ccitt(check, 0) == 0xffff);
+	CHECK(serial_crc16_modbus(check, 0) == 0xffff);
+
+	static uint8_t data[300];
+	for (uint32_t i = 0; i < sizeof(data); i++)
+		data[i] = (uint8_t) _random();
+	for (uint32_t offset = 0; offset < 8; offset++)
+		for (uint32_t length = 0; length + offset <= sizeof(data); length += 1 + length / 16)
+			CHECK(serial_crc32(data + offset, length) == _reference_crc32(data + offset, length));
+}
+
+static void _test_checksums(void) {
+	static const uint8_t ccitt[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9', 0x29, 0xb1 };
+	static const uint8_t crc32[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9', 0x26, 0x39, 0xf4, 0xcb };
+	static const uint8_t modbus[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9', 0x37, 0x4b };
+	static const struct {
+		serial_checksum checksum;
+		const uint8_t *framed;
+		uint32_t size;
+	} cases[] = {
+		{ SERIAL_CHECKSUM_CRC16_CCITT, ccitt, 2 },
+		{ SERIAL_CHECKSUM_CRC32, crc32, 4 },
+		{ SERIAL_CHECKSUM_MODBUS, modbus, 2 },
+	};
+	CHECK(serial_checksum_size(SERIAL_CHECKSUM_NONE) == 0);
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		uint8_t framed[16];
+		memcpy(framed, cases[i].framed, 9);
+		CHECK(serial_checksum_size(cases[i].checksum) == cases[i].size);
+		serial_checksum_append(cases[i].checksum, framed, 9, framed + 9);
+		CHECK(memcmp(framed, cases[i].framed, 9 + cases[i].size) == 0);
+		CHECK(serial_checksum_verify(cases[i].checksum, framed, 9 + cases[i].size));
+		framed[4] ^= 0x01;
+		CHECK(!serial_checksum_verify(cases[i].checksum, framed, 9 + cases[i].size));
+		CHECK(!serial_checksum_verify(cases[i].checksum, framed, cases[i].size - 1));
+	}
+}
+
+static bool _encodes_request(uint8_t p_slave, uint8_t p_function, uint16_t p_address, uint16_t p_count, const uint16_t *p_values, const uint8_t *p_expected, uint32_t p_expected_length) {
+	serial_modbus_request request;
+	return serial_modbus_encode(&request, p_slave, p_function, p_address, p_count, p_values) && request.frame_length == p_expected_length && memcmp(request.frame, p_expected, p_expected_length) == 0;
+}
+
+static void _test_modbus(void) {
+	static const uint8_t read_holding[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x0a, 0xc5, 0xcd };
+	static const uint8_t read_coils[] = { 0x11, 0x01, 0x00, 0x13, 0x00, 0x25, 0x0e, 0x84 };
+	static const uint8_t write_single[] = { 0x11, 0x06, 0x00, 0x01, 0x00, 0x03, 0x9a, 0x9b };
+	static const uint8_t write_multiple[] = { 0x11, 0x10, 0x00, 0x01, 0x00, 0x02, 0x04, 0x00, 0x0a, 0x01, 0x02, 0xc6, 0xf0 };
+	static const uint16_t single_value[] = { 0x0003 };
+	static const uint16_t multiple_values[] = { 0x000a, 0x0102 };
+	CHECK(_encodes_request(1, SERIAL_MODBUS_READ_HOLDING_REGISTERS, 0, 10, NULL, read_holding, sizeof(read_holding)));
+	CHECK(_encodes_request(0x11, SERIAL_MODBUS_READ_COILS, 0x13, 0x25, NULL, read_coils, sizeof(read_coils)));
+	CHECK(_encodes_request(0x11, SERIAL_MODBUS_WRITE_SINGLE_REGISTER, 1, 1, single_value, write_single, sizeof(write_single)));
+	CHECK(_encodes_request(0x11, SERIAL_MODBUS_WRITE_MULTIPLE_REGISTERS, 1, 2, multiple_values, write_multiple, sizeof(write_multiple)));
+
+	// Requests that cannot be expressed
+	serial_modbus_request request;
+	CHECK(!serial_modbus_encode(&request, 0, SERIAL_MODBUS_READ_HOLDING_REGISTERS, 0, 1, NULL));
+	CHECK(!serial_modbus_encode(&request, 1, SERIAL_MODBUS_READ_HOLDING_REGISTERS, 0, SERIAL_MODBUS_MAX_READ_REGISTERS + 1, NULL));
+	CHECK(!serial_modbus_encode(&request, 1, 7, 0, 1, NULL));
+
+	// Read holding registers 0x6b to 0x6d of slave 0x11, and its answer
+	static const uint8_t response[] = { 0x11, 0x03, 0x06, 0xae, 0x41, 0x56, 0x52, 0x43, 0x40, 0x49, 0xad };
+	uint16_t values[SERIAL_MODBUS_MAX_READ_BITS];
+	uint32_t count = 0;
+	CHECK(serial_modbus_encode(&request, 0x11, SERIAL_MODBUS_READ_HOLDING_REGISTERS, 0x6b, 3, NULL));
+	CHECK(request.response_length == sizeof(response));
+	CHECK(serial_modbus_frame_length(response, 2) == 0);
+	CHECK(serial_modbus_frame_length(response, 3) == sizeof(response));
+	CHECK(serial_modbus_decode(&request, response, sizeof(response), values, &count) == SERIAL_MODBUS_OK);
+	CHECK(count == 3 && values[0] == 0xae41 && values[1] == 0x5652 && values[2] == 0x4340);
+	CHECK(serial_modbus_decode(&request, response, 0, values, &count) == SERIAL_MODBUS_NO_RESPONSE);
+	CHECK(serial_modbus_decode(&request, response, sizeof(response) - 1, values, &count) == SERIAL_MODBUS_BAD_RESPONSE);
+
+	uint8_t corrupted[sizeof(response)];
+	for (uint32_t i = 0; i < sizeof(response); i++) {
+		memcpy(corrupted, response, sizeof(response));
+		corrupted[i] ^= 0x10;
+		CHECK(serial_modbus_decode(&request, corrupted, sizeof(corrupted), values, &count) == SERIAL_MODBUS_BAD_RESPONSE);
+	}
+
+	// Illegal data address, from another slave than the one asked
+	static const uint8_t exception[] = { 0x11, 0x83, 0x02, 0xc1, 0x34 };
+	CHECK(serial_modbus_frame_length(exception, 3) == sizeof(exception));
+	CHECK(serial_modbus_decode(&request, exception, sizeof(exception), values, &count) == 2);
+	static const uint8_t other_slave[] = { 0x01, 0x83, 0x02, 0xc0, 0xf1 };
+	CHECK(serial_modbus_decode(&request, other_slave, sizeof(other_slave), values, &count) == SERIAL_MODBUS_BAD_RESPONSE);
+
+	// A write is answered by the address and count it wrote
+	static const uint8_t write_response[] = { 0x11, 0x10, 0x00, 0x01, 0x00, 0x02, 0x12, 0x98 };
+	CHECK(serial_modbus_encode(&request, 0x11, SERIAL_MODBUS_WRITE_MULTIPLE_REGISTERS, 1, 2, multiple_values));
+	CHECK(serial_modbus_frame_length(write_response, 3) == sizeof(write_response));
+	CHECK(serial_modbus_decode(&request, write_response, sizeof(write_response), values, &count) == SERIAL_MODBUS_OK);
+
+	// Every length the encoder accepts is what the frame announces
+	for (uint16_t n = 1; n <= SERIAL_MODBUS_MAX_WRITE_REGISTERS; n++) {
+		for (uint16_t i = 0; i < n; i++)
+			values[i] = (uint16_t) _random();
+		CHECK(serial_modbus_encode(&request, 1, SERIAL_MODBUS_WRITE_MULTIPLE_REGISTERS, 0, n, values));
+		CHECK(request.frame_length == 9u + 2u * n && request.frame[6] == 2 * n);
+		CHECK(serial_crc16_modbus(request.frame, request.frame_length - 2) == (request.frame[request.frame_length - 2] | request.frame[request.frame_length - 1] << 8));
+	}
+}
+
+int main(void) {
+	serial_crc_init();
+	_test_length();
+	_test_cobs();
+	_test_slip();
+	_test_round_trips(SERIAL_FRAMING_COBS, SERIAL_FRAMING_COBS_DELIMITER, 0xff);
+	_test_round_trips(SERIAL_FRAMING_SLIP, SERIAL_FRAMING_SLIP_END, 0xdb);
+	_test_crc();
+	_test_checksums();
+	_test_modbus();
+
+	if (_failures > 0) {
+		fprintf(stderr, "%d checks failed\n", _failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,551 @@
+/**
+* Godot Serial
+*   Adding serial port communication for Godot Engine
+* Copyright (c) 2018 Rodolfo Ribeiro Gomes
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+// Port enumeration and reconnection on Linux, against a fake /sys and /dev built in a temporary
+// directory and handed to the backend through GODOT_SERIAL_SYSFS_ROOT and GODOT_SERIAL_DEV_ROOT.
+// The engine is replaced by bench/mock_api.c, pseudo terminals stand in for the devices.
+//
+// Checks that list_ports() describes USB ports and leaves out platform ports and consoles, that
+// it follows devices appearing and disappearing in /dev, and that a port opened with "reconnect"
+// lets go of an unplugged device and comes back on the one plugged in after it. Against
+// VirtualSerial, checks that transact() hands its response, or nothing at its timeout, over through
+// transaction_completed while reads get nothing, and that read_string() keeps a character whose
+// bytes arrive in separate chunks together.
+//
+// Build from the repository root, next to a checkout of godot_headers, and run; it prints each
+// failed check and exits non-zero if any failed:
+//   cc -O2 -pthread -Igodot_headers -Isrc -Ibench -o test_ports test/test_ports.c bench/mock_api.c $(ls src/*.c | grep -v -e godot_serial.c -e windows.c) -lutil
+//   ./test_ports
+
+#define _GNU_SOURCE
+
+#include "mock_api.h"
+#include "serial_interface.h"
+
+#include <errno.h>
+#include <ftw.h>
+#include <limits.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+const godot_gdnative_core_api_struct *api = &mock_api;
+const godot_gdnative_ext_nativescript_api_struct *nativescript_api = NULL;
+
+static int _failures = 0;
+
+#define CHECK(m_condition)                                                          \
+	do {                                                                            \
+		if (!(m_condition)) {                                                       \
+			fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #m_condition); \
+			_failures++;                                                            \
+		}                                                                           \
+	} while (0)
+
+static char _root[] = "/tmp/godot_serial_test.XXXXXX";
+
+// Fake trees
+
+// Path under the temporary directory; the last few results stay valid, so calls can be nested
+static const char * _path(const char *p_format, ...) {
+	static char paths[4][PATH_MAX];
+	static int next = 0;
+	char *path = paths[next++ % 4];
+	int length = snprintf(path, PATH_MAX, "%s/", _root);
+	va_list args;
+	va_start(args, p_format);
+	vsnprintf(path + length, PATH_MAX - length, p_format, args);
+	va_end(args);
+	return path;
+}
+
+static void _make_dirs(const char *p_path) {
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s", p_path);
+	for (char *slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		mkdir(path, 0755);
+		*slash = '/';
+	}
+	mkdir(path, 0755);
+}
+
+static void _write_file(const char *p_path, const char *p_content) {
+	FILE *file = fopen(p_path, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Cannot write %s: %s\n", p_path, strerror(errno));
+		exit(1);
+	}
+	fputs(p_content, file);
+	fclose(file);
+}
+
+static void _link(const char *p_target, const char *p_path) {
+	if (symlink(p_target, p_path) != 0) {
+		fprintf(stderr, "Cannot link %s: %s\n", p_path, strerror(errno));
+		exit(1);
+	}
+}
+
+// A USB device with one serial interface, attached to p_tty in sysfs
+static void _add_usb_device(const char *p_device, const char *p_vid, const char *p_pid, const char *p_serial, const char *p_driver, const char *p_tty) {
+	char interface[PATH_MAX], driver[PATH_MAX];
+	snprintf(interface, sizeof(interface), "%s", _path("sys/devices/pci0000:00/usb1/%s/%s:1.0", p_device, p_device));
+	snprintf(driver, sizeof(driver), "%s", _path("sys/bus/usb/drivers/%s", p_driver));
+	_make_dirs(interface);
+	_make_dirs(driver);
+	_write_file(_path("sys/devices/pci0000:00/usb1/%s/idVendor", p_device), p_vid);
+	_write_file(_path("sys/devices/pci0000:00/usb1/%s/idProduct", p_device), p_pid);
+	if (p_serial != NULL)
+		_write_file(_path("sys/devices/pci0000:00/usb1/%s/serial", p_device), p_serial);
+	_link(_path("sys/bus/usb"), _path("sys/devices/pci0000:00/usb1/%s/%s:1.0/subsystem", p_device, p_device));
+	_link(driver, _path("sys/devices/pci0000:00/usb1/%s/%s:1.0/driver", p_device, p_device));
+
+	_make_dirs(_path("sys/class/tty/%s", p_tty));
+	_link(interface, _path("sys/class/tty/%s/device", p_tty));
+}
+
+static void _build_trees(void) {
+	if (mkdtemp(_root) == NULL) {
+		fprintf(stderr, "Cannot create a temporary directory: %s\n", strerror(errno));
+		exit(1);
+	}
+	_make_dirs(_path("dev"));
+	_make_dirs(_path("sys/bus/usb"));
+	_add_usb_device("1-1", "0403\n", "6001\n", "FT1234\n", "ftdi_sio", "ttyUSB0");
+
+	// A legacy UART on the platform bus, and a virtual console with no device at all
+	_make_dirs(_path("sys/bus/platform"));
+	_make_dirs(_path("sys/devices/platform/serial8250"));
+	_link(_path("sys/bus/platform"), _path("sys/devices/platform/serial8250/subsystem"));
+	_make_dirs(_path("sys/class/tty/ttyS0"));
+	_link(_path("sys/devices/platform/serial8250"), _path("sys/class/tty/ttyS0/device"));
+	_make_dirs(_path("sys/class/tty/tty0"));
+
+	setenv("GODOT_SERIAL_SYSFS_ROOT", _path("sys"), 1);
+	setenv("GODOT_SERIAL_DEV_ROOT", _path("dev"), 1);
+}
+
+static int _remove_entry(const char *p_path, const struct stat *p_stat, int p_flag, struct FTW *p_ftw) {
+	return remove(p_path);
+}
+
+// Pseudo terminal standing in for a device node
+typedef struct {
+	int master;
+	int slave;
+} test_pty;
+
+static void _plug(test_pty *r_pty, const char *p_name) {
+	char name[64];
+	if (openpty(&r_pty->master, &r_pty->slave, name, NULL, NULL) < 0) {
+		fprintf(stderr, "Cannot open a pseudo terminal: %s\n", strerror(errno));
+		exit(1);
+	}
+	struct termios tio;
+	tcgetattr(r_pty->master, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(r_pty->master, TCSANOW, &tio);
+	_link(name, _path("dev/%s", p_name));
+}
+
+static void _unplug(test_pty *p_pty, const char *p_name) {
+	unlink(_path("dev/%s", p_name));
+	close(p_pty->slave);
+	close(p_pty->master);
+}
+
+// Calls into the backend
+
+static const godot_serial_interface *_serial = &godot_serial_implementation;
+static const godot_serial_interface *_virtual = &godot_serial_virtual_implementation;
+
+static bool _call_bool(void *p_port, GDCALLINGCONV godot_variant (*p_method)(godot_object *, void *, void *, int, godot_variant **)) {
+	godot_variant ret = p_method(NULL, NULL, p_port, 0, NULL);
+	const bool value = api->godot_variant_as_bool(&ret);
+	api->godot_variant_destroy(&ret);
+	return value;
+}
+
+static void _call(void *p_port, GDCALLINGCONV godot_variant (*p_method)(godot_object *, void *, void *, int, godot_variant **)) {
+	godot_variant ret = p_method(NULL, NULL, p_port, 0, NULL);
+	api->godot_variant_destroy(&ret);
+}
+
+static godot_variant _get(const godot_dictionary *p_dictionary, const char *p_key) {
+	godot_variant key;
+	mock_variant_new_cstring(&key, p_key);
+	godot_variant value = api->godot_dictionary_get(p_dictionary, &key);
+	api->godot_variant_destroy(&key);
+	return value;
+}
+
+static bool _has_string(const godot_dictionary *p_dictionary, const char *p_key, const char *p_expected) {
+	godot_variant value = _get(p_dictionary, p_key);
+	godot_string string = api->godot_variant_as_string(&value);
+	godot_char_string utf8 = api->godot_string_utf8(&string);
+	const bool equal = strcmp(api->godot_char_string_get_data(&utf8), p_expected) == 0;
+	api->godot_char_string_destroy(&utf8);
+	api->godot_string_destroy(&string);
+	api->godot_variant_destroy(&value);
+	return equal;
+}
+
+static int64_t _get_int(const godot_dictionary *p_dictionary, const char *p_key) {
+	godot_variant value = _get(p_dictionary, p_key);
+	const int64_t result = api->godot_variant_as_int(&value);
+	api->godot_variant_destroy(&value);
+	return result;
+}
+
+// Copies the entry list_ports() returns for p_name into r_port; false if there is none
+static bool _find_port(const char *p_name, int *r_count, godot_dictionary *r_port) {
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s", _path("dev/%s", p_name));
+
+	godot_variant ret = _serial->list_ports(NULL, NULL, NULL, 0, NULL);
+	godot_array ports = api->godot_variant_as_array(&ret);
+	bool found = false;
+	*r_count = api->godot_array_size(&ports);
+	for (int i = 0; i < *r_count && !found; i++) {
+		godot_variant item = api->godot_array_get(&ports, i);
+		godot_dictionary port = api->godot_variant_as_dictionary(&item);
+		found = _has_string(&port, "path", path);
+		if (found)
+			*r_port = port;
+		else
+			api->godot_dictionary_destroy(&port);
+		api->godot_variant_destroy(&item);
+	}
+	api->godot_array_destroy(&ports);
+	api->godot_variant_destroy(&ret);
+	return found;
+}
+
+// Waits for the hotplug thread to see p_name come or go
+static bool _wait_listed(const char *p_name, bool p_listed) {
+	for (int i = 0; i < 200; i++) {
+		int count;
+		godot_dictionary port;
+		const bool found = _find_port(p_name, &count, &port);
+		if (found)
+			api->godot_dictionary_destroy(&port);
+		if (found == p_listed)
+			return true;
+		usleep(10000);
+	}
+	return false;
+}
+
+static void * _open(const char *p_name) {
+	godot_dictionary options;
+	godot_variant key, value, port_name, baudrate, config, options_variant;
+	api->godot_dictionary_new(&options);
+	mock_variant_new_cstring(&key, "reconnect");
+	api->godot_variant_new_bool(&value, true);
+	api->godot_dictionary_set(&options, &key, &value);
+	mock_variant_new_cstring(&port_name, _path("dev/%s", p_name));
+	api->godot_variant_new_int(&baudrate, 115200);
+	mock_variant_new_cstring(&config, "8N1");
+	api->godot_variant_new_dictionary(&options_variant, &options);
+	godot_variant *args[] = { &port_name, &baudrate, &config, &options_variant };
+
+	void *port = _serial->constructor(NULL, NULL);
+	godot_variant ret = _serial->open(NULL, NULL, port, 4, args);
+	if (!api->godot_variant_as_bool(&ret)) {
+		fprintf(stderr, "Cannot open %s\n", p_name);
+		exit(1);
+	}
+
+	api->godot_variant_destroy(&ret);
+	api->godot_variant_destroy(&options_variant);
+	api->godot_variant_destroy(&config);
+	api->godot_variant_destroy(&baudrate);
+	api->godot_variant_destroy(&port_name);
+	api->godot_variant_destroy(&value);
+	api->godot_variant_destroy(&key);
+	api->godot_dictionary_destroy(&options);
+	return port;
+}
+
+// Whether a byte written to the port comes out of p_pty
+static bool _reaches(void *p_port, const test_pty *p_pty) {
+	const uint8_t byte = 0x5a;
+	godot_variant data;
+	mock_variant_new_bytes(&data, &byte, 1);
+	godot_variant *args[] = { &data };
+	godot_variant ret = _serial->write(NULL, NULL, p_port, 1, args);
+	api->godot_variant_destroy(&ret);
+	api->godot_variant_destroy(&data);
+
+	struct pollfd pfd = { p_pty->master, POLLIN, 0 };
+	uint8_t received = 0;
+	return poll(&pfd, 1, 1000) == 1 && read(p_pty->master, &received, 1) == 1 && received == byte;
+}
+
+static void _set_option(godot_dictionary *p_options, const char *p_key, const godot_variant *p_value) {
+	godot_variant key;
+	mock_variant_new_cstring(&key, p_key);
+	api->godot_dictionary_set(p_options, &key, p_value);
+	api->godot_variant_destroy(&key);
+}
+
+// A VirtualSerial device answering p_response to p_request, after p_latency_ms, p_chunk_size bytes at a time
+static void * _open_virtual(const char *p_request, const char *p_response, double p_latency_ms, int p_chunk_size, int p_baudrate, bool p_threaded) {
+	godot_dictionary options, responses;
+	godot_variant value, port_name, baudrate, config, options_variant;
+	api->godot_dictionary_new(&options);
+	api->godot_dictionary_new(&responses);
+
+	godot_variant request;
+	mock_variant_new_cstring(&request, p_request);
+	mock_variant_new_cstring(&value, p_response);
+	api->godot_dictionary_set(&responses, &request, &value);
+	api->godot_variant_destroy(&value);
+	api->godot_variant_destroy(&request);
+	api->godot_variant_new_dictionary(&value, &responses);
+	_set_option(&options, "responses", &value);
+	api->godot_variant_destroy(&value);
+	api->godot_variant_new_real(&value, p_latency_ms);
+	_set_option(&options, "latency_ms", &value);
+	api->godot_variant_destroy(&value);
+	api->godot_variant_new_int(&value, p_chunk_size);
+	_set_option(&options, "chunk_size", &value);
+	api->godot_variant_destroy(&value);
+	api->godot_variant_new_bool(&value, p_threaded);
+	_set_option(&options, "threaded", &value);
+	api->godot_variant_destroy(&value);
+
+	mock_variant_new_cstring(&port_name, "virtual");
+	api->godot_variant_new_int(&baudrate, p_baudrate);
+	mock_variant_new_cstring(&config, "8N1");
+	api->godot_variant_new_dictionary(&options_variant, &options);
+	godot_variant *args[] = { &port_name, &baudrate, &config, &options_variant };
+
+	void *port = _virtual->constructor(NULL, NULL);
+	godot_variant ret = _virtual->open(NULL, NULL, port, 4, args);
+	if (!api->godot_variant_as_bool(&ret)) {
+		fprintf(stderr, "Cannot open a virtual port\n");
+		exit(1);
+	}
+
+	api->godot_variant_destroy(&ret);
+	api->godot_variant_destroy(&options_variant);
+	api->godot_variant_destroy(&config);
+	api->godot_variant_destroy(&baudrate);
+	api->godot_variant_destroy(&port_name);
+	api->godot_dictionary_destroy(&responses);
+	api->godot_dictionary_destroy(&options);
+	return port;
+}
+
+static int64_t _call_int(void *p_port, GDCALLINGCONV godot_variant (*p_method)(godot_object *, void *, void *, int, godot_variant **)) {
+	godot_variant ret = p_method(NULL, NULL, p_port, 0, NULL);
+	const int64_t value = api->godot_variant_as_int(&ret);
+	api->godot_variant_destroy(&ret);
+	return value;
+}
+
+static bool _transact(void *p_port, const char *p_request, const char *p_terminator, int p_timeout_ms) {
+	godot_variant request, terminator, timeout;
+	mock_variant_new_cstring(&request, p_request);
+	mock_variant_new_cstring(&terminator, p_terminator);
+	api->godot_variant_new_int(&timeout, p_timeout_ms);
+	godot_variant *args[] = { &request, &terminator, &timeout };
+	godot_variant ret = _virtual->transact(NULL, NULL, p_port, 3, args);
+	const bool started = api->godot_variant_as_bool(&ret);
+	api->godot_variant_destroy(&ret);
+	api->godot_variant_destroy(&timeout);
+	api->godot_variant_destroy(&terminator);
+	api->godot_variant_destroy(&request);
+	return started;
+}
+
+// Runs dispatch_notifications() like the engine would until transaction_completed comes, and
+// whether it carried p_expected; reads in between must find rx empty
+static bool _transaction_completed(void *p_port, const char *p_expected) {
+	const uint64_t signals = mock_api_signals();
+	for (int i = 0; i < 1000 && mock_api_signals() == signals; i++) {
+		usleep(1000);
+		CHECK(_call_int(p_port, _virtual->available_for_read) == 0);
+		CHECK(_call_int(p_port, _virtual->read) == -1);
+		_call(p_port, _virtual->dispatch_notifications);
+	}
+	if (mock_api_signals() != signals + 1)
+		return false;
+
+	const godot_variant *response;
+	int length;
+	const char *name = mock_api_last_signal(&response);
+	const uint8_t *data = mock_variant_bytes(response, &length);
+	return strcmp(name, "transaction_completed") == 0 && api->godot_variant_get_type(response) == GODOT_VARIANT_TYPE_POOL_BYTE_ARRAY
+			&& length == (int) strlen(p_expected) && (length == 0 || memcmp(data, p_expected, length) == 0);
+}
+
+// Tests
+
+static void _test_list_ports(void) {
+	int count;
+	godot_dictionary port;
+	CHECK(_find_port("ttyUSB0", &count, &port));
+	CHECK(count == 1);
+	if (count < 1)
+		return;
+	CHECK(_has_string(&port, "driver", "ftdi_sio"));
+	CHECK(_has_string(&port, "serial_number", "FT1234"));
+	CHECK(_get_int(&port, "vid") == 0x0403);
+	CHECK(_get_int(&port, "pid") == 0x6001);
+	api->godot_dictionary_destroy(&port);
+}
+
+static void _test_hotplug(void) {
+	// A device without a serial number shows up once its node does
+	_add_usb_device("1-2", "2341\n", "0043\n", NULL, "cdc_acm", "ttyACM0");
+	_write_file(_path("dev/ttyACM0"), "");
+	CHECK(_wait_listed("ttyACM0", true));
+
+	int count;
+	godot_dictionary port;
+	if (_find_port("ttyACM0", &count, &port)) {
+		CHECK(count == 2);
+		CHECK(_has_string(&port, "driver", "cdc_acm"));
+		CHECK(_has_string(&port, "serial_number", ""));
+		CHECK(_get_int(&port, "vid") == 0x2341);
+		CHECK(_get_int(&port, "pid") == 0x0043);
+		api->godot_dictionary_destroy(&port);
+	}
+
+	unlink(_path("dev/ttyACM0"));
+	CHECK(_wait_listed("ttyACM0", false));
+	CHECK(_wait_listed("ttyUSB0", true));
+}
+
+static void _test_reconnect(test_pty *p_pty) {
+	void *port = _open("ttyUSB0");
+	CHECK(_call_bool(port, _serial->is_connected));
+	CHECK(_reaches(port, p_pty));
+
+	// The engine would run the deferred check_connection(); here the test does it once the list has changed
+	_unplug(p_pty, "ttyUSB0");
+	CHECK(_wait_listed("ttyUSB0", false));
+	_call(port, _serial->check_connection);
+	CHECK(!_call_bool(port, _serial->is_connected));
+
+	_plug(p_pty, "ttyUSB0");
+	CHECK(_wait_listed("ttyUSB0", true));
+	_call(port, _serial->check_connection);
+	CHECK(_call_bool(port, _serial->is_connected));
+	CHECK(_reaches(port, p_pty));
+
+	_call(port, _serial->close);
+	_serial->destructor(NULL, NULL, port);
+}
+
+static void _test_transact(void) {
+	void *port = _open_virtual("PING\n", "PONG\n", 20, 1, 115200, true);
+
+	// The answer comes late enough for the reads in between to find nothing
+	CHECK(_transact(port, "PING\n", "\n", 1000));
+	CHECK(!_transact(port, "PING\n", "\n", 1000));
+	godot_variant string = _virtual->read_string(NULL, NULL, port, 0, NULL);
+	CHECK(api->godot_variant_get_type(&string) == GODOT_VARIANT_TYPE_NIL);
+	api->godot_variant_destroy(&string);
+	CHECK(_transaction_completed(port, "PONG\n"));
+
+	// Nothing answers this one, so it ends empty at its timeout
+	CHECK(_transact(port, "PONG\n", "\n", 30));
+	CHECK(_transaction_completed(port, ""));
+
+	// rx is the script's again
+	CHECK(_transact(port, "PING\n", "\n", 1000));
+	CHECK(_transaction_completed(port, "PONG\n"));
+	CHECK(_call_int(port, _virtual->available_for_read) == 0);
+
+	_call(port, _virtual->close);
+	_virtual->destructor(NULL, NULL, port);
+}
+
+static void _test_read_string_split(void) {
+	// "aé€" two bytes at a time, slowly: a|C3, A9|E2, 82|AC
+	const char *expected = "a\xc3\xa9\xe2\x82\xac";
+	void *port = _open_virtual("?", expected, 0, 2, 1200, false);
+	godot_variant request;
+	mock_variant_new_cstring(&request, "?");
+	godot_variant *args[] = { &request };
+	godot_variant ret = _virtual->write(NULL, NULL, port, 1, args);
+	api->godot_variant_destroy(&ret);
+	api->godot_variant_destroy(&request);
+
+	char received[16] = "";
+	size_t length = 0;
+	int pieces = 0;
+	for (int i = 0; i < 1000 && length < strlen(expected); i++) {
+		godot_variant string = _virtual->read_string(NULL, NULL, port, 0, NULL);
+		const char *piece = mock_variant_cstring(&string);
+		if (piece != NULL && length + strlen(piece) < sizeof(received)) {
+			strcat(received, piece);
+			length += strlen(piece);
+			pieces++;
+			// Every piece ends on a character boundary
+			CHECK(length == 1 || length == 3 || length == 6);
+		}
+		api->godot_variant_destroy(&string);
+		usleep(1000);
+	}
+	CHECK(strcmp(received, expected) == 0);
+	CHECK(pieces == 3);
+
+	_call(port, _virtual->close);
+	_virtual->destructor(NULL, NULL, port);
+}
+
+int main(void) {
+	_build_trees();
+	test_pty pty;
+	_plug(&pty, "ttyUSB0");
+
+	_test_list_ports();
+	_test_hotplug();
+	_test_reconnect(&pty);
+	_test_transact();
+	_test_read_string_split();
+
+	_unplug(&pty, "ttyUSB0");
+	godot_serial_terminate();
+	nftw(_root, _remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+	if (_failures > 0) {
+		fprintf(stderr, "%d checks failed\n", _failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}